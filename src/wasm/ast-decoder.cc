@@ -98,6 +98,7 @@ class LR_WasmDecoder : public Decoder {
       : Decoder(nullptr, nullptr),
         zone_(zone),
         builder_(zone, g),
+        verified_(false),
         trees_(zone),
         stack_(zone),
         blocks_(zone),
@@ -124,6 +125,10 @@ class LR_WasmDecoder : public Decoder {
     base_ = base;
     Reset(pc, end);
     function_env_ = function_env;
+    // The module decoder already type-checked the bodies it verified, so
+    // building their graphs skips the checks that cannot fail again.
+    verified_ = builder_.graph != nullptr && function_env->module != nullptr &&
+                function_env->module->FunctionBodiesVerified();
 
     InitSsaEnv();
     DecodeFunctionBody();
@@ -148,7 +153,9 @@ class LR_WasmDecoder : public Decoder {
     if (ok()) {
       if (FLAG_trace_wasm_decode_time) {
         double ms = decode_timer.Elapsed().InMillisecondsF();
-        PrintF(" - decoding took %0.3f ms\n", ms);
+        double mb = static_cast<double>(end - pc) / MB;
+        PrintF(" - decoding took %0.3f ms (%0.1f MB/s)\n", ms,
+               ms > 0 ? mb * 1000 / ms : 0.0);
       }
       TRACE("wasm-decode ok\n\n");
     } else {
@@ -168,6 +175,7 @@ class LR_WasmDecoder : public Decoder {
 
   SsaEnv* ssa_env_;
   FunctionEnv* function_env_;
+  bool verified_;  // true if the body passed verification before.
 
   ZoneVector<Tree*> trees_;
   ZoneVector<Production> stack_;
@@ -293,6 +301,9 @@ class LR_WasmDecoder : public Decoder {
   }
 
   // Decodes the body of a function, producing reduced trees into {result}.
+  // Simple expressions are shifted straight from the opcode table; all other
+  // opcodes go through the switch below, whose default case handles memory
+  // accesses by their class in the table.
   void DecodeFunctionBody() {
     TRACE("wasm-decode %p...%p (%d bytes) %s\n",
           reinterpret_cast<const void*>(start_),
@@ -310,10 +321,10 @@ class LR_WasmDecoder : public Decoder {
             indentation(), startrel(pc_), opcode,
             WasmOpcodes::OpcodeName(opcode));
 
-      FunctionSig* sig = WasmOpcodes::Signature(opcode);
-      if (sig) {
+      const WasmOpcodeInfo& info = WasmOpcodes::Info(opcode);
+      if (info.opcode_class == kSimpleOpcodeClass) {
         // A simple expression with a fixed signature.
-        Shift(sig->GetReturn(), static_cast<uint32_t>(sig->parameter_count()));
+        Shift(WasmOpcodes::FixedSignature(info)->GetReturn(), info.arity);
         pc_ += len;
         if (pc_ >= limit_) {
           // End of code reached or exceeded.
@@ -411,7 +422,7 @@ class LR_WasmDecoder : public Decoder {
           Shift(kAstStmt, 1 + case_count);
 
           // Verify table.
-          for (int i = 0; i < table_count; i++) {
+          for (int i = 0; i < table_count && !verified_; i++) {
             uint16_t target = *reinterpret_cast<const uint16_t*>(pc_ + 5 + i * 2);
             if (target >= 0x8000) {
               size_t depth = target - 0x8000;
@@ -499,45 +510,6 @@ class LR_WasmDecoder : public Decoder {
           Shift(type, 1);
           break;
         }
-        case kExprI32LoadMem8S:
-        case kExprI32LoadMem8U:
-        case kExprI32LoadMem16S:
-        case kExprI32LoadMem16U:
-        case kExprI32LoadMem:
-	  len = DecodeLoadMem(pc_, kAstI32);
-          break;
-        case kExprI64LoadMem8S:
-        case kExprI64LoadMem8U:
-        case kExprI64LoadMem16S:
-        case kExprI64LoadMem16U:
-        case kExprI64LoadMem32S:
-        case kExprI64LoadMem32U:
-        case kExprI64LoadMem:
-          len = DecodeLoadMem(pc_, kAstI64);
-          break;
-        case kExprF32LoadMem:
-          len = DecodeLoadMem(pc_, kAstF32);
-          break;
-        case kExprF64LoadMem:
-          len = DecodeLoadMem(pc_, kAstF64);
-          break;
-        case kExprI32StoreMem8:
-        case kExprI32StoreMem16:
-        case kExprI32StoreMem:
-	  len = DecodeStoreMem(pc_, kAstI32);
-          break;
-        case kExprI64StoreMem8:
-        case kExprI64StoreMem16:
-        case kExprI64StoreMem32:
-        case kExprI64StoreMem:
-	  len = DecodeStoreMem(pc_, kAstI64);
-          break;
-        case kExprF32StoreMem:
-	  len = DecodeStoreMem(pc_, kAstF32);
-          break;
-        case kExprF64StoreMem:
-	  len = DecodeStoreMem(pc_, kAstF64);
-          break;
         case kExprMemorySize:
           Leaf(kAstI32, builder_.MemSize(0));
           break;
@@ -572,6 +544,21 @@ class LR_WasmDecoder : public Decoder {
           break;
         }
         default:
+          // Loads and stores are decoded by their opcode class.
+          if (info.opcode_class == kLoadMemOpcodeClass) {
+            len = DecodeLoadMem(pc_, WasmOpcodes::FixedSignature(info),
+                                static_cast<MemType>(info.mem_type));
+            break;
+          }
+          if (info.opcode_class == kStoreMemOpcodeClass) {
+            len = DecodeStoreMem(pc_, WasmOpcodes::FixedSignature(info),
+                                 static_cast<MemType>(info.mem_type));
+            break;
+          }
+          if (info.opcode_class == kAtomicMemOpcodeClass) {
+            len = DecodeAtomicMem(pc_, WasmOpcodes::FixedSignature(info));
+            break;
+          }
           error("Invalid opcode");
           return;
       }
@@ -590,22 +577,52 @@ class LR_WasmDecoder : public Decoder {
     blocks_.push_back({ssa_env, static_cast<int>(stack_.size() - 1)});
   }
 
-  int DecodeLoadMem(const byte* pc, LocalType type) {
+  int DecodeLoadMem(const byte* pc, FunctionSig* sig, MemType mem_type) {
     int length = 2;
     uint32_t offset;
     MemoryAccessOperand(pc, &length, &offset);
-    Shift(type, 1);
+    CheckAtomicity(pc, sig, mem_type, false);
+    Shift(sig->GetReturn(), 1);
     return length;
   }
 
-  int DecodeStoreMem(const byte* pc, LocalType type) {
+  int DecodeStoreMem(const byte* pc, FunctionSig* sig, MemType mem_type) {
     int length = 2;
     uint32_t offset;
     MemoryAccessOperand(pc, &length, &offset);
-    Shift(type, 2);
+    CheckAtomicity(pc, sig, mem_type, true);
+    Shift(sig->GetReturn(), 2);
     return length;
   }
 
+  int DecodeAtomicMem(const byte* pc, FunctionSig* sig) {
+    int length = 2;
+    uint32_t offset;
+    MemoryAccessOperand(pc, &length, &offset);
+    Shift(kAstI32, static_cast<int>(sig->parameter_count()));
+    return length;
+  }
+
+  // Only whole 32-bit integer words can be accessed atomically, with acquire
+  // semantics for loads and release semantics for stores.
+  void CheckAtomicity(const byte* pc, FunctionSig* sig, MemType mem_type,
+                      bool store) {
+    if (verified_)
+      return;
+    MemoryAccess::Atomicity atomicity = AtomicityOperand(pc);
+    if (atomicity == MemoryAccess::kNone)
+      return;
+    if (sig->GetReturn() != kAstI32 ||
+        WasmOpcodes::LocalTypeFor(mem_type) != kAstI32 ||
+        WasmOpcodes::MemSize(mem_type) != 4) {
+      error(pc, pc + 1, "atomic access must be a 32-bit integer access");
+    } else if (atomicity ==
+               (store ? MemoryAccess::kAcquire : MemoryAccess::kRelease)) {
+      error(pc, pc + 1, "invalid atomicity for a %s",
+            store ? "store" : "load");
+    }
+  }
+
   void AddImplicitReturnAtEnd() {
     int retcount = static_cast<int>(function_env_->sig->return_count());
     if (retcount == 0) {
@@ -651,9 +668,10 @@ class LR_WasmDecoder : public Decoder {
     TRACE("-----reduce module+%-6d %s func+%d: 0x%02x %s\n", baserel(p->pc()),
           indentation(), startrel(p->pc()), opcode,
           WasmOpcodes::OpcodeName(opcode));
-    FunctionSig* sig = WasmOpcodes::Signature(opcode);
-    if (sig) {
+    const WasmOpcodeInfo& info = WasmOpcodes::Info(opcode);
+    if (info.opcode_class == kSimpleOpcodeClass) {
       // A simple expression with a fixed signature.
+      FunctionSig* sig = WasmOpcodes::FixedSignature(info);
       TypeCheckLast(p, sig->GetParam(p->index - 1));
       if (p->done() && build()) {
         if (sig->parameter_count() == 2) {
@@ -948,60 +966,6 @@ class LR_WasmDecoder : public Decoder {
         break;
       }
 
-      case kExprI32LoadMem8S:
-        return ReduceLoadMem(p, kAstI32, kMemI8);
-      case kExprI32LoadMem8U:
-        return ReduceLoadMem(p, kAstI32, kMemU8);
-      case kExprI32LoadMem16S:
-        return ReduceLoadMem(p, kAstI32, kMemI16);
-      case kExprI32LoadMem16U:
-        return ReduceLoadMem(p, kAstI32, kMemU16);
-      case kExprI32LoadMem:
-        return ReduceLoadMem(p, kAstI32, kMemI32);
-
-      case kExprI64LoadMem8S:
-        return ReduceLoadMem(p, kAstI64, kMemI8);
-      case kExprI64LoadMem8U:
-        return ReduceLoadMem(p, kAstI64, kMemU8);
-      case kExprI64LoadMem16S:
-        return ReduceLoadMem(p, kAstI64, kMemI16);
-      case kExprI64LoadMem16U:
-        return ReduceLoadMem(p, kAstI64, kMemU16);
-      case kExprI64LoadMem32S:
-        return ReduceLoadMem(p, kAstI64, kMemI32);
-      case kExprI64LoadMem32U:
-        return ReduceLoadMem(p, kAstI64, kMemU32);
-      case kExprI64LoadMem:
-        return ReduceLoadMem(p, kAstI64, kMemI64);
-
-      case kExprF32LoadMem:
-        return ReduceLoadMem(p, kAstF32, kMemF32);
-
-      case kExprF64LoadMem:
-        return ReduceLoadMem(p, kAstF64, kMemF64);
-
-      case kExprI32StoreMem8:
-        return ReduceStoreMem(p, kAstI32, kMemI8);
-      case kExprI32StoreMem16:
-        return ReduceStoreMem(p, kAstI32, kMemI16);
-      case kExprI32StoreMem:
-        return ReduceStoreMem(p, kAstI32, kMemI32);
-
-      case kExprI64StoreMem8:
-        return ReduceStoreMem(p, kAstI64, kMemI8);
-      case kExprI64StoreMem16:
-        return ReduceStoreMem(p, kAstI64, kMemI16);
-      case kExprI64StoreMem32:
-        return ReduceStoreMem(p, kAstI64, kMemI32);
-      case kExprI64StoreMem:
-        return ReduceStoreMem(p, kAstI64, kMemI64);
-
-      case kExprF32StoreMem:
-        return ReduceStoreMem(p, kAstF32, kMemF32);
-
-      case kExprF64StoreMem:
-        return ReduceStoreMem(p, kAstF64, kMemF64);
-
       case kExprResizeMemL:
         TypeCheckLast(p, kAstI32);
         // TODO: build node for ResizeMemL
@@ -1054,6 +1018,18 @@ class LR_WasmDecoder : public Decoder {
         break;
       }
       default:
+        // Loads and stores are reduced by their opcode class.
+        if (info.opcode_class == kLoadMemOpcodeClass) {
+          LocalType type = WasmOpcodes::FixedSignature(info)->GetReturn();
+          return ReduceLoadMem(p, type, static_cast<MemType>(info.mem_type));
+        }
+        if (info.opcode_class == kStoreMemOpcodeClass) {
+          LocalType type = WasmOpcodes::FixedSignature(info)->GetReturn();
+          return ReduceStoreMem(p, type, static_cast<MemType>(info.mem_type));
+        }
+        if (info.opcode_class == kAtomicMemOpcodeClass) {
+          return ReduceAtomicMem(p, opcode);
+        }
         break;
     }
   }
@@ -1088,7 +1064,8 @@ class LR_WasmDecoder : public Decoder {
       int length = 0;
       uint32_t offset = 0;
       MemoryAccessOperand(p->pc(), &length, &offset);
-      p->tree->node = builder_.LoadMem(type, mem_type, p->last()->node, offset);
+      p->tree->node = builder_.LoadMem(type, mem_type, p->last()->node, offset,
+                                       AtomicityOperand(p->pc()));
     }
   }
 
@@ -1103,13 +1080,30 @@ class LR_WasmDecoder : public Decoder {
         uint32_t offset = 0;
         MemoryAccessOperand(p->pc(), &length, &offset);
         TFNode* val = p->tree->children[1]->node;
-        builder_.StoreMem(mem_type, p->tree->children[0]->node, offset, val);
+        builder_.StoreMem(mem_type, p->tree->children[0]->node, offset, val,
+                          AtomicityOperand(p->pc()));
         p->tree->node = val;
       }
     }
   }
 
+  void ReduceAtomicMem(Production* p, WasmOpcode opcode) {
+    TypeCheckLast(p, kAstI32);
+    if (p->done() && build()) {
+      int length = 0;
+      uint32_t offset = 0;
+      MemoryAccessOperand(p->pc(), &length, &offset);
+      TFNode* replacement = p->tree->count > 2
+          ? p->tree->children[2]->node : nullptr;
+      p->tree->node = builder_.AtomicMem(opcode, p->tree->children[0]->node,
+                                         offset, p->tree->children[1]->node,
+                                         replacement);
+    }
+  }
+
   void TypeCheckLast(Production* p, LocalType expected) {
+    if (verified_)
+      return;
     LocalType result = p->last()->type;
     if (result == expected) return;
     if (result == kAstEnd) return;
@@ -1377,6 +1371,10 @@ class LR_WasmDecoder : public Decoder {
     return result;
   }
 
+  MemoryAccess::Atomicity AtomicityOperand(const byte* pc) {
+    return MemoryAccess::AtomicityField::decode(Operand<uint8_t>(pc));
+  }
+
   void MemoryAccessOperand(const byte* pc, int* length, uint32_t* offset) {
     byte bitfield = Operand<uint8_t>(pc);
     if (MemoryAccess::OffsetField::decode(bitfield)) {
@@ -1462,15 +1460,47 @@ std::ostream& operator<<(std::ostream& os, const Tree& tree) {
   return os;
 }
 
-ReadUnsignedLEB128ErrorCode ReadUnsignedLEB128Operand(const byte* pc,
-                                                      const byte* limit,
-                                                      int* length,
-                                                      uint32_t* result) {
+ReadUnsignedLEB128ErrorCode ReadUnsignedLEB128Slow(const byte* pc,
+                                                   const byte* limit,
+                                                   int* length,
+                                                   uint32_t* result) {
+  if (limit - pc >= 5) {
+    // Enough bytes remain for the longest varint; decode without bounds
+    // checks. The first byte is known to have its continuation bit set.
+    uint32_t b = pc[0];
+    uint32_t val = b & 0x7F;
+    b = pc[1];
+    val |= (b & 0x7F) << 7;
+    if ((b & 0x80) == 0) {
+      *length = 2;
+      *result = val;
+      return kNoError;
+    }
+    b = pc[2];
+    val |= (b & 0x7F) << 14;
+    if ((b & 0x80) == 0) {
+      *length = 3;
+      *result = val;
+      return kNoError;
+    }
+    b = pc[3];
+    val |= (b & 0x7F) << 21;
+    if ((b & 0x80) == 0) {
+      *length = 4;
+      *result = val;
+      return kNoError;
+    }
+    b = pc[4];
+    val |= b << 28;
+    *length = 5;
+    *result = val;
+    return (b & 0x80) ? kInvalidLEB128 : kNoError;
+  }
+
+  // Near the end of the buffer, decode byte by byte.
   *result = 0;
   const byte* ptr = pc;
-  const byte* end = pc + 5;  // maximum 5 bytes.
-  if (end > limit)
-    end = limit;
+  const byte* end = limit;
   int shift = 0;
   byte b = 0;
   while (ptr < end) {
@@ -1482,117 +1512,108 @@ ReadUnsignedLEB128ErrorCode ReadUnsignedLEB128Operand(const byte* pc,
   }
   DCHECK_LE(ptr - pc, 5);
   *length = static_cast<int>(ptr - pc);
-  if (ptr == end && (b & 0x80)) {
-    return kInvalidLEB128;
-  } else if (*length == 0) {
+  if (*length == 0) {
     return kMissingLEB128;
+  } else if (b & 0x80) {
+    return kInvalidLEB128;
   } else {
     return kNoError;
   }
 }
 
-int OpcodeLength(const byte* pc) {
-  switch (static_cast<WasmOpcode>(*pc)) {
-#define DECLARE_OPCODE_CASE(name, opcode, sig) case kExpr##name:
-    FOREACH_LOAD_MEM_OPCODE(DECLARE_OPCODE_CASE)
-    FOREACH_STORE_MEM_OPCODE(DECLARE_OPCODE_CASE)
-#undef DECLARE_OPCODE_CASE
-
-    case kExprI8Const:
-    case kExprBlock:
-    case kExprLoop:
-    case kExprBr:
-    case kExprBrIf:
-      return 2;
-    case kExprI32Const:
-    case kExprF32Const:
-      return 5;
-    case kExprI64Const:
-    case kExprF64Const:
-      return 9;
-    case kExprStoreGlobal:
-    case kExprSetLocal:
-    case kExprLoadGlobal:
-    case kExprCallFunction:
-    case kExprCallIndirect:
-    case kExprGetLocal: {
-      int length;
-      uint32_t result = 0;
-      ReadUnsignedLEB128Operand(pc + 1, pc + 6, &length, &result);
-      return 1 + length;
-    }
-    case kExprTableSwitch: {
-      uint16_t table_count = *reinterpret_cast<const uint16_t*>(pc + 3);
-      return 5 + table_count * 2;
+const byte* ReadUnsignedLEB128Run(const byte* pc,
+                                  const byte* limit,
+                                  uint32_t count,
+                                  uint32_t* results) {
+  for (uint32_t i = 0; i < count; i++) {
+    int length;
+    uint32_t result;
+    if (ReadUnsignedLEB128Operand(pc, limit, &length, &result) != kNoError) {
+      return nullptr;
     }
+    if (results) results[i] = result;
+    pc += length;
+  }
+  return pc;
+}
 
+int OpcodeLength(const byte* pc) {
+  int length = WasmOpcodes::Info(*pc).length;
+  switch (WasmOpcodes::Class(*pc)) {
+    case kLoadMemOpcodeClass:
+    case kStoreMemOpcodeClass:
+    case kAtomicMemOpcodeClass:
+      if (MemoryAccess::OffsetField::decode(pc[1])) {
+        // The memory access byte is followed by a LEB128 offset.
+        uint32_t offset = 0;
+        ReadUnsignedLEB128Operand(pc + 2, pc + 7, &length, &offset);
+        return 2 + length;
+      }
+      return length;
     default:
-      return 1;
+      break;
+  }
+  if (length != WasmOpcodeInfo::kVariableLength) return length;
+
+  if (*pc == kExprTableSwitch) {
+    uint16_t table_count = *reinterpret_cast<const uint16_t*>(pc + 3);
+    return 5 + table_count * 2;
   }
+  // All other variable-length opcodes have a single LEB128 immediate.
+  uint32_t result = 0;
+  ReadUnsignedLEB128Operand(pc + 1, pc + 6, &length, &result);
+  return 1 + length;
 }
 
-int OpcodeArity(FunctionEnv* env, const byte* pc) {
-#define DECLARE_ARITY(name, ...)                          \
-  static const LocalType kTypes_##name[] = {__VA_ARGS__}; \
-  static const int kArity_##name =                        \
-      static_cast<int>(arraysize(kTypes_##name) - 1);
+bool CollectDirectCallees(const byte* start, const byte* end,
+                          ZoneVector<uint32_t>* callees) {
+  // Expressions are encoded in prefix order, so the body is a flat sequence
+  // of opcodes and their immediates.
+  for (const byte* pc = start; pc < end; pc += OpcodeLength(pc)) {
+    switch (static_cast<WasmOpcode>(*pc)) {
+      case kExprCallFunction: {
+        int length;
+        uint32_t index = 0;
+        ReadUnsignedLEB128Operand(pc + 1, end, &length, &index);
+        callees->push_back(index);
+        break;
+      }
+      case kExprCallIndirect:
+        return false;
+      default:
+        break;
+    }
+  }
+  return true;
+}
 
-  FOREACH_SIGNATURE(DECLARE_ARITY);
-#undef DECLARE_ARITY
+int OpcodeArity(FunctionEnv* env, const byte* pc) {
+  int arity = WasmOpcodes::Info(*pc).arity;
+  if (arity != WasmOpcodeInfo::kVariableArity) return arity;
 
+  int length;
+  uint32_t index = 0;
   switch (static_cast<WasmOpcode>(*pc)) {
-    case kExprI8Const:
-    case kExprI32Const:
-    case kExprI64Const:
-    case kExprF64Const:
-    case kExprF32Const:
-    case kExprGetLocal:
-    case kExprLoadGlobal:
-    case kExprNop:
-    case kExprUnreachable: 
-      return 0;
-
-    case kExprBr:
-    case kExprStoreGlobal:
-    case kExprSetLocal:
-      return 1;
-
-    case kExprIf:
-    case kExprBrIf:
-      return 2;
-    case kExprIfThen:
-    case kExprSelect:
-      return 3;
     case kExprBlock:
     case kExprLoop:
       return *(pc + 1);
-
-    case kExprCallFunction: {
-      int index = *(pc + 1);
+    case kExprCallFunction:
+      ReadUnsignedLEB128Operand(pc + 1, pc + 6, &length, &index);
       return static_cast<int>(
           env->module->GetFunctionSignature(index)->parameter_count());
-    }
-    case kExprCallIndirect: {
-      int index = *(pc + 1);
+    case kExprCallIndirect:
+      ReadUnsignedLEB128Operand(pc + 1, pc + 6, &length, &index);
       return 1 + static_cast<int>(
                      env->module->GetSignature(index)->parameter_count());
-    }
-    case kExprReturn: 
+    case kExprReturn:
       return static_cast<int>(env->sig->return_count());
     case kExprTableSwitch: {
       uint16_t case_count = *reinterpret_cast<const uint16_t*>(pc + 1);
       return 1 + case_count;
     }
-
-#define DECLARE_OPCODE_CASE(name, opcode, sig) \
-  case kExpr##name:                            \
-    return kArity_##sig;
-
-      FOREACH_LOAD_MEM_OPCODE(DECLARE_OPCODE_CASE)
-      FOREACH_STORE_MEM_OPCODE(DECLARE_OPCODE_CASE)
-      FOREACH_MISC_MEM_OPCODE(DECLARE_OPCODE_CASE)
-      FOREACH_SIMPLE_OPCODE(DECLARE_OPCODE_CASE)
-#undef DECLARE_OPCODE_CASE
+    default:
+      UNREACHABLE();
+      return 0;
   }
 }
 }
@@ -120,10 +120,33 @@ inline TreeResult BuildTFGraph(TFGraph* graph,
 
 enum ReadUnsignedLEB128ErrorCode { kNoError, kInvalidLEB128, kMissingLEB128 };
 
-ReadUnsignedLEB128ErrorCode ReadUnsignedLEB128Operand(const byte*,
-                                                      const byte*,
-                                                      int*,
-                                                      uint32_t*);
+// Slow path of {ReadUnsignedLEB128Operand} for varints longer than one byte.
+ReadUnsignedLEB128ErrorCode ReadUnsignedLEB128Slow(const byte* pc,
+                                                   const byte* limit,
+                                                   int* length,
+                                                   uint32_t* result);
+
+// Reads an unsigned LEB128 varint of at most 5 bytes from [pc, limit). This
+// is shared by all decoders; most indices fit in a single byte.
+inline ReadUnsignedLEB128ErrorCode ReadUnsignedLEB128Operand(const byte* pc,
+                                                             const byte* limit,
+                                                             int* length,
+                                                             uint32_t* result) {
+  if (V8_LIKELY(pc < limit && (*pc & 0x80) == 0)) {
+    *length = 1;
+    *result = *pc;
+    return kNoError;
+  }
+  return ReadUnsignedLEB128Slow(pc, limit, length, result);
+}
+
+// Validates a run of {count} consecutive LEB128 varints starting at {pc},
+// storing their values into {results} unless it is nullptr. Returns the end
+// of the run, or nullptr if a varint is invalid or crosses {limit}.
+const byte* ReadUnsignedLEB128Run(const byte* pc,
+                                  const byte* limit,
+                                  uint32_t count,
+                                  uint32_t* results);
 
 // Computes the length of the opcode at the given address.
 int OpcodeLength(const byte* pc);
@@ -131,6 +154,12 @@ int OpcodeLength(const byte* pc);
 // Computes the arity (number of sub-nodes) of the opcode at the given address.
 int OpcodeArity(FunctionEnv* env, const byte* pc);
 
+// Appends the indices of the functions called directly from the verified
+// function body [start, end) to {callees}. Returns false if the body makes
+// indirect calls, whose targets are not known statically.
+bool CollectDirectCallees(const byte* start, const byte* end,
+                          ZoneVector<uint32_t>* callees);
+
 #if DEBUG
 #define TRACE(...)               \
   do {                           \
@@ -228,28 +257,14 @@ class Decoder {
       return traceOffEnd<uint32_t>();
     }
 
-    const byte* pos = pc_;
-    const byte* end = pc_ + 5;
-    if (end > limit_)
-      end = limit_;
-
-    uint32_t result = 0;
-    int shift = 0;
-    byte b = 0;
-    while (pc_ < end) {
-      b = *pc_++;
-      TRACE("%02x ", b);
-      result = result | ((b & 0x7F) << shift);
-      if ((b & 0x80) == 0)
-        break;
-      shift += 7;
-    }
-
-    *length = static_cast<int>(pc_ - pos);
-    if (pc_ == end && (b & 0x80)) {
+    uint32_t result;
+    ReadUnsignedLEB128ErrorCode error_code =
+        ReadUnsignedLEB128Operand(pc_, limit_, length, &result);
+    pc_ += *length;
+    if (error_code == kInvalidLEB128) {
       error(pc_ - 1, "varint too large");
     } else {
-      TRACE("= %u\n", result);
+      TRACE("%u (%d bytes)\n", result, *length);
     }
     return result;
   }
@@ -51,6 +51,27 @@ void EmitVarInt(byte** b, size_t val) {
     }
   }
 }
+
+size_t SizeOfVarInt(size_t value) {
+  size_t size = 0;
+  do {
+    size++;
+    value = value >> 7;
+  } while (value > 0);
+  return size;
+}
+
+// Computes the payload size of a section holding {count} entries that take
+// {entries_size} bytes in total, or 0 if the section is to be omitted.
+size_t SectionSize(size_t count, size_t entries_size) {
+  return count > 0 ? SizeOfVarInt(count) + entries_size : 0;
+}
+
+// Emits a section code followed by the size of the section payload.
+void EmitSectionHeader(byte** b, WasmSectionDeclCode code, size_t size) {
+  EmitUint8(b, code);
+  EmitVarInt(b, size);
+}
 }
 
 struct WasmFunctionBuilder::Type {
@@ -223,12 +244,12 @@ WasmFunctionEncoder::WasmFunctionEncoder(Zone* zone,
 }
 
 uint32_t WasmFunctionEncoder::HeaderSize() const {
-  uint32_t size = 3;
+  size_t size = 1 + SizeOfVarInt(signature_index_);
   if (HasLocals())
     size += 8;
   if (!external_)
-    size += 2;
-  return size;
+    size += SizeOfVarInt(body_.size());
+  return static_cast<uint32_t>(size);
 }
 
 uint32_t WasmFunctionEncoder::BodySize(void) const {
@@ -243,7 +264,7 @@ void WasmFunctionEncoder::Serialize(byte* buffer,
                       (HasLocals() ? kDeclFunctionLocals : 0);
 
   EmitUint8(header, decl_bits);
-  EmitUint16(header, signature_index_);
+  EmitVarInt(header, signature_index_);
 
   if (HasLocals()) {
     EmitUint16(header, local_int32_count_);
@@ -253,7 +274,7 @@ void WasmFunctionEncoder::Serialize(byte* buffer,
   }
 
   if (!external_) {
-    EmitUint16(header, static_cast<uint16_t>(body_.size()));
+    EmitVarInt(header, body_.size());
     std::memcpy(*header, body_.data(), body_.size());
     (*header) += body_.size();
   }
@@ -291,6 +312,36 @@ void WasmDataSegmentEncoder::Serialize(byte* buffer,
   (*body) += data_.size();
 }
 
+bool WasmDataSegmentEncoder::Overlaps(
+    const WasmDataSegmentEncoder* other) const {
+  uint64_t end = static_cast<uint64_t>(dest_) + data_.size();
+  uint64_t other_end =
+      static_cast<uint64_t>(other->dest_) + other->data_.size();
+  return dest_ < other_end && other->dest_ < end;
+}
+
+void WasmDataSegmentEncoder::SplitAtZeroRuns(
+    Zone* zone, ZoneVector<WasmDataSegmentEncoder*>* segments) const {
+  size_t size = data_.size();
+  size_t start = 0;
+  while (start < size) {
+    if (data_[start] == 0) {
+      start++;
+      continue;
+    }
+    // Extend the part until a zero run that is worth a new segment header.
+    size_t end = start + 1;
+    for (size_t i = end; i < size && i - end <= kDeclDataSegmentSize; i++) {
+      if (data_[i] != 0)
+        end = i + 1;
+    }
+    segments->push_back(new (zone) WasmDataSegmentEncoder(
+        zone, &data_[start], static_cast<uint32_t>(end - start),
+        dest_ + static_cast<uint32_t>(start)));
+    start = end;
+  }
+}
+
 WasmModuleBuilder::WasmModuleBuilder(Zone* zone)
     : zone_(zone),
       signatures_(zone),
@@ -301,9 +352,9 @@ WasmModuleBuilder::WasmModuleBuilder(Zone* zone)
       signature_map_(zone) {
 }
 
-uint16_t WasmModuleBuilder::AddFunction() {
+uint32_t WasmModuleBuilder::AddFunction() {
   functions_.push_back(new (zone_) WasmFunctionBuilder(zone_));
-  return static_cast<uint16_t>(functions_.size() - 1);
+  return static_cast<uint32_t>(functions_.size() - 1);
 }
 
 WasmFunctionBuilder* WasmModuleBuilder::FunctionAt(size_t index) {
@@ -343,19 +394,19 @@ int WasmModuleBuilder::CompareFunctionSigs::operator()(FunctionSig* a,
   return 0;
 }
 
-uint16_t WasmModuleBuilder::AddSignature(FunctionSig* sig) {
+uint32_t WasmModuleBuilder::AddSignature(FunctionSig* sig) {
   SignatureMap::iterator pos = signature_map_.find(sig);
   if (pos != signature_map_.end()) {
     return pos->second;
   } else {
-    uint16_t index = static_cast<uint16_t>(signatures_.size());
+    uint32_t index = static_cast<uint32_t>(signatures_.size());
     signature_map_[sig] = index;
     signatures_.push_back(sig);
     return index;
   }
 }
 
-void WasmModuleBuilder::AddIndirectFunction(uint16_t index) {
+void WasmModuleBuilder::AddIndirectFunction(uint32_t index) {
   indirect_functions_.push_back(index);
 }
 
@@ -364,8 +415,19 @@ WasmModuleWriter* WasmModuleBuilder::Build(Zone* zone) {
   for (auto function : functions_) {
     writer->functions_.push_back(function->Build(zone, this));
   }
-  for (auto segment : data_segments_) {
-    writer->data_segments_.push_back(segment);
+  for (size_t i = 0; i < data_segments_.size(); i++) {
+    WasmDataSegmentEncoder* segment = data_segments_[i];
+    // Memory starts out zeroed, so zeros need not be written unless an
+    // earlier segment has written to the same addresses.
+    bool overlaps = false;
+    for (size_t j = 0; j < i && !overlaps; j++) {
+      overlaps = segment->Overlaps(data_segments_[j]);
+    }
+    if (overlaps) {
+      writer->data_segments_.push_back(segment);
+    } else {
+      segment->SplitAtZeroRuns(zone, &writer->data_segments_);
+    }
   }
   for (auto sig : signatures_) {
     writer->signatures_.push_back(sig);
@@ -403,45 +465,52 @@ struct Sizes {
     body_size += body;
   }
 
+  // Adds a section with a payload of {size} bytes, preceded by the section
+  // code and the payload size. Empty sections are omitted.
   void AddSection(size_t size) {
-    if (size > 0) {
-      Add(1, 0);
-      while (size > 0) {
-        Add(1, 0);
-        size = size >> 7;
-      }
-    }
+    if (size > 0)
+      Add(1 + SizeOfVarInt(size) + size, 0);
   }
 };
 
 WasmModuleIndex* WasmModuleWriter::WriteTo(Zone* zone) const {
   Sizes sizes = {0, 0};
 
-  sizes.Add(1, 0);
-  sizes.Add(kDeclMemorySize, 0);
+  sizes.AddSection(kDeclMemorySize);
 
-  sizes.AddSection(signatures_.size());
+  size_t signatures_size = 0;
   for (auto sig : signatures_) {
-    sizes.Add(2 + sig->parameter_count(), 0);
+    signatures_size += 2 + sig->parameter_count();
   }
+  signatures_size = SectionSize(signatures_.size(), signatures_size);
+  sizes.AddSection(signatures_size);
 
-  sizes.AddSection(globals_.size());
-  if (globals_.size() > 0) {
-    sizes.Add(kDeclGlobalSize * globals_.size(), 0);
-  }
+  size_t globals_size =
+      SectionSize(globals_.size(), kDeclGlobalSize * globals_.size());
+  sizes.AddSection(globals_size);
 
-  sizes.AddSection(functions_.size());
+  size_t functions_size = 0;
   for (auto function : functions_) {
-    sizes.Add(function->HeaderSize() + function->BodySize(), 0);
+    functions_size += function->HeaderSize() + function->BodySize();
   }
+  functions_size = SectionSize(functions_.size(), functions_size);
+  sizes.AddSection(functions_size);
 
-  sizes.AddSection(data_segments_.size());
+  size_t data_segments_size = 0;
   for (auto segment : data_segments_) {
-    sizes.Add(segment->HeaderSize(), segment->BodySize());
+    data_segments_size += segment->HeaderSize();
+    sizes.Add(0, segment->BodySize());
   }
+  data_segments_size = SectionSize(data_segments_.size(), data_segments_size);
+  sizes.AddSection(data_segments_size);
 
-  sizes.AddSection(indirect_functions_.size());
-  sizes.Add(2 * static_cast<uint32_t>(indirect_functions_.size()), 0);
+  size_t function_table_size = 0;
+  for (auto index : indirect_functions_) {
+    function_table_size += SizeOfVarInt(index);
+  }
+  function_table_size =
+      SectionSize(indirect_functions_.size(), function_table_size);
+  sizes.AddSection(function_table_size);
 
   if (sizes.body_size > 0)
     sizes.Add(1, 0);
@@ -452,14 +521,14 @@ WasmModuleIndex* WasmModuleWriter::WriteTo(Zone* zone) const {
   byte* body = buffer + sizes.header_size;
 
   // -- emit memory declaration ------------------------------------------------
-  EmitUint8(&header, kDeclMemory);
+  EmitSectionHeader(&header, kDeclMemory, kDeclMemorySize);
   EmitUint8(&header, 16);  // min memory size
   EmitUint8(&header, 16);  // max memory size
   EmitUint8(&header, 0);   // memory export
 
   // -- emit globals -----------------------------------------------------------
   if (globals_.size() > 0) {
-    EmitUint8(&header, kDeclGlobals);
+    EmitSectionHeader(&header, kDeclGlobals, globals_size);
     EmitVarInt(&header, globals_.size());
 
     for (auto global : globals_) {
@@ -471,7 +540,7 @@ WasmModuleIndex* WasmModuleWriter::WriteTo(Zone* zone) const {
 
   // -- emit signatures --------------------------------------------------------
   if (signatures_.size() > 0) {
-    EmitUint8(&header, kDeclSignatures);
+    EmitSectionHeader(&header, kDeclSignatures, signatures_size);
     EmitVarInt(&header, signatures_.size());
 
     for (FunctionSig* sig : signatures_) {
@@ -485,7 +554,7 @@ WasmModuleIndex* WasmModuleWriter::WriteTo(Zone* zone) const {
 
   // -- emit functions ---------------------------------------------------------
   if (functions_.size() > 0) {
-    EmitUint8(&header, kDeclFunctions);
+    EmitSectionHeader(&header, kDeclFunctions, functions_size);
     EmitVarInt(&header, functions_.size());
 
     for (auto func : functions_) {
@@ -495,7 +564,7 @@ WasmModuleIndex* WasmModuleWriter::WriteTo(Zone* zone) const {
 
   // -- emit data segments -----------------------------------------------------
   if (data_segments_.size() > 0) {
-    EmitUint8(&header, kDeclDataSegments);
+    EmitSectionHeader(&header, kDeclDataSegments, data_segments_size);
     EmitVarInt(&header, data_segments_.size());
 
     for (auto segment : data_segments_) {
@@ -505,11 +574,11 @@ WasmModuleIndex* WasmModuleWriter::WriteTo(Zone* zone) const {
 
   // -- emit function table ----------------------------------------------------
   if (indirect_functions_.size() > 0) {
-    EmitUint8(&header, kDeclFunctionTable);
+    EmitSectionHeader(&header, kDeclFunctionTable, function_table_size);
     EmitVarInt(&header, indirect_functions_.size());
 
     for (auto index : indirect_functions_) {
-      EmitUint16(&header, index);
+      EmitVarInt(&header, index);
     }
   }
 
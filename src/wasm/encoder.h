@@ -32,7 +32,7 @@ class WasmFunctionEncoder : public ZoneObject {
                       uint8_t exported,
                       uint8_t external);
   friend class WasmFunctionBuilder;
-  uint16_t signature_index_;
+  uint32_t signature_index_;
   ZoneVector<uint8_t> params_;
   uint16_t local_int32_count_;
   uint16_t local_int64_count_;
@@ -89,6 +89,15 @@ class WasmDataSegmentEncoder : public ZoneObject {
   uint32_t BodySize() const;
   void Serialize(byte* buffer, byte** header, byte** body) const;
 
+  // Checks whether this segment and {other} write to common addresses.
+  bool Overlaps(const WasmDataSegmentEncoder* other) const;
+
+  // Appends the parts of this segment that are separated by runs of zeros
+  // longer than a segment header to {segments}, without leading or trailing
+  // zeros. An all-zero segment appends nothing.
+  void SplitAtZeroRuns(Zone* zone,
+                       ZoneVector<WasmDataSegmentEncoder*>* segments) const;
+
  private:
   ZoneVector<byte> data_;
   uint32_t dest_;
@@ -117,32 +126,32 @@ class WasmModuleWriter : public ZoneObject {
   ZoneVector<WasmFunctionEncoder*> functions_;
   ZoneVector<WasmDataSegmentEncoder*> data_segments_;
   ZoneVector<FunctionSig*> signatures_;
-  ZoneVector<uint16_t> indirect_functions_;
+  ZoneVector<uint32_t> indirect_functions_;
   ZoneVector<std::pair<uint8_t, uint8_t>> globals_;
 };
 
 class WasmModuleBuilder : public ZoneObject {
  public:
   WasmModuleBuilder(Zone* zone);
-  uint16_t AddFunction();
+  uint32_t AddFunction();
   uint32_t AddGlobal(uint8_t type, uint8_t exported);
   WasmFunctionBuilder* FunctionAt(size_t index);
   void AddDataSegment(WasmDataSegmentEncoder* data);
-  uint16_t AddSignature(FunctionSig* sig);
-  void AddIndirectFunction(uint16_t index);
+  uint32_t AddSignature(FunctionSig* sig);
+  void AddIndirectFunction(uint32_t index);
   WasmModuleWriter* Build(Zone* zone);
 
  private:
   struct CompareFunctionSigs {
     int operator()(FunctionSig* a, FunctionSig* b);
   };
-  typedef ZoneMap<FunctionSig*, uint16_t, CompareFunctionSigs> SignatureMap;
+  typedef ZoneMap<FunctionSig*, uint32_t, CompareFunctionSigs> SignatureMap;
 
   Zone* zone_;
   ZoneVector<FunctionSig*> signatures_;
   ZoneVector<WasmFunctionBuilder*> functions_;
   ZoneVector<WasmDataSegmentEncoder*> data_segments_;
-  ZoneVector<uint16_t> indirect_functions_;
+  ZoneVector<uint32_t> indirect_functions_;
   ZoneVector<std::pair<uint8_t, uint8_t>> globals_;
   SignatureMap signature_map_;
 };
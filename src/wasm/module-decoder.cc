@@ -47,12 +47,9 @@ class ModuleDecoder : public Decoder {
     module->min_mem_size_log2 = 0;
     module->max_mem_size_log2 = 0;
     module->mem_export = false;
+    module->mem_shared = false;
     module->mem_external = false;
-    module->globals = new std::vector<WasmGlobal>();
-    module->signatures = new std::vector<FunctionSig*>();
-    module->functions = new std::vector<WasmFunction>();
-    module->data_segments = new std::vector<WasmDataSegment>();
-    module->function_table = new std::vector<uint16_t>();
+    module->function_bodies_verified = false;
 
     bool sections[kMaxModuleSectionCode];
     memset(sections, 0, sizeof(sections));
@@ -62,6 +59,24 @@ class ModuleDecoder : public Decoder {
       TRACE("DecodeSection\n");
       WasmSectionDeclCode section =
           static_cast<WasmSectionDeclCode>(u8("section"));
+      if (section == kDeclEnd) {
+        // Terminate section decoding.
+        limit_ = pc_;
+        break;
+      }
+
+      // Every other section is prefixed with the size of its payload.
+      int length;
+      uint32_t section_size = u32v(&length, "section size");
+      if (failed())
+        break;
+      if (section_size > static_cast<size_t>(limit_ - pc_)) {
+        error(pc_ - length, limit_,
+              "expected %u bytes for section, fell off end", section_size);
+        break;
+      }
+      const byte* section_end = pc_ + section_size;
+
       // Each section should appear at most once.
       if (section < kMaxModuleSectionCode) {
         CheckForPreviousSection(sections, section, false);
@@ -69,19 +84,20 @@ class ModuleDecoder : public Decoder {
       }
 
       switch (section) {
-        case kDeclEnd:
-          // Terminate section decoding.
-          limit_ = pc_;
-          break;
-        case kDeclMemory:
+        case kDeclMemory: {
           module->min_mem_size_log2 = u8("min memory");
           module->max_mem_size_log2 = u8("max memory");
-          module->mem_export = u8("export memory") != 0;
+          uint8_t flags = u8("memory flags");
+          module->mem_export = (flags & kDeclMemoryExport) != 0;
+          module->mem_shared = (flags & kDeclMemoryShared) != 0;
           break;
+        }
         case kDeclSignatures: {
           int length;
           uint32_t signatures_count = u32v(&length, "signatures count");
-          module->signatures->reserve(SafeReserve(signatures_count));
+          signatures_count =
+              CheckedCount(signatures_count, kMinSignatureSize, "signatures");
+          module->signatures->reserve(signatures_count);
           // Decode signatures.
           for (uint32_t i = 0; i < signatures_count; i++) {
             if (failed())
@@ -98,7 +114,9 @@ class ModuleDecoder : public Decoder {
           CheckForPreviousSection(sections, kDeclSignatures, true);
           int length;
           uint32_t functions_count = u32v(&length, "functions count");
-          module->functions->reserve(SafeReserve(functions_count));
+          functions_count =
+              CheckedCount(functions_count, kMinFunctionSize, "functions");
+          module->functions->reserve(functions_count);
           // Set up module environment for verification.
           ModuleEnv menv;
           menv.module = module;
@@ -114,8 +132,17 @@ class ModuleDecoder : public Decoder {
             TRACE("DecodeFunction[%d] module+%d\n", i,
                   static_cast<int>(pc_ - start_));
 
-            module->functions->push_back(
-                {nullptr, 0, 0, 0, 0, 0, 0, false, false});
+            module->functions->push_back({nullptr,  // sig
+                                          0,        // sig_index
+                                          0,        // name_offset
+                                          0,        // code_start_offset
+                                          0,        // code_end_offset
+                                          0,        // local_int32_count
+                                          0,        // local_int64_count
+                                          0,        // local_float32_count
+                                          0,        // local_float64_count
+                                          false,    // exported
+                                          false});  // external
             WasmFunction* function = &module->functions->back();
             DecodeFunctionInModule(module, function, false);
           }
@@ -136,7 +163,9 @@ class ModuleDecoder : public Decoder {
         case kDeclGlobals: {
           int length;
           uint32_t globals_count = u32v(&length, "globals count");
-          module->globals->reserve(SafeReserve(globals_count));
+          globals_count =
+              CheckedCount(globals_count, kDeclGlobalSize, "globals");
+          module->globals->reserve(globals_count);
           // Decode globals.
           for (uint32_t i = 0; i < globals_count; i++) {
             if (failed())
@@ -152,7 +181,9 @@ class ModuleDecoder : public Decoder {
         case kDeclDataSegments: {
           int length;
           uint32_t data_segments_count = u32v(&length, "data segments count");
-          module->data_segments->reserve(SafeReserve(data_segments_count));
+          data_segments_count = CheckedCount(
+              data_segments_count, kDeclDataSegmentSize, "data segments");
+          module->data_segments->reserve(data_segments_count);
           // Decode data segments.
           for (uint32_t i = 0; i < data_segments_count; i++) {
             if (failed())
@@ -170,35 +201,65 @@ class ModuleDecoder : public Decoder {
           CheckForPreviousSection(sections, kDeclFunctions, true);
           int length;
           uint32_t function_table_count = u32v(&length, "function table count");
-          module->function_table->reserve(SafeReserve(function_table_count));
-          // Decode function table.
+          function_table_count = CheckedCount(
+              function_table_count, kMinFunctionTableEntrySize,
+              "function table entries");
+          if (failed() || function_table_count == 0)
+            break;
+          // Decode the function table as a single run of varints.
+          TRACE("DecodeFunctionTable[%u] module+%d\n", function_table_count,
+                static_cast<int>(pc_ - start_));
+          module->function_table->resize(function_table_count);
+          uint32_t* entries = &module->function_table->at(0);
+          const byte* table_start = pc_;
+          pc_ = ReadUnsignedLEB128Run(table_start, limit_,
+                                      function_table_count, entries);
+          if (pc_ == nullptr) {
+            pc_ = table_start;
+            error("invalid function table entry");
+            break;
+          }
           for (uint32_t i = 0; i < function_table_count; i++) {
-            if (failed())
-              break;
-            TRACE("DecodeFunctionTable[%d] module+%d\n", i,
-                  static_cast<int>(pc_ - start_));
-            uint16_t index = u16();
-            if (index >= module->functions->size()) {
-              error(pc_ - 2, "invalid function index");
+            if (entries[i] >= module->functions->size()) {
+              // Find the offending entry only for the error message.
+              error(ReadUnsignedLEB128Run(table_start, limit_, i, nullptr),
+                    "invalid function index");
               break;
             }
-            module->function_table->push_back(index);
           }
           break;
         }
         default:
-          error(pc_ - 1, nullptr, "unrecognized section 0x%02x", section);
+          // Unknown sections can be skipped thanks to their size prefix.
+          TRACE("  skipping unknown section 0x%02x (%u bytes)\n", section,
+                section_size);
+          pc_ = section_end;
           break;
       }
+
+      if (ok() && pc_ != section_end) {
+        error(pc_, section_end, "section size mismatch, expected %u bytes",
+              section_size);
+      }
     }
 
+    // Compilation skips the checks that the verified bodies passed.
+    module->function_bodies_verified = verify_functions && ok();
     return toResult(module);
   }
 
-  uint32_t SafeReserve(uint32_t count) {
-    // Avoid OOM by only reserving up to a certain size.
-    const uint32_t kMaxReserve = 20000;
-    return count < kMaxReserve ? count : kMaxReserve;
+  // Checks that {count} entries of at least {min_size} bytes each fit in the
+  // remaining module bytes, so that the metadata arrays can be allocated with
+  // their exact size upfront without risking OOM on malformed counts.
+  // Returns 0 and signals an error if they do not fit.
+  uint32_t CheckedCount(uint32_t count, size_t min_size, const char* name) {
+    size_t available = static_cast<size_t>(limit_ - pc_);
+    if (count > available / min_size) {
+      error(pc_, nullptr, "%u %s do not fit in the remaining %u module bytes",
+            count, name, static_cast<unsigned>(available));
+      return 0;
+    }
+    return count;
   }
 
   void CheckForPreviousSection(bool* sections,
@@ -292,7 +353,8 @@ class ModuleDecoder : public Decoder {
     byte decl_bits = u8("function decl");
 
     const byte* sigpos = pc_;
-    function->sig_index = u16("signature index");
+    int length;
+    function->sig_index = u32v(&length, "signature index");
 
     if (function->sig_index >= module->signatures->size()) {
       return error(sigpos, "invalid signature index");
@@ -327,11 +389,11 @@ class ModuleDecoder : public Decoder {
       function->local_float64_count = u16("float64 count");
     }
 
-    uint16_t size = u16("body size");
+    uint32_t size = u32v(&length, "body size");
     if (ok()) {
-      if ((pc_ + size) > limit_) {
+      if (size > static_cast<size_t>(limit_ - pc_)) {
         return error(pc_, limit_,
-                     "expected %d bytes for function body, fell off end", size);
+                     "expected %u bytes for function body, fell off end", size);
       }
       function->code_start_offset = static_cast<uint32_t>(pc_ - start_);
       function->code_end_offset = function->code_start_offset + size;
@@ -494,7 +556,6 @@ class FunctionError : public FunctionResult {
 };
 
 ModuleResult DecodeWasmModule(Isolate* isolate,
-                              Zone* zone,
                               const byte* module_start,
                               const byte* module_end,
                               bool verify_functions,
@@ -505,7 +566,7 @@ ModuleResult DecodeWasmModule(Isolate* isolate,
   if (size >= kMaxModuleSize)
     return ModuleError("size > maximum module size");
   WasmModule* module = new WasmModule();
-  ModuleDecoder decoder(zone, module_start, module_end, asm_js);
+  ModuleDecoder decoder(module->zone, module_start, module_end, asm_js);
   return decoder.DecodeModule(module, verify_functions);
 }
 
@@ -12,8 +12,8 @@ namespace v8 {
 namespace internal {
 namespace wasm {
 // Decodes the bytes of a WASM module between {module_start} and {module_end}.
+// All metadata is allocated in the zone owned by the resulting module.
 ModuleResult DecodeWasmModule(Isolate* isolate,
-                              Zone* zone,
                               const byte* module_start,
                               const byte* module_end,
                               bool verify_functions,
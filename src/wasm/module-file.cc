@@ -0,0 +1,153 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/v8.h"
+
+#include "src/base/platform/platform.h"
+#include "src/base/smart-pointers.h"
+
+#include "src/wasm/module-decoder.h"
+#include "src/wasm/module-file.h"
+#include "src/wasm/wasm-result.h"
+
+#if V8_OS_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if V8_OS_LINUX
+#include <sys/syscall.h>
+#endif
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+#if V8_OS_POSIX
+ModuleFile* ModuleFile::Open(const char* path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return nullptr;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    close(fd);
+    return nullptr;
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  void* memory = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (memory == MAP_FAILED) {
+    close(fd);
+    return nullptr;
+  }
+  // The file stays open for mapping data segments.
+  return new ModuleFile(reinterpret_cast<const byte*>(memory), size, fd,
+                        nullptr);
+}
+
+ModuleFile* ModuleFile::FromBytes(const byte* start, const byte* end) {
+  size_t size = static_cast<size_t>(end - start);
+  if (size == 0)
+    return nullptr;
+#if V8_OS_LINUX && defined(__NR_memfd_create)
+  int fd = static_cast<int>(syscall(__NR_memfd_create, "wasm-module", 0));
+  if (fd >= 0) {
+    size_t written = 0;
+    while (written < size) {
+      ssize_t result = write(fd, start + written, size - written);
+      if (result <= 0)
+        break;
+      written += static_cast<size_t>(result);
+    }
+    void* memory = written == size
+                       ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)
+                       : MAP_FAILED;
+    if (memory != MAP_FAILED) {
+      return new ModuleFile(reinterpret_cast<const byte*>(memory), size, fd,
+                            nullptr);
+    }
+    close(fd);
+  }
+#endif
+  // Without a file, data segments are always copied.
+  void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED)
+    return nullptr;
+  memcpy(memory, start, size);
+  mprotect(memory, size, PROT_READ);
+  return new ModuleFile(reinterpret_cast<const byte*>(memory), size, -1,
+                        nullptr);
+}
+
+ModuleFile::~ModuleFile() {
+  munmap(const_cast<byte*>(start_), size_);
+  if (fd_ >= 0)
+    close(fd_);
+}
+#else
+ModuleFile* ModuleFile::Open(const char* path) {
+  // Fall back to the platform's generic file mapping.
+  base::OS::MemoryMappedFile* file = base::OS::MemoryMappedFile::open(path);
+  if (file == nullptr)
+    return nullptr;
+  if (file->memory() == nullptr || file->size() == 0) {
+    delete file;
+    return nullptr;
+  }
+  return new ModuleFile(reinterpret_cast<const byte*>(file->memory()),
+                        file->size(), -1, file);
+}
+
+ModuleFile* ModuleFile::FromBytes(const byte* start, const byte* end) {
+  size_t size = static_cast<size_t>(end - start);
+  if (size == 0)
+    return nullptr;
+  byte* copy = new byte[size];
+  memcpy(copy, start, size);
+  return new ModuleFile(copy, size, -1, nullptr);
+}
+
+ModuleFile::~ModuleFile() {
+  if (platform_file_ != nullptr) {
+    delete reinterpret_cast<base::OS::MemoryMappedFile*>(platform_file_);
+  } else {
+    delete[] start_;
+  }
+}
+#endif
+
+MaybeHandle<JSObject> InstantiateModuleFile(Isolate* isolate,
+                                            const char* path,
+                                            Handle<JSObject> ffi,
+                                            Handle<JSArrayBuffer> memory) {
+  ErrorThrower thrower(isolate, "InstantiateModuleFile()");
+  base::SmartPointer<ModuleFile> file(ModuleFile::Open(path));
+  if (file.is_empty()) {
+    thrower.Error("Could not map module file %s", path);
+    return MaybeHandle<JSObject>();
+  }
+
+  // Verify the bodies while decoding, so compilation can skip the checks.
+  ModuleResult result = DecodeWasmModule(isolate, file->start(), file->end(),
+                                         true, false);
+
+  MaybeHandle<JSObject> object;
+  if (result.failed()) {
+    thrower.Failed("", result);
+  } else {
+    // Data segments are loaded straight from the mapping, or mapped from the
+    // file where they are page-aligned.
+    result.val->module_fd = file->fd();
+    object = result.val->Instantiate(isolate, ffi, memory);
+  }
+
+  if (result.val)
+    delete result.val;
+  return object;
+}
+}
+}
+}
@@ -0,0 +1,61 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef V8_WASM_MODULE_FILE_H_
+#define V8_WASM_MODULE_FILE_H_
+
+#include "src/handles.h"
+#include "src/wasm/wasm-module.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+// A read-only memory mapping of a WASM module file. The mapped bytes are
+// used directly as {module_start} and {module_end} for decoding, and data
+// segments are loaded straight from the mapping, so the module bytes are
+// never copied into the JS heap or an ArrayBuffer. Where possible the file
+// stays open, so that page-aligned data segments can be mapped into linear
+// memory copy-on-write instead of being copied.
+class ModuleFile {
+ public:
+  // Maps the file at {path}. Returns {nullptr} upon failure.
+  static ModuleFile* Open(const char* path);
+
+  // Copies the module bytes into an anonymous in-memory file and maps that.
+  // Falls back to a plain copy where there are no such files. Returns
+  // {nullptr} upon failure.
+  static ModuleFile* FromBytes(const byte* start, const byte* end);
+  ~ModuleFile();
+
+  const byte* start() const { return start_; }
+  const byte* end() const { return start_ + size_; }
+  size_t size() const { return size_; }
+
+  // File descriptor whose offset 0 is {start()}, or -1.
+  int fd() const { return fd_; }
+
+ private:
+  ModuleFile(const byte* start, size_t size, int fd, void* platform_file)
+      : start_(start), size_(size), fd_(fd), platform_file_(platform_file) {}
+
+  const byte* start_;
+  size_t size_;
+  int fd_;
+  void* platform_file_;  // platform-specific mapping or copy, if any.
+
+  DISALLOW_COPY_AND_ASSIGN(ModuleFile);
+};
+
+// Maps, decodes and instantiates the module in the file at {path}. Errors
+// are reported by scheduling an exception on the isolate.
+MaybeHandle<JSObject> InstantiateModuleFile(Isolate* isolate,
+                                            const char* path,
+                                            Handle<JSObject> ffi,
+                                            Handle<JSArrayBuffer> memory);
+}
+}
+}
+
+#endif  // V8_WASM_MODULE_FILE_H_
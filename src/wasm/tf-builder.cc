@@ -18,6 +18,7 @@
 #include "src/compiler/linkage.h"
 
 #include "src/wasm/tf-builder.h"
+#include "src/wasm/wasm-atomics.h"
 #include "src/wasm/wasm-module.h"
 #include "src/wasm/wasm-opcodes.h"
 
@@ -28,6 +29,17 @@
 #define WASM_64 0
 #endif
 
+// On x86, aligned word accesses are atomic, loads are not reordered with
+// other loads and stores not with other stores. Atomic loads and release
+// stores on the effect chain therefore need no barriers and are compiled
+// inline. Weakly ordered targets need barriers that the machine operators
+// cannot express yet, so they call the functions in wasm-atomics.h.
+#if V8_TARGET_ARCH_IA32 || V8_TARGET_ARCH_X64 || V8_TARGET_ARCH_X87
+#define WASM_INLINE_ATOMIC_ACCESS 1
+#else
+#define WASM_INLINE_ATOMIC_ACCESS 0
+#endif
+
 namespace v8 {
 namespace internal {
 namespace wasm {
@@ -51,6 +63,8 @@ enum TrapReason {
   kTrapFloatUnrepresentable,
   kTrapFuncInvalid,
   kTrapFuncSigMismatch,
+  kTrapMemUnaligned,
+  kTrapInstanceBusy,
   kTrapCount
 };
 
@@ -62,7 +76,9 @@ static const char* kTrapMessages[] = {
   "remainder by zero",
   "integer result unrepresentable",
   "invalid function",
-  "function signature mismatch"
+  "function signature mismatch",
+  "unaligned atomic memory access",
+  "instance is busy"
 };
 
 compiler::MachineType MachineTypeFor(LocalType type) {
@@ -110,6 +126,11 @@ compiler::MachineType MachineTypeFor(MemType type) {
 }
 }  // namespace
 
+const char* TrapMessage(int reason) {
+  DCHECK(reason >= 0 && reason < kTrapCount);
+  return kTrapMessages[reason];
+}
+
 
 // A helper that handles building graph fragments for trapping.
 // To avoid generating a ton of redundant code that just calls the runtime
@@ -123,6 +144,8 @@ class TFTrapHelper : public ZoneObject{
     g(b->graph ? b->graph->graph() : nullptr) {
 
     for (int i = 0; i < kTrapCount; i++) traps[i] = nullptr;
+    trapped = nullptr;
+    trapped_effect = nullptr;
   }
 
   // Make the current control path trap to unreachable.
@@ -183,6 +206,42 @@ class TFTrapHelper : public ZoneObject{
     *control = iftrue ? if_false : if_true;
     *effect = before;
   }
+  // In native code, add a check after a call that returns if the callee
+  // recorded a trap, so that the caller has no further effects.
+  void ReturnIfTrapped() {
+    ModuleEnv* module = builder->module;
+    if (!module || !module->context.is_null() || module->trap_address == 0)
+      return;
+    TFNode** effect = builder->effect;
+    TFNode** control = builder->control;
+    TFNode* load = g->NewNode(graph->machine()->Load(compiler::kMachInt32),
+                              graph->IntPtrConstant(module->trap_address),
+                              graph->Int32Constant(0), *effect, *control);
+    *effect = load;
+    TFNode* branch =
+        g->NewNode(graph->common()->Branch(compiler::BranchHint::kFalse),
+                   load, *control);
+    TFNode* if_true = g->NewNode(graph->common()->IfTrue(), branch);
+    TFNode* if_false = g->NewNode(graph->common()->IfFalse(), branch);
+
+    *control = if_true;
+    if (trapped == nullptr) {
+      // The trap word already holds the reason; just return like the trap
+      // code of the callee did.
+      *control = trapped =
+          g->NewNode(graph->common()->Merge(1), *control);
+      *effect = trapped_effect = g->NewNode(graph->common()->EffectPhi(1),
+                                            *effect, *control);
+      MergeControlToEnd(graph, g->NewNode(graph->common()->Return(),
+                                          graph->Int32Constant(0xdeadbeef),
+                                          *effect, *control));
+    } else {
+      builder->AppendToMerge(trapped, *control);
+      builder->AppendToPhi(trapped, trapped_effect, *effect);
+    }
+    *control = if_false;
+    *effect = load;
+  }
 
  private:
   TFBuilder* builder;
@@ -190,6 +249,8 @@ class TFTrapHelper : public ZoneObject{
   compiler::Graph* g;
   TFNode* traps[kTrapCount];
   TFNode* effects[kTrapCount];
+  TFNode* trapped;         // block returning after a callee trapped.
+  TFNode* trapped_effect;  // effect phi of {trapped}.
 
   void ConnectTrap(TrapReason reason) {
     if (traps[reason] == nullptr) {
@@ -234,6 +295,15 @@ class TFTrapHelper : public ZoneObject{
       *control = node;
       *effect = node;
       
+    } else if (module && module->trap_address != 0) {
+      // Native threads cannot throw; record the trap for the caller instead.
+      compiler::StoreRepresentation rep(compiler::kMachInt32,
+                                        compiler::kNoWriteBarrier);
+      *effect = g->NewNode(graph->machine()->Store(rep),
+                           graph->IntPtrConstant(module->trap_address),
+                           graph->Int32Constant(0),
+                           graph->Int32Constant(reason + 1), *effect,
+                           *control);
     }
     if (false) {
       // End the control flow with a throw
@@ -1219,7 +1289,9 @@ TFNode* TFBuilder::CallDirect(uint32_t index, TFNode** args) {
   args[0] = Constant(module->GetFunctionCode(index));
   FunctionSig* sig = module->GetFunctionSignature(index);
 
-  return MakeWasmCall(sig, args);
+  TFNode* call = MakeWasmCall(sig, args);
+  trap->ReturnIfTrapped();
+  return call;
 }
 
 TFNode* TFBuilder::CallIndirect(uint32_t index, TFNode** args) {
@@ -1372,6 +1444,16 @@ void TFBuilder::BuildJSToWasmWrapper(Handle<Code> wasm_code, FunctionSig* sig) {
     args[pos++] = FromJS(param, context, sig->GetParam(i));
   }
 
+  // Native threads may use the memory until a foreground task clears the
+  // busy word. Check after the conversions, which may run JS.
+  if (module->busy_address != 0) {
+    TFNode* busy = g->NewNode(graph->machine()->Load(compiler::kMachInt32),
+                              graph->IntPtrConstant(module->busy_address),
+                              graph->Int32Constant(0), *effect, *control);
+    *effect = busy;
+    trap->AddTrapIfTrue(kTrapInstanceBusy, busy);
+  }
+
   args[pos++] = *effect;
   args[pos++] = *control;
 
@@ -1381,7 +1463,98 @@ void TFBuilder::BuildJSToWasmWrapper(Handle<Code> wasm_code, FunctionSig* sig) {
   TFNode* call = g->NewNode(graph->common()->Call(desc), count, args);
   TFNode* jsval = ToJS(call, context,
                        sig->return_count() == 0 ? kAstStmt : sig->GetReturn());
-  TFNode* ret = g->NewNode(graph->common()->Return(), jsval, call, start);
+  TFNode* ret = g->NewNode(graph->common()->Return(), jsval, call, *control);
+
+  MergeControlToEnd(graph, ret);
+}
+
+void TFBuilder::BuildCToWasmWrapper(Handle<Code> wasm_code, FunctionSig* sig) {
+  DCHECK_NOT_NULL(graph);
+
+  int params = static_cast<int>(sig->parameter_count());
+  compiler::Graph* g = graph->graph();
+  compiler::MachineOperatorBuilder* m = graph->machine();
+  int count = params + 3;
+  TFNode** args = Buffer(count);
+
+  // The only C parameter points to a buffer of 8-byte slots holding the
+  // WASM parameters, which receives the result in the first slot.
+  TFNode* start = Start(1);
+  *control = start;
+  *effect = start;
+  TFNode* slots = g->NewNode(graph->common()->Parameter(0), start);
+
+  int pos = 0;
+  args[pos++] = Constant(wasm_code);
+  for (int i = 0; i < params; i++) {
+    TFNode* param = g->NewNode(m->Load(MachineTypeFor(sig->GetParam(i))),
+                               slots, graph->Int32Constant(i * kSlotSize),
+                               *effect, *control);
+    *effect = param;
+    args[pos++] = param;
+  }
+  args[pos++] = *effect;
+  args[pos++] = *control;
+
+  // Call the WASM code and store its result.
+  compiler::CallDescriptor* desc =
+      module->GetWasmCallDescriptor(graph->zone(), sig);
+  TFNode* call = g->NewNode(graph->common()->Call(desc), count, args);
+  *effect = call;
+  if (sig->return_count() > 0) {
+    compiler::StoreRepresentation rep(MachineTypeFor(sig->GetReturn()),
+                                      compiler::kNoWriteBarrier);
+    *effect = g->NewNode(m->Store(rep), slots, graph->Int32Constant(0), call,
+                         *effect, *control);
+  }
+  TFNode* ret = g->NewNode(graph->common()->Return(), graph->Int32Constant(0),
+                           *effect, start);
+
+  MergeControlToEnd(graph, ret);
+}
+
+void TFBuilder::BuildWasmToCWrapper(Address callback, FunctionSig* sig) {
+  DCHECK_NOT_NULL(graph);
+
+  int params = static_cast<int>(sig->parameter_count());
+  compiler::Graph* g = graph->graph();
+  TFNode* start = Start(params + 1);
+  *effect = start;
+  *control = start;
+
+  // The callback receives the start and the size of the linear memory
+  // before the WASM parameters.
+  compiler::MachineSignature::Builder sig_builder(
+      graph->zone(), sig->return_count(), params + 2);
+  if (sig->return_count() > 0)
+    sig_builder.AddReturn(MachineTypeFor(sig->GetReturn()));
+  sig_builder.AddParam(compiler::kMachPtr);
+  sig_builder.AddParam(compiler::kMachPtr);
+  for (int i = 0; i < params; i++) {
+    sig_builder.AddParam(MachineTypeFor(sig->GetParam(i)));
+  }
+  compiler::CallDescriptor* desc = compiler::Linkage::GetSimplifiedCDescriptor(
+      graph->zone(), sig_builder.Build());
+
+  ApiFunction api_function(callback);
+  ExternalReference ref(&api_function, ExternalReference::BUILTIN_CALL,
+                        graph->isolate());
+  int count = params + 5;
+  TFNode** args = Buffer(count);
+  int pos = 0;
+  args[pos++] = graph->ExternalConstant(ref);
+  args[pos++] = MemBuffer(0);
+  args[pos++] = graph->IntPtrConstant(
+      static_cast<intptr_t>(module->mem_end - module->mem_start));
+  for (int i = 0; i < params; i++) {
+    args[pos++] = g->NewNode(graph->common()->Parameter(i), start);
+  }
+  args[pos++] = *effect;
+  args[pos++] = *control;
+
+  TFNode* call = g->NewNode(graph->common()->Call(desc), count, args);
+  TFNode* val = sig->return_count() > 0 ? call : graph->Int32Constant(0);
+  TFNode* ret = g->NewNode(graph->common()->Return(), val, call, start);
 
   MergeControlToEnd(graph, ret);
 }
@@ -1522,16 +1695,22 @@ void TFBuilder::BoundsCheckMem(MemType memtype, TFNode* index, uint32_t offset)
   // TODO(turbofan): fold bounds checks for constant indexes.
   compiler::Graph* g = graph->graph();
   CHECK_GE(module->mem_end, module->mem_start);
-  ptrdiff_t size = module->mem_end - module->mem_start;
-  byte memsize = WasmOpcodes::MemSize(memtype);
+  // Memories may span the whole 32-bit index space, so the end of the access
+  // is computed in 64 bits.
+  uint64_t size = module->mem_end - module->mem_start;
+  uint64_t access_end = static_cast<uint64_t>(offset) +
+                        WasmOpcodes::MemSize(memtype);
   TFNode* cond;
-  if (offset >= size || (offset + memsize) >= size) {
+  if (access_end > size) {
     // The access will always throw.
     cond = graph->Int32Constant(0);
   } else {
     // Check against the limit.
-    size_t limit = size - offset - memsize;
-    CHECK(limit <= kMaxUInt32);
+    uint64_t limit = size - access_end;
+    if (limit >= kMaxUInt32) {
+      // Every 32-bit index is in bounds.
+      return;
+    }
     cond = g->NewNode(graph->machine()->Uint32LessThanOrEqual(), index,
                       graph->Int32Constant(static_cast<uint32_t>(limit)));
   }
@@ -1540,26 +1719,142 @@ void TFBuilder::BoundsCheckMem(MemType memtype, TFNode* index, uint32_t offset)
 }
 
 
+TFNode* TFBuilder::MemIndex(TFNode* index) {
+  // Indexes into memories above 2gb may have the top bit set. Widen them
+  // explicitly so that they are never taken as negative displacements.
+  uint64_t size = module->mem_end - module->mem_start;
+  if (kPointerSize == 8 && size > static_cast<uint64_t>(kMaxInt)) {
+    return graph->graph()->NewNode(graph->machine()->ChangeUint32ToUint64(),
+                                   index);
+  }
+  return index;
+}
+
+
+TFNode* TFBuilder::MaskMem(TFNode* index, uint32_t offset) {
+  // The memory is a power of two in size and followed by a guard for the
+  // widest access, so wrapping the effective address around keeps every
+  // access inside the instance without a branch.
+  compiler::Graph* g = graph->graph();
+  uint64_t size = module->mem_end - module->mem_start;
+  CHECK(size > 0 && (size & (size - 1)) == 0);
+  CHECK(size <= static_cast<uint64_t>(kMaxUInt32) + 1);
+  TFNode* addr = index;
+  if (offset != 0) {
+    addr = g->NewNode(graph->machine()->Int32Add(), index,
+                      graph->Int32Constant(offset));
+  }
+  return g->NewNode(graph->machine()->Word32And(), addr,
+                    graph->Int32Constant(static_cast<int32_t>(size - 1)));
+}
+
+
+TFNode* TFBuilder::AtomicAddress(TFNode* index, uint32_t offset) {
+  // Memory is page-aligned, so the effective address alone determines the
+  // alignment. Its low bits do not depend on wrap-around.
+  compiler::Graph* g = graph->graph();
+  compiler::MachineOperatorBuilder* m = graph->machine();
+  TFNode* effective = index;
+  if (offset != 0) {
+    effective = g->NewNode(m->Int32Add(), index, graph->Int32Constant(offset));
+  }
+  TFNode* aligned = g->NewNode(
+      m->Word32Equal(),
+      g->NewNode(m->Word32And(), effective, graph->Int32Constant(3)),
+      graph->Int32Constant(0));
+  trap->AddTrapIfFalse(kTrapMemUnaligned, aligned);
+
+  TFNode* base;
+  if (module->mem_masked) {
+    base = MemBuffer(0);
+    index = MaskMem(index, offset);
+  } else {
+    BoundsCheckMem(kMemI32, index, offset);
+    base = MemBuffer(offset);
+  }
+  if (kPointerSize == 8) {
+    index = g->NewNode(m->ChangeUint32ToUint64(), index);
+  }
+  return g->NewNode(m->IntAdd(), base, index);
+}
+
+
+TFNode* TFBuilder::CallAtomic(WasmAtomicFunction function, TFNode* address,
+                              TFNode* a, TFNode* b) {
+  compiler::MachineSignature::Builder sig_builder(graph->zone(), 1, 3);
+  sig_builder.AddReturn(compiler::kMachInt32);
+  sig_builder.AddParam(compiler::kMachPtr);
+  sig_builder.AddParam(compiler::kMachInt32);
+  sig_builder.AddParam(compiler::kMachInt32);
+  compiler::CallDescriptor* desc = compiler::Linkage::GetSimplifiedCDescriptor(
+      graph->zone(), sig_builder.Build());
+
+  ApiFunction api_function(FUNCTION_ADDR(function));
+  ExternalReference ref(&api_function, ExternalReference::BUILTIN_CALL,
+                        graph->isolate());
+  TFNode* inputs[] = {
+    graph->ExternalConstant(ref),
+    address,
+    a ? a : graph->Int32Constant(0),
+    b ? b : graph->Int32Constant(0),
+    *effect,
+    *control
+  };
+  return graph->graph()->NewNode(graph->common()->Call(desc),
+                                 static_cast<int>(arraysize(inputs)), inputs);
+}
+
+
+TFNode* TFBuilder::AtomicMem(WasmOpcode opcode, TFNode* index,
+                             uint32_t offset, TFNode* a, TFNode* b) {
+  if (!graph)
+    return nullptr;
+  DCHECK(module && !module->asm_js);
+  TFNode* call = CallAtomic(WasmAtomicMemFunction(opcode),
+                            AtomicAddress(index, offset), a, b);
+  *effect = call;
+  return call;
+}
+
+
 TFNode* TFBuilder::LoadMem(LocalType type, MemType memtype, TFNode* index,
-			     uint32_t offset) {
+			     uint32_t offset, MemoryAccess::Atomicity atomicity) {
   if (!graph)
     return nullptr;
 
   compiler::Graph* g = graph->graph();
   TFNode* load;
 
-  if (module && module->asm_js) {
+  if (atomicity != MemoryAccess::kNone) {
+    // Atomic accesses are whole words; the decoder checked the type.
+    DCHECK(module && !module->asm_js);
+    TFNode* address = AtomicAddress(index, offset);
+    if (WASM_INLINE_ATOMIC_ACCESS) {
+      // Sequentially consistent stores end with a full barrier, so every
+      // atomic load only needs acquire semantics.
+      load = g->NewNode(graph->machine()->Load(compiler::kMachInt32), address,
+                        graph->Int32Constant(0), *effect, *control);
+    } else {
+      load = CallAtomic(WasmAtomicLoadFunction(atomicity), address, nullptr,
+                        nullptr);
+    }
+  } else if (module && module->asm_js) {
     // asm.js semantics use CheckedLoad (i.e. OOB reads return 0ish).
     DCHECK_EQ(0, offset);
     const compiler::Operator* op =
       graph->machine()->CheckedLoad(MachineTypeFor(memtype));
     load = g->NewNode(op, MemBuffer(0), index, MemSize(0),
                                    *effect, *control);
+  } else if (module && module->mem_masked) {
+    // Masked memory wraps out-of-bounds addresses around instead of trapping.
+    load = g->NewNode(graph->machine()->Load(MachineTypeFor(memtype)),
+                      MemBuffer(0), MemIndex(MaskMem(index, offset)), *effect,
+                      *control);
   } else {
     // WASM semantics throw on OOB. Introduce explicit bounds check.
     BoundsCheckMem(memtype, index, offset);
     load = g->NewNode(graph->machine()->Load(MachineTypeFor(memtype)),
-                      MemBuffer(offset), index, *effect, *control);
+                      MemBuffer(offset), MemIndex(index), *effect, *control);
   }
 
   *effect = load;
@@ -1580,18 +1875,40 @@ TFNode* TFBuilder::LoadMem(LocalType type, MemType memtype, TFNode* index,
 
 
 TFNode* TFBuilder::StoreMem(MemType memtype, TFNode* index, uint32_t offset,
-                            TFNode* val) {
+                            TFNode* val, MemoryAccess::Atomicity atomicity) {
   if (!graph)
     return nullptr;
 
   TFNode* store;
-  if (module && module->asm_js) {
+  if (atomicity != MemoryAccess::kNone) {
+    DCHECK(module && !module->asm_js);
+    TFNode* address = AtomicAddress(index, offset);
+    if (WASM_INLINE_ATOMIC_ACCESS && atomicity == MemoryAccess::kRelease) {
+      compiler::StoreRepresentation rep(compiler::kMachInt32,
+                                        compiler::kNoWriteBarrier);
+      store = graph->graph()->NewNode(graph->machine()->Store(rep), address,
+                                      graph->Int32Constant(0), val, *effect,
+                                      *control);
+    } else {
+      // A sequentially consistent store needs the full barrier after it
+      // even on x86, which only the call provides.
+      store = CallAtomic(WasmAtomicStoreFunction(atomicity), address, val,
+                         nullptr);
+    }
+  } else if (module && module->asm_js) {
     // asm.js semantics use CheckedStore (i.e. ignore OOB writes).
     DCHECK_EQ(0, offset);
     const compiler::Operator* op =
       graph->machine()->CheckedStore(MachineTypeFor(memtype));
     store = graph->graph()->NewNode(op, MemBuffer(0), index, MemSize(0), val,
                                            *effect, *control);
+  } else if (module && module->mem_masked) {
+    // Masked memory wraps out-of-bounds addresses around instead of trapping.
+    compiler::StoreRepresentation rep(MachineTypeFor(memtype),
+                                      compiler::kNoWriteBarrier);
+    store = graph->graph()->NewNode(graph->machine()->Store(rep), MemBuffer(0),
+                                    MemIndex(MaskMem(index, offset)), val,
+                                    *effect, *control);
   } else {
     // WASM semantics throw on OOB. Introduce explicit bounds check.
     BoundsCheckMem(memtype, index, offset);
@@ -1599,7 +1916,7 @@ TFNode* TFBuilder::StoreMem(MemType memtype, TFNode* index, uint32_t offset,
                                       compiler::kNoWriteBarrier);
     store = graph->graph()->NewNode(graph->machine()->Store(rep),
                                     MemBuffer(offset),
-                                    index, val, *effect, *control);
+                                    MemIndex(index), val, *effect, *control);
   }
   *effect = store;
   return store;
@@ -7,6 +7,7 @@
 
 #include "src/zone.h"
 
+#include "src/wasm/wasm-atomics.h"
 #include "src/wasm/wasm-opcodes.h"
 
 namespace v8 {
@@ -26,10 +27,14 @@ struct ModuleEnv;
 
 class TFTrapHelper;
 
+// Returns the message of the trap that native code recorded as {reason}.
+const char* TrapMessage(int reason);
+
 // Abstracts details of building TurboFan graph nodes, making the decoder
 // independent of the exact IR details.
 struct TFBuilder {
   static const int kDefaultBufferSize = 16;
+  static const int kSlotSize = 8;  // size of a value in a C entry buffer.
 
   Zone* zone;
   TFGraph* graph;
@@ -103,6 +108,8 @@ struct TFBuilder {
   TFNode* CallIndirect(uint32_t index, TFNode** args);
   void BuildJSToWasmWrapper(Handle<Code> wasm_code, FunctionSig* sig);
   void BuildWasmToJSWrapper(Handle<JSFunction> function, FunctionSig* sig);
+  void BuildCToWasmWrapper(Handle<Code> wasm_code, FunctionSig* sig);
+  void BuildWasmToCWrapper(Address callback, FunctionSig* sig);
   TFNode* ToJS(TFNode* node, TFNode* context, LocalType type);
   TFNode* FromJS(TFNode* node, TFNode* context, LocalType type);
   TFNode* Invert(TFNode* node);
@@ -123,8 +130,17 @@ struct TFBuilder {
   TFNode* LoadGlobal(uint32_t index);
   TFNode* StoreGlobal(uint32_t index, TFNode* val);
   void BoundsCheckMem(MemType memtype, TFNode* index, uint32_t offset);
-  TFNode* LoadMem(LocalType type, MemType memtype, TFNode* index, uint32_t offset);
-  TFNode* StoreMem(MemType type, TFNode* index, uint32_t offset, TFNode* val);
+  TFNode* MaskMem(TFNode* index, uint32_t offset);
+  TFNode* MemIndex(TFNode* index);
+  TFNode* LoadMem(LocalType type, MemType memtype, TFNode* index, uint32_t offset,
+                  MemoryAccess::Atomicity atomicity = MemoryAccess::kNone);
+  TFNode* StoreMem(MemType type, TFNode* index, uint32_t offset, TFNode* val,
+                   MemoryAccess::Atomicity atomicity = MemoryAccess::kNone);
+  TFNode* AtomicMem(WasmOpcode opcode, TFNode* index, uint32_t offset,
+                    TFNode* a, TFNode* b);
+  TFNode* AtomicAddress(TFNode* index, uint32_t offset);
+  TFNode* CallAtomic(WasmAtomicFunction function, TFNode* address, TFNode* a,
+                     TFNode* b);
 
   static void PrintDebugName(TFNode* node);
   TFNode* String(const char* string);
@@ -0,0 +1,127 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/base/atomicops.h"
+
+#include "src/wasm/wasm-atomics.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+namespace {
+typedef uint32_t (*BinaryOp)(uint32_t, uint32_t);
+
+// Applies {op} to the word at {addr} with a compare-and-swap loop and
+// full barriers on both sides.
+int32_t SequentialUpdate(int32_t* addr, int32_t operand, BinaryOp op) {
+  base::MemoryBarrier();
+  base::Atomic32 old = base::NoBarrier_Load(addr);
+  while (true) {
+    base::Atomic32 desired = static_cast<base::Atomic32>(
+        op(static_cast<uint32_t>(old), static_cast<uint32_t>(operand)));
+    base::Atomic32 prev = base::NoBarrier_CompareAndSwap(addr, old, desired);
+    if (prev == old)
+      break;
+    old = prev;
+  }
+  base::MemoryBarrier();
+  return old;
+}
+
+uint32_t Add(uint32_t a, uint32_t b) { return a + b; }
+uint32_t Sub(uint32_t a, uint32_t b) { return a - b; }
+uint32_t And(uint32_t a, uint32_t b) { return a & b; }
+uint32_t Ior(uint32_t a, uint32_t b) { return a | b; }
+uint32_t Xor(uint32_t a, uint32_t b) { return a ^ b; }
+
+int32_t AcquireLoad(int32_t* addr, int32_t, int32_t) {
+  return base::Acquire_Load(addr);
+}
+
+int32_t ReleaseStore(int32_t* addr, int32_t value, int32_t) {
+  base::Release_Store(addr, value);
+  return value;
+}
+
+// A sequentially consistent store is a release store followed by a full
+// barrier, so that acquire loads suffice for sequentially consistent loads.
+int32_t SequentialStore(int32_t* addr, int32_t value, int32_t) {
+  base::Release_Store(addr, value);
+  base::MemoryBarrier();
+  return value;
+}
+
+int32_t AtomicAdd(int32_t* addr, int32_t value, int32_t) {
+  return SequentialUpdate(addr, value, Add);
+}
+
+int32_t AtomicSub(int32_t* addr, int32_t value, int32_t) {
+  return SequentialUpdate(addr, value, Sub);
+}
+
+int32_t AtomicAnd(int32_t* addr, int32_t value, int32_t) {
+  return SequentialUpdate(addr, value, And);
+}
+
+int32_t AtomicIor(int32_t* addr, int32_t value, int32_t) {
+  return SequentialUpdate(addr, value, Ior);
+}
+
+int32_t AtomicXor(int32_t* addr, int32_t value, int32_t) {
+  return SequentialUpdate(addr, value, Xor);
+}
+
+int32_t AtomicExchange(int32_t* addr, int32_t value, int32_t) {
+  base::MemoryBarrier();
+  int32_t old = base::NoBarrier_AtomicExchange(addr, value);
+  base::MemoryBarrier();
+  return old;
+}
+
+int32_t AtomicCompareExchange(int32_t* addr, int32_t expected,
+                              int32_t replacement) {
+  base::MemoryBarrier();
+  int32_t old = base::NoBarrier_CompareAndSwap(addr, expected, replacement);
+  base::MemoryBarrier();
+  return old;
+}
+}  // namespace
+
+WasmAtomicFunction WasmAtomicLoadFunction(MemoryAccess::Atomicity atomicity) {
+  DCHECK_NE(MemoryAccess::kNone, atomicity);
+  DCHECK_NE(MemoryAccess::kRelease, atomicity);
+  return AcquireLoad;
+}
+
+WasmAtomicFunction WasmAtomicStoreFunction(MemoryAccess::Atomicity atomicity) {
+  DCHECK_NE(MemoryAccess::kNone, atomicity);
+  DCHECK_NE(MemoryAccess::kAcquire, atomicity);
+  return atomicity == MemoryAccess::kRelease ? ReleaseStore : SequentialStore;
+}
+
+WasmAtomicFunction WasmAtomicMemFunction(WasmOpcode opcode) {
+  switch (opcode) {
+    case kExprI32AtomicAdd:
+      return AtomicAdd;
+    case kExprI32AtomicSub:
+      return AtomicSub;
+    case kExprI32AtomicAnd:
+      return AtomicAnd;
+    case kExprI32AtomicIor:
+      return AtomicIor;
+    case kExprI32AtomicXor:
+      return AtomicXor;
+    case kExprI32AtomicExchange:
+      return AtomicExchange;
+    case kExprI32AtomicCompareExchange:
+      return AtomicCompareExchange;
+    default:
+      UNREACHABLE();
+      return nullptr;
+  }
+}
+}
+}
+}
@@ -0,0 +1,36 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef V8_WASM_ATOMICS_H_
+#define V8_WASM_ATOMICS_H_
+
+#include "src/wasm/wasm-opcodes.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+// Read-modify-write accesses to shared memory, sequentially consistent
+// stores and, on weakly ordered targets, all other atomic loads and stores
+// are compiled into calls to the C functions below, which implement them on
+// top of base/atomicops.h. See tf-builder.cc for the inline cases. Each
+// takes the address of an aligned 32-bit word and up to two operands, and
+// returns the value loaded from the word, or its old value for stores and
+// read-modify-write operations.
+typedef int32_t (*WasmAtomicFunction)(int32_t* addr, int32_t a, int32_t b);
+
+// Returns the function for an atomic load or store with {atomicity}, which
+// must not be {MemoryAccess::kNone}.
+WasmAtomicFunction WasmAtomicLoadFunction(MemoryAccess::Atomicity atomicity);
+WasmAtomicFunction WasmAtomicStoreFunction(MemoryAccess::Atomicity atomicity);
+
+// Returns the function for the read-modify-write {opcode}, which must be
+// in FOREACH_ATOMIC_MEM_OPCODE. These are sequentially consistent. The
+// compare-exchange stores {b} if the word equals {a}.
+WasmAtomicFunction WasmAtomicMemFunction(WasmOpcode opcode);
+}
+}
+}
+
+#endif  // V8_WASM_ATOMICS_H_
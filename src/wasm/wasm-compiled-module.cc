@@ -0,0 +1,171 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/v8.h"
+
+#include "src/global-handles.h"
+#include "src/simulator.h"
+
+#include "src/wasm/module-decoder.h"
+#include "src/wasm/module-file.h"
+#include "src/wasm/wasm-compiled-module.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+namespace {
+// The C entry point of an export, see {CompileCToWasmWrapper}.
+typedef int32_t (*NativeEntry)(byte* slots);
+}  // namespace
+
+WasmCompiledModule* WasmCompiledModule::Compile(Isolate* isolate,
+                                                ErrorThrower& thrower,
+                                                const byte* module_start,
+                                                const byte* module_end) {
+  // The decoded module refers to the module bytes, so the compiled module
+  // keeps its own copy of them.
+  ModuleFile* module_file = ModuleFile::FromBytes(module_start, module_end);
+  if (module_file == nullptr) {
+    thrower.Error("Out of memory: wasm module bytes");
+    return nullptr;
+  }
+
+  ModuleResult result = DecodeWasmModule(
+      isolate, module_file->start(), module_file->end(), true, false);
+  if (result.failed()) {
+    thrower.Failed("", result);
+    if (result.val)
+      delete result.val;
+    delete module_file;
+    return nullptr;
+  }
+  WasmModule* module = result.val;
+  std::vector<bool> host_imports(module->functions->size(), true);
+  for (uint32_t i = 0; i < module->functions->size(); i++) {
+    const WasmFunction& func = module->functions->at(i);
+    if (func.exported && !CanRunNatively(module, i, host_imports)) {
+      thrower.Error("Export #%u:%s makes indirect calls, which cannot be "
+                    "called from C++.",
+                    i, module->GetName(func.name_offset));
+      delete module;
+      delete module_file;
+      return nullptr;
+    }
+  }
+  module->module_fd = module_file->fd();
+  return new WasmCompiledModule(isolate, module_file, module);
+}
+
+WasmCompiledModule::WasmCompiledModule(Isolate* isolate,
+                                       ModuleFile* module_file,
+                                       WasmModule* module)
+    : isolate_(isolate), module_file_(module_file), module_(module) {}
+
+WasmCompiledModule::~WasmCompiledModule() {}
+
+WasmInstance* WasmCompiledModule::Instantiate(ErrorThrower& thrower,
+                                              Handle<JSObject> imports,
+                                              Handle<JSArrayBuffer> memory,
+                                              WasmInstantiateStats* stats) {
+  HandleScope scope(isolate_);
+  // Instances are only called through the C entry points of their exports,
+  // so the functions are only compiled for those.
+  WasmInstanceOptions options;
+  options.parallel_exports = true;
+  options.js_exports = false;
+  Handle<JSObject> object;
+  if (!module_->Instantiate(isolate_, imports, memory, options, stats)
+           .ToHandle(&object)) {
+    return nullptr;
+  }
+  Handle<FixedArray> exports = GetInstanceNativeExports(object);
+  DCHECK(!exports.is_null());
+
+  WasmInstance* instance = new WasmInstance(isolate_, object);
+  Handle<JSArrayBuffer> globals = GetInstanceGlobals(object);
+  byte* globals_area = reinterpret_cast<byte*>(globals->backing_store());
+  int trap_offset = Smi::cast(exports->get(kNativeExportsTrapOffset))->value();
+  int busy_offset = Smi::cast(exports->get(kNativeExportsBusyOffset))->value();
+  instance->trap_ =
+      reinterpret_cast<base::Atomic32*>(globals_area + trap_offset);
+  instance->busy_ =
+      reinterpret_cast<base::Atomic32*>(globals_area + busy_offset);
+  for (int pos = kNativeExportsStart; pos < exports->length();
+       pos += kNativeExportEntrySize) {
+    WasmInstance::Export entry;
+    entry.name =
+        String::cast(exports->get(pos + kNativeExportName))->ToCString().get();
+    ByteArray* sig =
+        ByteArray::cast(exports->get(pos + kNativeExportSignature));
+    for (int i = 0; i < sig->length(); i++) {
+      entry.types.push_back(static_cast<LocalType>(sig->get(i)));
+    }
+    // The code lives on pages that are never compacted, so the address
+    // stays valid as long as the instance.
+    entry.entry = Code::cast(exports->get(pos + kNativeExportEntry))->entry();
+    instance->exports_.push_back(entry);
+  }
+  std::sort(instance->exports_.begin(), instance->exports_.end(),
+            [](const WasmInstance::Export& a, const WasmInstance::Export& b) {
+              return a.name < b.name;
+            });
+  return instance;
+}
+
+WasmInstance::WasmInstance(Isolate* isolate, Handle<JSObject> object)
+    : isolate_(isolate),
+      object_(isolate->global_handles()->Create(*object).location()),
+      trap_(nullptr),
+      busy_(nullptr) {}
+
+WasmInstance::~WasmInstance() { GlobalHandles::Destroy(object_); }
+
+const WasmInstance::Export* WasmInstance::FindExport(const char* name) const {
+  auto it = std::lower_bound(
+      exports_.begin(), exports_.end(), name,
+      [](const Export& entry, const char* key) { return entry.name < key; });
+  if (it == exports_.end() || it->name != name)
+    return nullptr;
+  return &*it;
+}
+
+Address WasmInstance::LookupExport(const char* name) const {
+  const Export* target = FindExport(name);
+  return target == nullptr ? nullptr : target->entry;
+}
+
+const std::vector<LocalType>* WasmInstance::ExportSignature(
+    const char* name) const {
+  const Export* target = FindExport(name);
+  return target == nullptr ? nullptr : &target->types;
+}
+
+WasmCallStatus WasmInstance::CallEntry(Address entry, byte* slots,
+                                       int* trap) {
+  *trap = -1;
+  if (base::NoBarrier_Load(busy_) != 0)
+    return kWasmCallBusy;
+
+#if USE_SIMULATOR && V8_TARGET_ARCH_ARM64
+  Simulator::CallArgument args[] = {Simulator::CallArgument(slots),
+                                    Simulator::CallArgument::End()};
+  Simulator::current(isolate_)->CallInt64(entry, args);
+#elif USE_SIMULATOR
+  Simulator::current(isolate_)->Call(entry, 1, slots);
+#else
+  FUNCTION_CAST<NativeEntry>(entry)(slots);
+#endif
+
+  base::Atomic32 reason = base::NoBarrier_Load(trap_);
+  if (reason != 0) {
+    base::NoBarrier_Store(trap_, 0);
+    *trap = reason - 1;
+    return kWasmCallTrap;
+  }
+  return kWasmCallOk;
+}
+}
+}
+}
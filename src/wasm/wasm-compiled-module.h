@@ -0,0 +1,232 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef V8_WASM_COMPILED_MODULE_H_
+#define V8_WASM_COMPILED_MODULE_H_
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "src/base/atomicops.h"
+#include "src/base/smart-pointers.h"
+#include "src/handles.h"
+#include "src/wasm/tf-builder.h"
+#include "src/wasm/wasm-module.h"
+#include "src/wasm/wasm-result.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+class ModuleFile;
+class WasmInstance;
+
+// The outcome of a call through {WasmInstance::Call}.
+enum WasmCallStatus {
+  kWasmCallOk,
+  kWasmCallTrap,          // the code trapped, see {WasmCallResult::trap}.
+  kWasmCallNoSuchExport,  // no native export with this name and signature.
+  kWasmCallBusy           // a call started by {CallAsync} uses the instance.
+};
+
+struct WasmCallResultBase {
+  WasmCallStatus status;
+  int trap;  // the reason of a trap, see {TrapMessage}, or -1.
+
+  bool ok() const { return status == kWasmCallOk; }
+  const char* trap_message() const {
+    return trap < 0 ? nullptr : TrapMessage(trap);
+  }
+};
+
+// The result of a call returning {R}; {value} is only set if {ok()}.
+template <typename R>
+struct WasmCallResult : public WasmCallResultBase {
+  R value;
+};
+
+template <>
+struct WasmCallResult<void> : public WasmCallResultBase {};
+
+// A module that was decoded and verified once and can be instantiated any
+// number of times from C++, without going through JavaScript.
+class WasmCompiledModule {
+ public:
+  // Copies, decodes and verifies the module. Exports are only called from
+  // C++, so none of them may reach an indirect call, whose target could be
+  // any function. Returns {nullptr} and reports an error through {thrower}
+  // if the module is invalid or has such an export.
+  static WasmCompiledModule* Compile(Isolate* isolate, ErrorThrower& thrower,
+                                     const byte* module_start,
+                                     const byte* module_end);
+  ~WasmCompiledModule();
+
+  // Instantiates the module with the FFI object {imports} and {memory},
+  // either of which may be null. The imports that exports reach must be
+  // host functions, see {NewWasmHostFunction}. The functions are compiled
+  // here, once, since their code embeds the addresses of the memory of the
+  // instance; verification is not repeated. Stores measurements into
+  // {stats} if not null. Returns {nullptr} upon failure, which schedules an
+  // exception on the isolate. The compiled module must outlive its
+  // instances.
+  WasmInstance* Instantiate(ErrorThrower& thrower, Handle<JSObject> imports,
+                            Handle<JSArrayBuffer> memory,
+                            WasmInstantiateStats* stats = nullptr);
+
+  WasmModule* module() const { return module_.get(); }
+
+ private:
+  WasmCompiledModule(Isolate* isolate, ModuleFile* module_file,
+                     WasmModule* module);
+
+  Isolate* isolate_;
+  base::SmartPointer<ModuleFile> module_file_;  // owned copy of the module.
+  base::SmartPointer<WasmModule> module_;
+
+  DISALLOW_COPY_AND_ASSIGN(WasmCompiledModule);
+};
+
+template <typename Sig>
+struct WasmCallSignature;
+
+template <typename Sig>
+class WasmExport;
+
+// An instance of a {WasmCompiledModule}, whose exports are called from C++
+// through their C entry points, see {CompileCToWasmWrapper}. Calls neither
+// box values nor need a HandleScope, and report traps as status codes.
+class WasmInstance {
+ public:
+  ~WasmInstance();
+
+  // The module instance, as created by {WasmModule::Instantiate}. It holds
+  // the memory and the globals, but no JS functions for the exports.
+  Handle<JSObject> object() const {
+    return Handle<JSObject>(reinterpret_cast<JSObject**>(object_));
+  }
+
+  // Looks up the export {name} of type {Sig} once and returns a callable
+  // for it, e.g. {instance->GetExport<int32_t(int32_t)>("f")(1)}, which is
+  // not valid if there is no such export. The signature of the export must
+  // match {Sig} exactly. The callable must not outlive the instance.
+  template <typename Sig>
+  WasmExport<Sig> GetExport(const char* name) {
+    return WasmExport<Sig>(this, name);
+  }
+
+  // Looks up and calls the export {name} as {GetExport} does, e.g.
+  // {instance->Call<int32_t(int32_t, double)>("f", 1, 2.5)}. Only meant
+  // for one-off calls, since the lookup is repeated on every call.
+  template <typename Sig, typename... Params>
+  WasmCallResult<typename WasmCallSignature<Sig>::Return> Call(
+      const char* name, Params... params) {
+    return GetExport<Sig>(name)(params...);
+  }
+
+  // Returns the C entry point of the export {name}, or {nullptr} if there
+  // is no such export that can be called from C++.
+  Address LookupExport(const char* name) const;
+
+  // Returns the types of the export {name}: the return type, or
+  // {kAstStmt}, followed by the parameter types. Returns {nullptr} if
+  // there is no such export that can be called from C++.
+  const std::vector<LocalType>* ExportSignature(const char* name) const;
+
+  // Calls the export at the C entry point {entry}, as returned by
+  // {LookupExport}. {slots} holds the parameters in slots of
+  // {TFBuilder::kSlotSize} bytes, and receives the result in the first
+  // slot. Stores the reason of a trap, or -1, into {trap}.
+  WasmCallStatus CallEntry(Address entry, byte* slots, int* trap);
+
+ private:
+  friend class WasmCompiledModule;
+
+  // An export that can be called through its C entry point.
+  struct Export {
+    std::string name;
+    std::vector<LocalType> types;  // as {EncodeSignature}.
+    Address entry;
+  };
+
+  WasmInstance(Isolate* isolate, Handle<JSObject> object);
+
+  const Export* FindExport(const char* name) const;
+
+  Isolate* isolate_;
+  Object** object_;  // global handle to the module instance.
+  // Words in the globals area, which lives as long as the instance, so
+  // calls read them without creating handles.
+  base::Atomic32* trap_;  // records traps.
+  base::Atomic32* busy_;  // set while a call started by {CallAsync} runs.
+  std::vector<Export> exports_;  // sorted by name.
+
+  DISALLOW_COPY_AND_ASSIGN(WasmInstance);
+};
+
+inline void WriteCallSlots(byte* slot) {}
+
+template <typename T, typename... Rest>
+void WriteCallSlots(byte* slot, T value, Rest... rest) {
+  memcpy(slot, &value, sizeof(value));
+  WriteCallSlots(slot + TFBuilder::kSlotSize, rest...);
+}
+
+template <typename R>
+void ReadCallSlot(WasmCallResult<R>* result, const byte* slot) {
+  memcpy(&result->value, slot, sizeof(result->value));
+}
+
+inline void ReadCallSlot(WasmCallResult<void>* result, const byte* slot) {}
+
+// An export of the C++ function type {R(Args...)} of an instance, see
+// {WasmInstance::GetExport}.
+template <typename R, typename... Args>
+class WasmExport<R(Args...)> {
+ public:
+  WasmExport(WasmInstance* instance, const char* name)
+      : instance_(instance), entry_(nullptr) {
+    LocalType types[] = {LocalTypeForC<R>(), LocalTypeForC<Args>()...};
+    const std::vector<LocalType>* sig = instance->ExportSignature(name);
+    if (sig != nullptr && sig->size() == arraysize(types) &&
+        std::equal(sig->begin(), sig->end(), types)) {
+      entry_ = instance->LookupExport(name);
+    }
+  }
+
+  // False if the instance has no export of this name and type.
+  bool is_valid() const { return entry_ != nullptr; }
+
+  WasmCallResult<R> operator()(Args... args) const {
+    WasmCallResult<R> result;
+    if (!is_valid()) {
+      result.status = kWasmCallNoSuchExport;
+      result.trap = -1;
+      return result;
+    }
+    // Slots are 8 bytes wide and aligned, so they hold any WASM value.
+    uint64_t slots[sizeof...(Args) > 0 ? sizeof...(Args) : 1];
+    byte* bytes = reinterpret_cast<byte*>(slots);
+    WriteCallSlots(bytes, args...);
+    result.status = instance_->CallEntry(entry_, bytes, &result.trap);
+    if (result.ok())
+      ReadCallSlot(&result, bytes);
+    return result;
+  }
+
+ private:
+  WasmInstance* instance_;
+  Address entry_;
+};
+
+// The return type of the C++ function type {R(Args...)}.
+template <typename R, typename... Args>
+struct WasmCallSignature<R(Args...)> {
+  typedef R Return;
+};
+}
+}
+}
+
+#endif  // V8_WASM_COMPILED_MODULE_H_
@@ -0,0 +1,56 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/v8.h"
+
+#include "src/wasm/wasm-host.h"
+#include "src/wasm/wasm-module.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+namespace {
+// Internal constants for the layout of host function objects.
+const int kWasmHostFunctionInternalFieldCount = 2;
+const int kWasmHostFunctionCallback = 0;
+const int kWasmHostFunctionSignature = 1;
+}  // namespace
+
+Handle<JSObject> NewWasmHostFunction(Isolate* isolate, Address callback,
+                                     FunctionSig* sig) {
+  Factory* factory = isolate->factory();
+  Handle<Map> map = factory->NewMap(
+      JS_OBJECT_TYPE, JSObject::kHeaderSize +
+                          kWasmHostFunctionInternalFieldCount * kPointerSize);
+  Handle<JSObject> function = factory->NewJSObjectFromMap(map, TENURED);
+  function->SetInternalField(kWasmHostFunctionCallback,
+                             *factory->NewForeign(callback, TENURED));
+  function->SetInternalField(kWasmHostFunctionSignature,
+                             *EncodeSignature(factory, sig));
+  return function;
+}
+
+bool GetWasmHostFunction(Handle<Object> object, Address* callback,
+                         Handle<ByteArray>* sig) {
+  // Foreigns and byte arrays cannot be stored into internal fields through
+  // the API, so no other object has this layout.
+  if (!object->IsJSObject())
+    return false;
+  Handle<JSObject> function = Handle<JSObject>::cast(object);
+  if (function->GetInternalFieldCount() !=
+          kWasmHostFunctionInternalFieldCount ||
+      !function->GetInternalField(kWasmHostFunctionCallback)->IsForeign() ||
+      !function->GetInternalField(kWasmHostFunctionSignature)->IsByteArray()) {
+    return false;
+  }
+  *callback = Foreign::cast(function->GetInternalField(
+                                kWasmHostFunctionCallback))->foreign_address();
+  *sig = Handle<ByteArray>(ByteArray::cast(
+      function->GetInternalField(kWasmHostFunctionSignature)));
+  return true;
+}
+}
+}
+}
@@ -0,0 +1,46 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef V8_WASM_HOST_H_
+#define V8_WASM_HOST_H_
+
+#include "src/handles.h"
+#include "src/wasm/wasm-opcodes.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+// Creates an object that stands for the native function {callback} in the
+// FFI object of a module. An import of signature {sig} that resolves to it
+// calls {callback} directly with the C calling convention, without
+// converting values to JS, passing the start and size of the linear memory
+// of the calling instance before the WASM parameters. {callback} must not
+// call into JavaScript. Exports reaching host functions can run on native
+// threads, so {callback} must be thread-safe if such exports are called
+// through {ParallelFor} or {CallAsync}.
+Handle<JSObject> NewWasmHostFunction(Isolate* isolate, Address callback,
+                                     FunctionSig* sig);
+
+// Like above, deriving the signature from the C++ type of {callback}, e.g.
+// {int32_t Log(byte* mem_start, size_t mem_size, int32_t ptr, double x)}
+// for the signature (i32, f64)->i32.
+template <typename R, typename... Args>
+Handle<JSObject> NewWasmHostFunction(Isolate* isolate,
+                                     R (*callback)(byte*, size_t, Args...)) {
+  LocalType types[] = {LocalTypeForC<R>(), LocalTypeForC<Args>()...};
+  size_t return_count = types[0] == kAstStmt ? 0 : 1;
+  FunctionSig sig(return_count, sizeof...(Args), types + 1 - return_count);
+  return NewWasmHostFunction(isolate, FUNCTION_ADDR(callback), &sig);
+}
+
+// Returns true if {object} was created by {NewWasmHostFunction}, storing its
+// callback and encoded signature, see {EncodeSignature}.
+bool GetWasmHostFunction(Handle<Object> object, Address* callback,
+                         Handle<ByteArray>* sig);
+}
+}
+}
+
+#endif  // V8_WASM_HOST_H_
@@ -0,0 +1,92 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/v8.h"
+
+#include "src/global-handles.h"
+
+#include "src/wasm/module-decoder.h"
+#include "src/wasm/module-file.h"
+#include "src/wasm/wasm-instance-pool.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+WasmInstancePool* WasmInstancePool::New(Isolate* isolate,
+                                        ErrorThrower& thrower,
+                                        const byte* module_start,
+                                        const byte* module_end,
+                                        Handle<JSObject> ffi,
+                                        const WasmInstanceOptions& options) {
+  // Instances reload their data segments from the module bytes on every
+  // reset, so the pool keeps its own copy of them. Where the copy is backed
+  // by a file, page-aligned segments are mapped rather than copied.
+  ModuleFile* module_file = ModuleFile::FromBytes(module_start, module_end);
+  if (module_file == nullptr) {
+    thrower.Error("Out of memory: wasm module bytes");
+    return nullptr;
+  }
+
+  // Every instance compiles the bodies, which skips the checks once they
+  // are verified here.
+  ModuleResult result = DecodeWasmModule(
+      isolate, module_file->start(), module_file->end(), true, false);
+  if (result.failed()) {
+    thrower.Failed("", result);
+    if (result.val)
+      delete result.val;
+    delete module_file;
+    return nullptr;
+  }
+  result.val->module_fd = module_file->fd();
+  return new WasmInstancePool(isolate, module_file, result.val, ffi, options);
+}
+
+WasmInstancePool::WasmInstancePool(Isolate* isolate, ModuleFile* module_file,
+                                   WasmModule* module, Handle<JSObject> ffi,
+                                   const WasmInstanceOptions& options)
+    : isolate_(isolate),
+      module_file_(module_file),
+      module_(module),
+      ffi_(nullptr),
+      options_(options) {
+  if (!ffi.is_null())
+    ffi_ = isolate->global_handles()->Create(*ffi).location();
+}
+
+WasmInstancePool::~WasmInstancePool() {
+  for (Object** location : idle_) {
+    GlobalHandles::Destroy(location);
+  }
+  if (ffi_ != nullptr)
+    GlobalHandles::Destroy(ffi_);
+}
+
+MaybeHandle<JSObject> WasmInstancePool::Acquire() {
+  if (idle_.empty()) {
+    Handle<JSObject> ffi;
+    if (ffi_ != nullptr)
+      ffi = Handle<JSObject>(JSObject::cast(*ffi_), isolate_);
+    return module_->Instantiate(isolate_, ffi, Handle<JSArrayBuffer>::null(),
+                                options_);
+  }
+  Object** location = idle_.back();
+  idle_.pop_back();
+  Handle<JSObject> instance(JSObject::cast(*location), isolate_);
+  GlobalHandles::Destroy(location);
+  return instance;
+}
+
+bool WasmInstancePool::Release(ErrorThrower& thrower,
+                               Handle<JSObject> instance) {
+  // Reset eagerly so that {Acquire} stays cheap.
+  if (!module_->ResetInstance(thrower, instance, options_))
+    return false;
+  idle_.push_back(isolate_->global_handles()->Create(*instance).location());
+  return true;
+}
+}
+}
+}
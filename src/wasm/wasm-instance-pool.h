@@ -0,0 +1,65 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef V8_WASM_INSTANCE_POOL_H_
+#define V8_WASM_INSTANCE_POOL_H_
+
+#include <vector>
+
+#include "src/base/smart-pointers.h"
+#include "src/handles.h"
+#include "src/wasm/module-file.h"
+#include "src/wasm/wasm-module.h"
+#include "src/wasm/wasm-result.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+// A pool of warm instances of a single module, for embedders that create an
+// instance per request. Released instances are reset rather than thrown
+// away, so acquiring one costs no decoding, compilation or allocation.
+class WasmInstancePool {
+ public:
+  // Copies and decodes the module bytes. Instances are linked against
+  // {ffi} and created with {options}. Returns {nullptr} and reports an error
+  // through {thrower} if the module does not decode.
+  static WasmInstancePool* New(
+      Isolate* isolate, ErrorThrower& thrower, const byte* module_start,
+      const byte* module_end, Handle<JSObject> ffi,
+      const WasmInstanceOptions& options = WasmInstanceOptions());
+  ~WasmInstancePool();
+
+  // Returns an instance in its initial state, instantiating a new one if no
+  // idle instance is available.
+  MaybeHandle<JSObject> Acquire();
+
+  // Resets {instance}, which must have been acquired from this pool, and
+  // makes it available to {Acquire} again. Returns false and reports an
+  // error if {instance} is busy, see {IsInstanceBusy}; it is not pooled
+  // then and can be released again once idle.
+  bool Release(ErrorThrower& thrower, Handle<JSObject> instance);
+
+  // Number of idle instances.
+  size_t idle_count() const { return idle_.size(); }
+
+ private:
+  WasmInstancePool(Isolate* isolate, ModuleFile* module_file,
+                   WasmModule* module, Handle<JSObject> ffi,
+                   const WasmInstanceOptions& options);
+
+  Isolate* isolate_;
+  base::SmartPointer<ModuleFile> module_file_;  // owned copy of the module.
+  base::SmartPointer<WasmModule> module_;
+  Object** ffi_;                 // global handle to the FFI object, if any.
+  WasmInstanceOptions options_;  // options of all instances.
+  std::vector<Object**> idle_;   // global handles to idle instances.
+
+  DISALLOW_COPY_AND_ASSIGN(WasmInstancePool);
+};
+}
+}
+}
+
+#endif  // V8_WASM_INSTANCE_POOL_H_
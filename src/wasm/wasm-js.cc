@@ -19,7 +19,10 @@
 #include "src/wasm/wasm-js.h"
 #include "src/wasm/wasm-module.h"
 #include "src/wasm/module-decoder.h"
+#include "src/wasm/module-file.h"
+#include "src/wasm/wasm-parallel.h"
 #include "src/wasm/wasm-result.h"
+#include "src/wasm/wasm-snapshot.h"
 
 typedef uint8_t byte;
 
@@ -28,46 +31,80 @@ using v8::internal::wasm::ErrorThrower;
 namespace v8 {
 
 namespace {
-struct RawBuffer {
-  const byte* start;
-  const byte* end;
-  size_t size() { return static_cast<size_t>(end - start); }
-};
+// A raw view of the module bytes passed as the argument at {index}, which may
+// be an ArrayBuffer or any ArrayBufferView (typed array or DataView) with an
+// offset. The bytes are read directly from the backing store, without
+// copying or externalizing the buffer. The buffer is pinned (i.e. made
+// non-neuterable) for the lifetime of this object, so the backing store
+// remains valid during decoding and instantiation.
+class RawBuffer {
+ public:
+  RawBuffer(ErrorThrower& thrower,
+            const v8::FunctionCallbackInfo<v8::Value>& args, int index = 0)
+      : start(nullptr), end(nullptr), was_neuterable_(false) {
+    size_t offset = 0;
+    size_t length = 0;
+    if (args.Length() <= index) {
+      thrower.Error("Argument %d must be an array buffer or a view", index);
+      return;
+    }
+    if (args[index]->IsArrayBuffer()) {
+      Local<ArrayBuffer> buffer = Local<ArrayBuffer>::Cast(args[index]);
+      buffer_ = v8::Utils::OpenHandle(*buffer);
+      length = static_cast<size_t>(buffer_->byte_length()->Number());
+    } else if (args[index]->IsArrayBufferView()) {
+      // Materializes the buffer of on-heap typed arrays.
+      Local<ArrayBufferView> view = Local<ArrayBufferView>::Cast(args[index]);
+      buffer_ = v8::Utils::OpenHandle(*view->Buffer());
+      offset = view->ByteOffset();
+      length = view->ByteLength();
+    } else {
+      thrower.Error("Argument %d must be an array buffer or a view", index);
+      return;
+    }
 
-RawBuffer GetRawBufferArgument(
-    ErrorThrower& thrower,
-    const v8::FunctionCallbackInfo<v8::Value>& args) {
-  if (args.Length() < 1 || !args[0]->IsArrayBuffer()) {
-    thrower.Error("Argument 0 must be an array buffer");
-    return {nullptr, nullptr};
-  }
-  Local<ArrayBuffer> buffer = Local<ArrayBuffer>::Cast(args[0]);
-  ArrayBuffer::Contents contents =
-      buffer->IsExternal() ? buffer->GetContents() : buffer->Externalize();
+    if (buffer_->was_neutered() || buffer_->backing_store() == nullptr ||
+        length == 0) {
+      thrower.Error("ArrayBuffer argument is empty");
+      buffer_ = i::Handle<i::JSArrayBuffer>::null();
+      return;
+    }
 
-  // TODO(titzer): allow offsets into buffers, views, etc.
+    was_neuterable_ = buffer_->is_neuterable();
+    buffer_->set_is_neuterable(false);
 
-  const byte* start = reinterpret_cast<const byte*>(contents.Data());
-  const byte* end = start + contents.ByteLength();
+    start = reinterpret_cast<const byte*>(buffer_->backing_store()) + offset;
+    end = start + length;
+  }
 
-  if (start == nullptr) {
-    thrower.Error("ArrayBuffer argument is empty");
+  ~RawBuffer() {
+    // Unpin the buffer.
+    if (!buffer_.is_null()) buffer_->set_is_neuterable(was_neuterable_);
   }
-  return {start, end};
-}
+
+  size_t size() { return static_cast<size_t>(end - start); }
+
+  const byte* start;
+  const byte* end;
+
+ private:
+  i::Handle<i::JSArrayBuffer> buffer_;
+  bool was_neuterable_;
+
+  DISALLOW_COPY_AND_ASSIGN(RawBuffer);
+};
 
 void VerifyModule(const v8::FunctionCallbackInfo<v8::Value>& args) {
   HandleScope scope(args.GetIsolate());
   i::Isolate* isolate = reinterpret_cast<i::Isolate*>(args.GetIsolate());
   ErrorThrower thrower(isolate, "WASM.verifyModule()");
 
-  RawBuffer buffer = GetRawBufferArgument(thrower, args);
+  RawBuffer buffer(thrower, args);
   if (thrower.error())
     return;
 
-  i::Zone zone;
   internal::wasm::ModuleResult result = internal::wasm::DecodeWasmModule(
-      isolate, &zone, buffer.start, buffer.end, true, false);
+      isolate, buffer.start, buffer.end, true, false);
 
   if (result.failed()) {
     thrower.Failed("", result);
@@ -82,8 +119,7 @@ void VerifyFunction(const v8::FunctionCallbackInfo<v8::Value>& args) {
   i::Isolate* isolate = reinterpret_cast<i::Isolate*>(args.GetIsolate());
   ErrorThrower thrower(isolate, "WASM.verifyFunction()");
 
-  // TODO(titzer): no need to externalize to get the bytes for verification.
-  RawBuffer buffer = GetRawBufferArgument(thrower, args);
+  RawBuffer buffer(thrower, args);
   if (thrower.error())
     return;
 
@@ -109,14 +145,13 @@ void CompileRun(const v8::FunctionCallbackInfo<v8::Value>& args) {
   i::Isolate* isolate = reinterpret_cast<i::Isolate*>(args.GetIsolate());
   ErrorThrower thrower(isolate, "WASM.compileRun()");
 
-  RawBuffer buffer = GetRawBufferArgument(thrower, args);
+  RawBuffer buffer(thrower, args);
   if (thrower.error())
     return;
 
-  // Decode and pre-verify the functions before compiling and running.
-  i::Zone zone;
+  // Verify the bodies while decoding, so compilation can skip the checks.
   internal::wasm::ModuleResult result = internal::wasm::DecodeWasmModule(
-      isolate, &zone, buffer.start, buffer.end, true, false);
+      isolate, buffer.start, buffer.end, true, false);
 
   if (result.failed()) {
     thrower.Failed("", result);
@@ -177,43 +212,196 @@ void AsmCompileRun(const v8::FunctionCallbackInfo<v8::Value>& args) {
   args.GetReturnValue().Set(result);
 }
 
+// Gets the optional FFI object argument at {index}.
+i::Handle<i::JSObject> GetFFIArgument(
+    const v8::FunctionCallbackInfo<v8::Value>& args, int index) {
+  if (args.Length() > index && args[index]->IsObject()) {
+    Local<Object> obj = Local<Object>::Cast(args[index]);
+    return i::Handle<i::JSObject>::cast(v8::Utils::OpenHandle(*obj));
+  }
+  return i::Handle<i::JSObject>::null();
+}
+
+// Gets the optional memory argument at {index}, taking ownership of its
+// backing store. Shared memories of other instances already own theirs.
+i::Handle<i::JSArrayBuffer> GetMemoryArgument(
+    const v8::FunctionCallbackInfo<v8::Value>& args, int index) {
+  if (args.Length() > index &&
+      (args[index]->IsArrayBuffer() || args[index]->IsSharedArrayBuffer())) {
+    Local<Object> obj = Local<Object>::Cast(args[index]);
+    i::Handle<i::Object> mem_obj = v8::Utils::OpenHandle(*obj);
+    i::Handle<i::JSArrayBuffer> memory(i::JSArrayBuffer::cast(*mem_obj));
+    i::Isolate* isolate = memory->GetIsolate();
+    if (!memory->is_external()) {
+      memory->set_is_external(true);
+      isolate->heap()->UnregisterArrayBuffer(*memory);
+    }
+    return memory;
+  }
+  return i::Handle<i::JSArrayBuffer>::null();
+}
+
+// Gets the boolean property {name} of the optional options object argument
+// at {index}, or false if there is no such argument or property.
+bool GetBooleanOption(const v8::FunctionCallbackInfo<v8::Value>& args,
+                      int index, const char* name) {
+  if (args.Length() <= index || !args[index]->IsObject())
+    return false;
+  Local<Object> obj = Local<Object>::Cast(args[index]);
+  i::Handle<i::Object> options = v8::Utils::OpenHandle(*obj);
+  i::Isolate* isolate = reinterpret_cast<i::Isolate*>(args.GetIsolate());
+  i::Handle<i::String> key = isolate->factory()->InternalizeUtf8String(name);
+  i::Handle<i::Object> value;
+  if (!i::Object::GetProperty(options, key).ToHandle(&value))
+    return false;
+  return value->BooleanValue();
+}
+
 void InstantiateModule(const v8::FunctionCallbackInfo<v8::Value>& args) {
   HandleScope scope(args.GetIsolate());
   i::Isolate* isolate = reinterpret_cast<i::Isolate*>(args.GetIsolate());
   ErrorThrower thrower(isolate, "WASM.instantiateModule()");
 
-  RawBuffer buffer = GetRawBufferArgument(thrower, args);
+  RawBuffer buffer(thrower, args);
   if (buffer.start == nullptr)
     return;
 
-  i::Handle<i::JSArrayBuffer> memory = i::Handle<i::JSArrayBuffer>::null();
-  if (args.Length() > 2 && args[2]->IsArrayBuffer()) {
-    Local<Object> obj = Local<Object>::Cast(args[2]);
-    i::Handle<i::Object> mem_obj = v8::Utils::OpenHandle(*obj);
-    memory = i::Handle<i::JSArrayBuffer>(i::JSArrayBuffer::cast(*mem_obj));
-    i::Isolate* isolate = memory->GetIsolate();
-    memory->set_is_external(true);
-    isolate->heap()->UnregisterArrayBuffer(*memory);
-  }
+  i::Handle<i::JSArrayBuffer> memory = GetMemoryArgument(args, 2);
 
-  // Decode but avoid a redundant pass over function bodies for verification.
-  // Verification will happen during compilation.
-  i::Zone zone;
+  // Verify the bodies while decoding, so compilation can skip the checks.
   internal::wasm::ModuleResult result = internal::wasm::DecodeWasmModule(
-      isolate, &zone, buffer.start, buffer.end, false, false);
+      isolate, buffer.start, buffer.end, true, false);
 
   if (result.failed()) {
     thrower.Failed("", result);
   } else {
     // Success. Instantiate the module and return the object.
-    i::Handle<i::JSObject> ffi = i::Handle<i::JSObject>::null();
-    if (args.Length() > 1 && args[1]->IsObject()) {
-      Local<Object> obj = Local<Object>::Cast(args[1]);
-      ffi = i::Handle<i::JSObject>::cast(v8::Utils::OpenHandle(*obj));
-    }
+    i::Handle<i::JSObject> ffi = GetFFIArgument(args, 1);
+    internal::wasm::WasmInstanceOptions options;
+    options.mem_huge_pages = GetBooleanOption(args, 3, "hugePages");
+    options.mem_masked = GetBooleanOption(args, 3, "maskMemory");
+    options.parallel_exports = GetBooleanOption(args, 3, "parallel");
 
     i::MaybeHandle<i::JSObject> object = result.val->Instantiate(
-        isolate, ffi, memory);
+        isolate, ffi, memory, options);
+
+    if (!object.is_null()) {
+      args.GetReturnValue().Set(v8::Utils::ToLocal(object.ToHandleChecked()));
+    }
+  }
+
+  if (result.val)
+    delete result.val;
+}
+
+void InstantiateFile(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  HandleScope scope(args.GetIsolate());
+  i::Isolate* isolate = reinterpret_cast<i::Isolate*>(args.GetIsolate());
+  ErrorThrower thrower(isolate, "WASM.instantiateFile()");
+
+  if (args.Length() < 1 || !args[0]->IsString()) {
+    thrower.Error("Argument 0 must be a file path");
+    return;
+  }
+  String::Utf8Value path(args[0]);
+
+  // The module file is mapped read-only and decoded in place.
+  i::MaybeHandle<i::JSObject> object = internal::wasm::InstantiateModuleFile(
+      isolate, *path, GetFFIArgument(args, 1), GetMemoryArgument(args, 2));
+
+  if (!object.is_null()) {
+    args.GetReturnValue().Set(v8::Utils::ToLocal(object.ToHandleChecked()));
+  }
+}
+
+void Snapshot(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  HandleScope scope(args.GetIsolate());
+  i::Isolate* isolate = reinterpret_cast<i::Isolate*>(args.GetIsolate());
+  ErrorThrower thrower(isolate, "WASM.snapshot()");
+
+  if (args.Length() < 1 || !args[0]->IsObject()) {
+    thrower.Error("Argument 0 must be a WASM instance");
+    return;
+  }
+  Local<Object> obj = Local<Object>::Cast(args[0]);
+  i::Handle<i::JSObject> instance =
+      i::Handle<i::JSObject>::cast(v8::Utils::OpenHandle(*obj));
+
+  internal::wasm::WasmSnapshot* snapshot =
+      internal::wasm::WasmSnapshot::New(isolate, thrower, instance);
+  if (snapshot != nullptr) {
+    args.GetReturnValue().Set(v8::Utils::ToLocal(
+        internal::wasm::WasmSnapshot::ToObject(isolate, snapshot)));
+  }
+}
+
+void Fork(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  HandleScope scope(args.GetIsolate());
+  i::Isolate* isolate = reinterpret_cast<i::Isolate*>(args.GetIsolate());
+  ErrorThrower thrower(isolate, "WASM.fork()");
+
+  internal::wasm::WasmSnapshot* snapshot = nullptr;
+  if (args.Length() > 0) {
+    snapshot = internal::wasm::WasmSnapshot::FromObject(
+        v8::Utils::OpenHandle(*args[0]));
+  }
+  if (snapshot == nullptr) {
+    thrower.Error("Argument 0 must be a WASM snapshot");
+    return;
+  }
+
+  i::MaybeHandle<i::JSObject> object = snapshot->Fork();
+  if (!object.is_null()) {
+    args.GetReturnValue().Set(v8::Utils::ToLocal(object.ToHandleChecked()));
+  }
+}
+
+void SaveInstance(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  HandleScope scope(args.GetIsolate());
+  i::Isolate* isolate = reinterpret_cast<i::Isolate*>(args.GetIsolate());
+  ErrorThrower thrower(isolate, "WASM.saveInstance()");
+
+  if (args.Length() < 1 || !args[0]->IsObject()) {
+    thrower.Error("Argument 0 must be a WASM instance");
+    return;
+  }
+  Local<Object> obj = Local<Object>::Cast(args[0]);
+  i::Handle<i::JSObject> instance =
+      i::Handle<i::JSObject>::cast(v8::Utils::OpenHandle(*obj));
+
+  if (args.Length() < 2 || !args[1]->IsString()) {
+    thrower.Error("Argument 1 must be a file path");
+    return;
+  }
+  String::Utf8Value path(args[1]);
+
+  internal::wasm::SaveInstanceState(thrower, instance, *path);
+}
+
+void RestoreInstance(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  HandleScope scope(args.GetIsolate());
+  i::Isolate* isolate = reinterpret_cast<i::Isolate*>(args.GetIsolate());
+  ErrorThrower thrower(isolate, "WASM.restoreInstance()");
+
+  RawBuffer buffer(thrower, args);
+  if (buffer.start == nullptr)
+    return;
+
+  if (args.Length() < 2 || !args[1]->IsString()) {
+    thrower.Error("Argument 1 must be a file path");
+    return;
+  }
+  String::Utf8Value path(args[1]);
+
+  // Verify the bodies while decoding, so compilation can skip the checks.
+  internal::wasm::ModuleResult result = internal::wasm::DecodeWasmModule(
+      isolate, buffer.start, buffer.end, true, false);
+
+  if (result.failed()) {
+    thrower.Failed("", result);
+  } else {
+    i::MaybeHandle<i::JSObject> object = internal::wasm::RestoreInstanceState(
+        isolate, thrower, result.val, GetFFIArgument(args, 2), *path);
 
     if (!object.is_null()) {
       args.GetReturnValue().Set(v8::Utils::ToLocal(object.ToHandleChecked()));
@@ -223,6 +411,111 @@ void InstantiateModule(const v8::FunctionCallbackInfo<v8::Value>& args) {
   if (result.val)
     delete result.val;
 }
+
+void DiscardMemory(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  HandleScope scope(args.GetIsolate());
+  i::Isolate* isolate = reinterpret_cast<i::Isolate*>(args.GetIsolate());
+  ErrorThrower thrower(isolate, "WASM.discardMemory()");
+
+  if (args.Length() < 1 || !args[0]->IsObject()) {
+    thrower.Error("Argument 0 must be a WASM instance");
+    return;
+  }
+  Local<Object> obj = Local<Object>::Cast(args[0]);
+  i::Handle<i::JSObject> instance =
+      i::Handle<i::JSObject>::cast(v8::Utils::OpenHandle(*obj));
+
+  if (args.Length() < 3 || !args[1]->IsUint32() || !args[2]->IsUint32()) {
+    thrower.Error("Arguments 1 and 2 must be an offset and a size");
+    return;
+  }
+  size_t offset =
+      static_cast<size_t>(v8::Utils::OpenHandle(*args[1])->Number());
+  size_t size = static_cast<size_t>(v8::Utils::OpenHandle(*args[2])->Number());
+  internal::wasm::DiscardInstanceMemory(thrower, instance, offset, size);
+}
+
+void ParallelFor(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  HandleScope scope(args.GetIsolate());
+  i::Isolate* isolate = reinterpret_cast<i::Isolate*>(args.GetIsolate());
+  ErrorThrower thrower(isolate, "WASM.parallelFor()");
+
+  if (args.Length() < 1 || !args[0]->IsObject()) {
+    thrower.Error("Argument 0 must be a WASM instance");
+    return;
+  }
+  Local<Object> obj = Local<Object>::Cast(args[0]);
+  i::Handle<i::JSObject> instance =
+      i::Handle<i::JSObject>::cast(v8::Utils::OpenHandle(*obj));
+
+  if (args.Length() < 2 || !args[1]->IsString()) {
+    thrower.Error("Argument 1 must be the name of an export");
+    return;
+  }
+  i::Handle<i::String> name = i::Handle<i::String>::cast(
+      v8::Utils::OpenHandle(*args[1]));
+
+  if (args.Length() < 5 || !args[2]->IsInt32() || !args[3]->IsInt32() ||
+      !args[4]->IsInt32()) {
+    thrower.Error("Arguments 2 to 4 must be a begin, an end and a grain");
+    return;
+  }
+  int32_t begin =
+      static_cast<int32_t>(v8::Utils::OpenHandle(*args[2])->Number());
+  int32_t end = static_cast<int32_t>(v8::Utils::OpenHandle(*args[3])->Number());
+  int32_t grain =
+      static_cast<int32_t>(v8::Utils::OpenHandle(*args[4])->Number());
+  internal::wasm::ParallelFor(thrower, isolate, instance, name, begin, end,
+                              grain);
+}
+
+void CallAsync(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  HandleScope scope(args.GetIsolate());
+  i::Isolate* isolate = reinterpret_cast<i::Isolate*>(args.GetIsolate());
+  ErrorThrower thrower(isolate, "WASM.callAsync()");
+
+  if (args.Length() < 1 || !args[0]->IsObject()) {
+    thrower.Error("Argument 0 must be a WASM instance");
+    return;
+  }
+  Local<Object> obj = Local<Object>::Cast(args[0]);
+  i::Handle<i::JSObject> instance =
+      i::Handle<i::JSObject>::cast(v8::Utils::OpenHandle(*obj));
+
+  if (args.Length() < 2 || !args[1]->IsString()) {
+    thrower.Error("Argument 1 must be the name of an export");
+    return;
+  }
+  i::Handle<i::String> name = i::Handle<i::String>::cast(
+      v8::Utils::OpenHandle(*args[1]));
+
+  // The arguments are converted to numbers up front, so that no JavaScript
+  // runs once the call has started.
+  std::vector<double> call_args;
+  if (args.Length() > 2 && !args[2]->IsUndefined()) {
+    if (!args[2]->IsArray()) {
+      thrower.Error("Argument 2 must be an array of arguments");
+      return;
+    }
+    Local<v8::Context> context = args.GetIsolate()->GetCurrentContext();
+    Local<v8::Array> array = Local<v8::Array>::Cast(args[2]);
+    for (uint32_t i = 0; i < array->Length(); i++) {
+      Local<Value> element;
+      double number;
+      if (!array->Get(context, i).ToLocal(&element) ||
+          !element->NumberValue(context).To(&number)) {
+        return;
+      }
+      call_args.push_back(number);
+    }
+  }
+
+  i::MaybeHandle<i::JSObject> promise =
+      internal::wasm::CallAsync(thrower, isolate, instance, name, call_args);
+  if (!promise.is_null()) {
+    args.GetReturnValue().Set(v8::Utils::ToLocal(promise.ToHandleChecked()));
+  }
+}
 }
 
 // TODO(titzer): we use the API to create the function template because the
@@ -267,10 +560,18 @@ void WasmJs::Install(Isolate* isolate, Handle<JSGlobalObject> global) {
 
   // Install functions on the WASM object.
   InstallFunc(isolate, wasm_object, "instantiateModule", InstantiateModule);
+  InstallFunc(isolate, wasm_object, "instantiateFile", InstantiateFile);
   InstallFunc(isolate, wasm_object, "verifyModule", VerifyModule);
   InstallFunc(isolate, wasm_object, "verifyFunction", VerifyFunction);
   InstallFunc(isolate, wasm_object, "compileRun", CompileRun);
   InstallFunc(isolate, wasm_object, "asmCompileRun", AsmCompileRun);
+  InstallFunc(isolate, wasm_object, "snapshot", Snapshot);
+  InstallFunc(isolate, wasm_object, "fork", Fork);
+  InstallFunc(isolate, wasm_object, "saveInstance", SaveInstance);
+  InstallFunc(isolate, wasm_object, "restoreInstance", RestoreInstance);
+  InstallFunc(isolate, wasm_object, "discardMemory", DiscardMemory);
+  InstallFunc(isolate, wasm_object, "parallelFor", ParallelFor);
+  InstallFunc(isolate, wasm_object, "callAsync", CallAsync);
 }
 }  // namespace internal
 }  // namespace v8
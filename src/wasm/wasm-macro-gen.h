@@ -96,6 +96,24 @@
 #define WASM_STORE_MEM_OFFSET(type, offset, index, val)	  \
   v8::internal::wasm::WasmOpcodes::LoadStoreOpcodeOf(type, true), \
     v8::internal::wasm::WasmOpcodes::LoadStoreAccessOf(type, true), static_cast<byte>(offset), index, val
+#define WASM_ATOMIC_LOAD_MEM(type, atomicity, index)               \
+  v8::internal::wasm::WasmOpcodes::LoadStoreOpcodeOf(type, false),  \
+      v8::internal::wasm::WasmOpcodes::LoadStoreAccessOf(           \
+          type, false, v8::internal::wasm::MemoryAccess::atomicity), \
+      index
+#define WASM_ATOMIC_STORE_MEM(type, atomicity, index, val)          \
+  v8::internal::wasm::WasmOpcodes::LoadStoreOpcodeOf(type, true),   \
+      v8::internal::wasm::WasmOpcodes::LoadStoreAccessOf(           \
+          type, false, v8::internal::wasm::MemoryAccess::atomicity), \
+      index, val
+#define WASM_ATOMIC_MEM(opcode, index, val) \
+  kExprI32Atomic##opcode, 0, index, val
+#define WASM_ATOMIC_MEM_OFFSET(opcode, offset, index, val)      \
+  kExprI32Atomic##opcode,                                       \
+      v8::internal::wasm::MemoryAccess::OffsetField::encode(true), \
+      static_cast<byte>(offset), index, val
+#define WASM_ATOMIC_CMPXCHG(index, expected, val) \
+  kExprI32AtomicCompareExchange, 0, index, expected, val
 #define WASM_CALL_FUNCTION(index, ...) \
   kExprCallFunction, static_cast<byte>(index), __VA_ARGS__
 #define WASM_CALL_INDIRECT(index, func, ...) \
@@ -0,0 +1,317 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <map>
+#include <vector>
+
+#include "src/v8.h"
+
+#include "src/base/platform/mutex.h"
+#include "src/base/platform/platform.h"
+#include "src/global-handles.h"
+
+#include "src/wasm/wasm-memory.h"
+
+#if V8_OS_POSIX
+#include <sys/mman.h>
+#endif
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+namespace {
+#if V8_OS_LINUX && defined(MADV_HUGEPAGE)
+const size_t kHugePageSize = 2 * MB;
+
+// Reserves {size} bytes starting at a huge page boundary, so that the kernel
+// can back the whole range with transparent huge pages.
+void* ReserveHugePageAligned(size_t size) {
+  size_t padded_size = size + kHugePageSize;
+  void* padded = base::VirtualMemory::ReserveRegion(padded_size);
+  if (padded == nullptr)
+    return nullptr;
+  uintptr_t padded_start = reinterpret_cast<uintptr_t>(padded);
+  uintptr_t start = RoundUp(padded_start, kHugePageSize);
+  size_t head = start - padded_start;
+  size_t tail = padded_size - head - size;
+  if (head > 0)
+    base::VirtualMemory::ReleaseRegion(padded, head);
+  if (tail > 0)
+    base::VirtualMemory::ReleaseRegion(reinterpret_cast<void*>(start + size),
+                                       tail);
+  return reinterpret_cast<void*>(start);
+}
+#endif
+}  // namespace
+
+WasmMemory* WasmMemory::Allocate(size_t size, size_t reserved_size,
+                                 bool huge_pages) {
+  size_t page_size = static_cast<size_t>(base::OS::CommitPageSize());
+#if V8_OS_LINUX && defined(MADV_HUGEPAGE)
+  if (huge_pages)
+    page_size = kHugePageSize;
+#else
+  huge_pages = false;
+#endif
+  size_t commit_size = RoundUp(size, page_size);
+  if (commit_size == 0)
+    commit_size = page_size;
+  reserved_size = RoundUp(reserved_size, page_size);
+  if (reserved_size < commit_size)
+    reserved_size = commit_size;
+
+  // Freshly committed anonymous pages are zero, so there is no need to
+  // clear them.
+  void* start = nullptr;
+#if V8_OS_LINUX && defined(MADV_HUGEPAGE)
+  if (huge_pages)
+    start = ReserveHugePageAligned(reserved_size);
+  else
+#endif
+    start = base::VirtualMemory::ReserveRegion(reserved_size);
+  if (start == nullptr)
+    return nullptr;
+  if (!base::VirtualMemory::CommitRegion(start, commit_size, false)) {
+    base::VirtualMemory::ReleaseRegion(start, reserved_size);
+    return nullptr;
+  }
+#if V8_OS_LINUX && defined(MADV_HUGEPAGE)
+  // Only a hint: without transparent huge pages the memory still works.
+  if (huge_pages)
+    madvise(start, commit_size, MADV_HUGEPAGE);
+#endif
+  return new WasmMemory(reinterpret_cast<byte*>(start), size, reserved_size);
+}
+
+WasmMemory::~WasmMemory() {
+  base::VirtualMemory::ReleaseRegion(start_, reserved_size_);
+}
+
+WasmMemory* WasmMemory::MapCopyOnWrite(int fd, size_t size, size_t offset) {
+#if V8_OS_POSIX
+  size_t page_size = static_cast<size_t>(base::OS::CommitPageSize());
+  size_t map_size = RoundUp(size, page_size);
+  void* start = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                     fd, static_cast<off_t>(offset));
+  if (start == MAP_FAILED)
+    return nullptr;
+  return new WasmMemory(reinterpret_cast<byte*>(start), size, map_size);
+#else
+  return nullptr;
+#endif
+}
+
+bool WasmMemory::MapCopyOnWriteAt(byte* start, size_t size, int fd,
+                                  size_t offset) {
+#if V8_OS_POSIX
+  intptr_t page_size = base::OS::CommitPageSize();
+  DCHECK(IsAligned(reinterpret_cast<intptr_t>(start), page_size));
+  DCHECK(IsAligned(size, page_size));
+  DCHECK(IsAligned(offset, page_size));
+  void* result = mmap(start, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_FIXED, fd, static_cast<off_t>(offset));
+  return result != MAP_FAILED;
+#else
+  return false;
+#endif
+}
+
+void WasmMemory::Discard(byte* start, size_t size) {
+  uintptr_t page_size = static_cast<uintptr_t>(base::OS::CommitPageSize());
+  uintptr_t begin = reinterpret_cast<uintptr_t>(start);
+  uintptr_t end = begin + size;
+  uintptr_t page_begin = RoundUp(begin, page_size);
+  uintptr_t page_end = RoundDown(end, page_size);
+  if (page_begin >= page_end) {
+    memset(start, 0, size);
+    return;
+  }
+  memset(start, 0, page_begin - begin);
+  memset(reinterpret_cast<void*>(page_end), 0, end - page_end);
+
+  void* pages = reinterpret_cast<void*>(page_begin);
+  size_t pages_size = page_end - page_begin;
+#if V8_OS_POSIX
+  // Private anonymous pages read as zero after being dropped.
+  CHECK_EQ(0, madvise(pages, pages_size, MADV_DONTNEED));
+#else
+  CHECK(base::VirtualMemory::UncommitRegion(pages, pages_size));
+  CHECK(base::VirtualMemory::CommitRegion(pages, pages_size, false));
+#endif
+}
+
+void WasmMemory::Decommit(byte* start, size_t size) {
+  intptr_t page_size = base::OS::CommitPageSize();
+  DCHECK(IsAligned(reinterpret_cast<intptr_t>(start), page_size));
+  DCHECK(IsAligned(size, page_size));
+  if (size == 0)
+    return;
+#if V8_OS_POSIX
+  // A fixed anonymous mapping atomically replaces whatever backed the range.
+  void* result = mmap(start, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+  CHECK(result != MAP_FAILED);
+#else
+  CHECK(base::VirtualMemory::UncommitRegion(start, size));
+  CHECK(base::VirtualMemory::CommitRegion(start, size, false));
+#endif
+}
+
+bool WasmMemory::CommitGuard(size_t guard_size) {
+  uintptr_t page_size = static_cast<uintptr_t>(base::OS::CommitPageSize());
+  uintptr_t committed_end =
+      RoundUp(reinterpret_cast<uintptr_t>(end()), page_size);
+  uintptr_t guard_end =
+      RoundUp(reinterpret_cast<uintptr_t>(end()) + guard_size, page_size);
+  if (guard_end > reinterpret_cast<uintptr_t>(start_) + reserved_size_)
+    return false;
+  if (guard_end <= committed_end)
+    return true;
+  return base::VirtualMemory::CommitRegion(
+      reinterpret_cast<void*>(committed_end), guard_end - committed_end,
+      false);
+}
+
+size_t WasmMemory::CommittedSize() const {
+#if V8_OS_LINUX
+  // Memories of up to 4gb have up to a million pages, so the residency
+  // vector stays small.
+  size_t page_size = static_cast<size_t>(base::OS::CommitPageSize());
+  size_t pages = RoundUp(size_, page_size) / page_size;
+  std::vector<unsigned char> resident(pages);
+  if (mincore(start_, pages * page_size, resident.data()) != 0)
+    return size_;
+  size_t committed = 0;
+  for (unsigned char page : resident) {
+    if (page & 1)
+      committed += page_size;
+  }
+  return committed;
+#else
+  return size_;
+#endif
+}
+
+namespace {
+struct WasmMemoryFinalizer {
+  Object** location;   // weak global handle to the array buffer.
+  WasmMemory* memory;  // backing store of the array buffer.
+  int64_t reported;    // bytes reported to the heap for the buffer.
+};
+
+// A memory wrapped into array buffers, possibly in several isolates that
+// share it. Each buffer holds one reference.
+struct WrappedWasmMemory {
+  WasmMemory* memory;
+  int references;
+};
+
+// Memories wrapped into array buffers, by start address. Buffers of all
+// isolates are listed, so the table is guarded by a lock.
+base::LazyMutex wrapped_memories_mutex = LAZY_MUTEX_INITIALIZER;
+std::map<const void*, WrappedWasmMemory>* wrapped_memories = nullptr;
+
+void FreeWasmMemory(const v8::WeakCallbackInfo<void>& data) {
+  WasmMemoryFinalizer* finalizer =
+      reinterpret_cast<WasmMemoryFinalizer*>(data.GetParameter());
+  WasmMemory* memory = finalizer->memory;
+  data.GetIsolate()->AdjustAmountOfExternalAllocatedMemory(
+      -finalizer->reported);
+  GlobalHandles::Destroy(finalizer->location);
+  delete finalizer;
+  {
+    base::LockGuard<base::Mutex> lock(wrapped_memories_mutex.Pointer());
+    auto it = wrapped_memories->find(memory->start());
+    DCHECK(it != wrapped_memories->end());
+    if (--it->second.references > 0)
+      return;
+    wrapped_memories->erase(it);
+  }
+  delete memory;
+}
+
+// Releases one reference to {memory} when {buffer} is collected.
+void AddWasmMemoryFinalizer(Isolate* isolate, Handle<JSArrayBuffer> buffer,
+                            WasmMemory* memory) {
+  WasmMemoryFinalizer* finalizer = new WasmMemoryFinalizer();
+  finalizer->location = isolate->global_handles()->Create(*buffer).location();
+  finalizer->memory = memory;
+  // Only pages that hold data cost memory; a 4gb memory is mostly untouched
+  // zero pages. The same amount is given back when the buffer is collected.
+  finalizer->reported = static_cast<int64_t>(memory->CommittedSize());
+  GlobalHandles::MakeWeak(finalizer->location, finalizer, &FreeWasmMemory,
+                          v8::WeakCallbackType::kParameter);
+  reinterpret_cast<v8::Isolate*>(isolate)
+      ->AdjustAmountOfExternalAllocatedMemory(finalizer->reported);
+}
+}  // namespace
+
+Handle<JSArrayBuffer> WrapWasmMemory(Isolate* isolate, WasmMemory* memory,
+                                     bool shared) {
+  size_t size = memory->size();
+  SharedFlag shared_flag =
+      shared ? SharedFlag::kShared : SharedFlag::kNotShared;
+  Handle<JSArrayBuffer> buffer =
+      isolate->factory()->NewJSArrayBuffer(shared_flag);
+  JSArrayBuffer::Setup(buffer, isolate, true, memory->start(), size,
+                       shared_flag);
+  buffer->set_is_neuterable(false);
+
+  {
+    base::LockGuard<base::Mutex> lock(wrapped_memories_mutex.Pointer());
+    if (wrapped_memories == nullptr)
+      wrapped_memories = new std::map<const void*, WrappedWasmMemory>();
+    WrappedWasmMemory& wrapped = (*wrapped_memories)[memory->start()];
+    wrapped.memory = memory;
+    wrapped.references = 1;
+  }
+  // The buffer is external, so the heap only frees the mapping through this
+  // weak handle.
+  AddWasmMemoryFinalizer(isolate, buffer, memory);
+  return buffer;
+}
+
+WasmMemory* FindWrappedWasmMemory(const void* backing_store) {
+  base::LockGuard<base::Mutex> lock(wrapped_memories_mutex.Pointer());
+  if (wrapped_memories == nullptr)
+    return nullptr;
+  auto it = wrapped_memories->find(backing_store);
+  return it == wrapped_memories->end() ? nullptr : it->second.memory;
+}
+
+bool RetainWrappedWasmMemory(Isolate* isolate, Handle<JSArrayBuffer> buffer) {
+  WasmMemory* memory = nullptr;
+  {
+    base::LockGuard<base::Mutex> lock(wrapped_memories_mutex.Pointer());
+    if (wrapped_memories == nullptr)
+      return false;
+    auto it = wrapped_memories->find(buffer->backing_store());
+    if (it == wrapped_memories->end())
+      return false;
+    it->second.references++;
+    memory = it->second.memory;
+  }
+  AddWasmMemoryFinalizer(isolate, buffer, memory);
+  return true;
+}
+
+Handle<JSArrayBuffer> NewWasmMemoryBuffer(Isolate* isolate, size_t size,
+                                          byte** backing_store,
+                                          bool huge_pages,
+                                          size_t guard_size, bool shared) {
+  WasmMemory* memory =
+      WasmMemory::Allocate(size, size + guard_size, huge_pages);
+  if (memory == nullptr)
+    return Handle<JSArrayBuffer>::null();
+  if (guard_size > 0 && !memory->CommitGuard(guard_size)) {
+    delete memory;
+    return Handle<JSArrayBuffer>::null();
+  }
+  *backing_store = memory->start();
+  return WrapWasmMemory(isolate, memory, shared);
+}
+}
+}
+}
@@ -0,0 +1,114 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef V8_WASM_MEMORY_H_
+#define V8_WASM_MEMORY_H_
+
+#include "src/handles.h"
+#include "src/wasm/wasm-opcodes.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+// Backing store for the linear memory or the globals area of an instance.
+// The bytes come straight from anonymous virtual memory, so they start out
+// as shared zero pages and only consume physical memory once touched. The
+// mapping is released in one step when the {WasmMemory} is deleted.
+class WasmMemory {
+ public:
+  // Reserves {reserved_size} bytes of address space and commits the first
+  // {size} bytes of it, zero-initialized. A {reserved_size} smaller than
+  // {size} reserves exactly {size} bytes. With {huge_pages}, the memory is
+  // aligned and rounded to 2mb and advised to be backed by transparent huge
+  // pages where the platform supports them. Returns {nullptr} upon failure.
+  static WasmMemory* Allocate(size_t size, size_t reserved_size = 0,
+                              bool huge_pages = false);
+  ~WasmMemory();
+
+  // Maps {size} bytes of the file {fd}, starting at the page-aligned
+  // {offset}, as private copy-on-write memory, so that pages are shared with
+  // other mappings of the file until they are written. {Discard} restores
+  // such pages to the file contents rather than zeroing them. Returns
+  // {nullptr} upon failure or if the platform has no file mappings.
+  static WasmMemory* MapCopyOnWrite(int fd, size_t size, size_t offset = 0);
+
+  // Replaces the pages at {start}, which must lie within a {WasmMemory}, by
+  // a private copy-on-write mapping of {size} bytes of the file {fd} at
+  // {offset}. {start}, {size} and {offset} must be page-aligned. Returns
+  // false, leaving the memory untouched, if the file cannot be mapped.
+  static bool MapCopyOnWriteAt(byte* start, size_t size, int fd,
+                               size_t offset);
+
+  // Zeroes {size} bytes at {start}, which must lie within a {WasmMemory}.
+  // Whole pages are handed back to the OS and read as zero pages again on
+  // their next access; partial pages at either end are cleared in place.
+  static void Discard(byte* start, size_t size);
+
+  // Replaces the pages at {start}, which must lie within a {WasmMemory}, by
+  // fresh zero pages and hands their physical memory back to the OS. Unlike
+  // {Discard}, pages mapped from a file read as zero afterwards, too.
+  // {start} and {size} must be page-aligned.
+  static void Decommit(byte* start, size_t size);
+
+  // Commits zero pages for at least {guard_size} bytes past the end of the
+  // memory, so that accesses straddling the end stay within mapped memory.
+  // The guard must fit into the reservation. Returns false upon failure.
+  bool CommitGuard(size_t guard_size);
+
+  // Returns the number of bytes of the memory that are resident, i.e. pages
+  // that were accessed or are cached pages of the mapped file. Untouched
+  // zero pages do not count. Returns {size} if the platform cannot tell.
+  size_t CommittedSize() const;
+
+  byte* start() const { return start_; }
+  byte* end() const { return start_ + size_; }
+  size_t size() const { return size_; }
+  size_t reserved_size() const { return reserved_size_; }
+
+ private:
+  WasmMemory(byte* start, size_t size, size_t reserved_size)
+      : start_(start), size_(size), reserved_size_(reserved_size) {}
+
+  byte* start_;
+  size_t size_;
+  size_t reserved_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(WasmMemory);
+};
+
+// Wraps {memory} into a non-neuterable external array buffer, which takes
+// ownership of it. Its committed size at this point, not the size of its
+// address range, is reported to the heap as external allocation. It is
+// released when the buffer and all buffers passed to
+// {RetainWrappedWasmMemory} for it are collected. With {shared}, the buffer
+// is a SharedArrayBuffer.
+Handle<JSArrayBuffer> WrapWasmMemory(Isolate* isolate, WasmMemory* memory,
+                                     bool shared = false);
+
+// Returns the memory wrapped by {WrapWasmMemory} whose array buffer has
+// {backing_store}, or {nullptr} if the backing store was allocated
+// elsewhere, e.g. by the embedder's array buffer allocator.
+WasmMemory* FindWrappedWasmMemory(const void* backing_store);
+
+// Makes {buffer} keep the memory wrapped by {WrapWasmMemory} at its backing
+// store alive until {buffer} is collected. Other isolates that receive a
+// SharedArrayBuffer over such a memory create their own external buffer
+// for it, which has to hold a reference like the original one. Returns
+// false if the backing store of {buffer} is not a wrapped memory.
+bool RetainWrappedWasmMemory(Isolate* isolate, Handle<JSArrayBuffer> buffer);
+
+// Wraps a fresh {WasmMemory} of {size} bytes, optionally backed by huge
+// pages and followed by {guard_size} bytes of committed guard, as by
+// {WrapWasmMemory}. Returns a null handle upon failure.
+Handle<JSArrayBuffer> NewWasmMemoryBuffer(Isolate* isolate, size_t size,
+                                          byte** backing_store,
+                                          bool huge_pages = false,
+                                          size_t guard_size = 0,
+                                          bool shared = false);
+}
+}
+}
+
+#endif  // V8_WASM_MEMORY_H_
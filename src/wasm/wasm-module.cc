@@ -3,7 +3,11 @@
 // found in the LICENSE file.
 
 #include "src/v8.h"
+#include "src/base/atomicops.h"
+#include "src/base/platform/elapsed-timer.h"
+#include "src/base/platform/platform.h"
 #include "src/macro-assembler.h"
+#include "src/heap/spaces.h"
 #include "src/objects.h"
 
 #include "src/simulator.h"
@@ -18,6 +22,8 @@
 #include "src/wasm/ast-decoder.h"
 #include "src/wasm/tf-builder.h"
 #include "src/wasm/module-decoder.h"
+#include "src/wasm/wasm-host.h"
+#include "src/wasm/wasm-memory.h"
 #include "src/wasm/wasm-module.h"
 #include "src/wasm/wasm-result.h"
 #include "src/wasm/wasm-wrapper.h"
@@ -26,10 +32,42 @@ namespace v8 {
 namespace internal {
 namespace wasm {
 
+namespace {
+// Allocates an empty vector whose header and backing store both live in
+// {zone}.
+template <typename T>
+ZoneVector<T>* NewZoneVector(Zone* zone) {
+  return new (zone->New(sizeof(ZoneVector<T>))) ZoneVector<T>(zone);
+}
+}  // namespace
+
+WasmModule::WasmModule()
+    : zone(new Zone()),
+      shared_isolate(nullptr),
+      module_start(nullptr),
+      module_end(nullptr),
+      min_mem_size_log2(0),
+      max_mem_size_log2(0),
+      mem_export(false),
+      mem_shared(false),
+      mem_external(false),
+      function_bodies_verified(false),
+      module_fd(-1),
+      globals(NewZoneVector<WasmGlobal>(zone)),
+      signatures(NewZoneVector<FunctionSig*>(zone)),
+      functions(NewZoneVector<WasmFunction>(zone)),
+      data_segments(NewZoneVector<WasmDataSegment>(zone)),
+      function_table(NewZoneVector<uint32_t>(zone)) {}
+
+WasmModule::~WasmModule() {
+  // The metadata vectors live in the zone and need no destruction.
+  delete zone;
+}
+
 std::ostream& operator<<(std::ostream& os, const WasmModule& module) {
   os << "WASM module with ";
-  os << (1 << module.min_mem_size_log2) << " min mem";
-  os << (1 << module.max_mem_size_log2) << " max mem";
+  os << (static_cast<uint64_t>(1) << module.min_mem_size_log2) << " min mem";
+  os << (static_cast<uint64_t>(1) << module.max_mem_size_log2) << " max mem";
   if (module.functions)
     os << module.functions->size() << " functions";
   if (module.globals)
@@ -102,9 +140,11 @@ class WasmLinker {
   }
 
   void Link(Handle<FixedArray> function_table,
-            std::vector<uint16_t>* functions) {
+            ZoneVector<uint32_t>* functions) {
     for (size_t i = 0; i < function_code_.size(); i++) {
-      LinkFunction(function_code_[i]);
+      // Functions that no native export reaches have no native code.
+      if (!function_code_[i].is_null())
+        LinkFunction(function_code_[i]);
     }
     if (functions && !function_table.is_null()) {
       int table_size = static_cast<int>(functions->size());
@@ -157,11 +197,14 @@ class WasmLinker {
 
 namespace {
 // Internal constants for the layout of the module object.
-const int kWasmModuleInternalFieldCount = 4;
+const int kWasmModuleInternalFieldCount = 7;
 const int kWasmModuleFunctionTable = 0;
 const int kWasmModuleCodeTable = 1;
 const int kWasmMemArrayBuffer = 2;
 const int kWasmGlobalsArrayBuffer = 3;
+const int kWasmNativeExports = 4;
+const int kWasmModuleBytes = 5;
+const int kWasmModuleFFI = 6;
 
 // Helper function to compile a single function.
 Handle<Code> CompileFunction(ErrorThrower& thrower,
@@ -242,7 +285,7 @@ Handle<Code> CompileFunction(ErrorThrower& thrower,
   return code;
 }
 
-size_t AllocateGlobalsOffsets(std::vector<WasmGlobal>* globals) {
+size_t AllocateGlobalsOffsets(ZoneVector<WasmGlobal>* globals) {
   uint32_t offset = 0;
   if (!globals)
     return 0;
@@ -255,16 +298,74 @@ size_t AllocateGlobalsOffsets(std::vector<WasmGlobal>* globals) {
   return offset;
 }
 
-void LoadDataSegments(WasmModule* module, byte* mem_addr, size_t mem_size) {
+// Copies {size} bytes from {source} to {dest}, which lies in zeroed memory,
+// skipping the pages of {dest} that would only receive zeros so that they
+// are never touched.
+void CopyToZeroedMemory(byte* dest, const byte* source, size_t size,
+                        size_t page_size) {
+  size_t offset = 0;
+  while (offset < size) {
+    uintptr_t addr = reinterpret_cast<uintptr_t>(dest + offset);
+    size_t chunk = Min(size - offset, RoundUp(addr + 1, page_size) - addr);
+    const byte* chunk_source = source + offset;
+    for (size_t i = 0; i < chunk; i++) {
+      if (chunk_source[i] != 0) {
+        memcpy(dest + offset, chunk_source, chunk);
+        break;
+      }
+    }
+    offset += chunk;
+  }
+}
+
+// Copies initialized data segments into memory, reading directly from the
+// module bytes (which may be a read-only mapping of the module file). If
+// {own_memory} is set, {mem_addr} starts a {WasmMemory} of our own which is
+// zero outside of the data segments. Then segments that do not overlap an
+// earlier segment skip pages that would only receive zeros. If the module
+// bytes are also backed by a file, the whole pages of a segment whose
+// source and destination agree modulo the page size are mapped
+// copy-on-write from the file instead. They are then only read in when
+// touched and are shared between instances.
+void LoadDataSegments(WasmModule* module, byte* mem_addr, size_t mem_size,
+                      bool own_memory) {
+  size_t page_size = static_cast<size_t>(base::OS::CommitPageSize());
+  size_t module_size =
+      static_cast<size_t>(module->module_end - module->module_start);
+  size_t written_end = 0;  // end of the memory written by earlier segments.
   for (const WasmDataSegment& segment : *module->data_segments) {
     if (!segment.init)
       continue;
     CHECK_LT(segment.dest_addr, mem_size);
     CHECK_LE(segment.source_size, mem_size);
-    CHECK_LE(segment.dest_addr + segment.source_size, mem_size);
+    CHECK_LE(static_cast<size_t>(segment.dest_addr) + segment.source_size,
+             mem_size);
     byte* addr = mem_addr + segment.dest_addr;
-    memcpy(addr, module->module_start + segment.source_offset,
-           segment.source_size);
+    const byte* source = module->module_start + segment.source_offset;
+    size_t size = segment.source_size;
+    bool zeroed = own_memory && segment.dest_addr >= written_end;
+    written_end = Max(written_end, segment.dest_addr + size);
+    if (own_memory && module->module_fd >= 0 &&
+        segment.source_offset <= module_size &&
+        size <= module_size - segment.source_offset &&
+        (segment.dest_addr - segment.source_offset) % page_size == 0) {
+      size_t head = RoundUp(segment.dest_addr, page_size) - segment.dest_addr;
+      size_t pages = head < size ? RoundDown(size - head, page_size) : 0;
+      if (pages > 0 &&
+          WasmMemory::MapCopyOnWriteAt(addr + head, pages, module->module_fd,
+                                       segment.source_offset + head)) {
+        // Only the partial pages at either end are copied.
+        memcpy(addr, source, head);
+        memcpy(addr + head + pages, source + head + pages,
+               size - head - pages);
+        continue;
+      }
+    }
+    if (zeroed) {
+      CopyToZeroedMemory(addr, source, size, page_size);
+    } else {
+      memcpy(addr, source, size);
+    }
   }
 }
 
@@ -277,42 +378,193 @@ Handle<FixedArray> BuildFunctionTable(Isolate* isolate, WasmModule* module) {
   for (int i = 0; i < table_size; i++) {
     WasmFunction* function =
         &module->functions->at(module->function_table->at(i));
-    fixed->set(i, Smi::FromInt(function->sig_index));
+    fixed->set(i, Smi::FromInt(static_cast<int>(function->sig_index)));
   }
   return fixed;
 }
 
-Handle<JSArrayBuffer> NewArrayBuffer(Isolate* isolate,
-                                     int size,
-                                     byte** backing_store) {
-  void* memory = isolate->array_buffer_allocator()->Allocate(size);
-  if (!memory)
-    return Handle<JSArrayBuffer>::null();
-  *backing_store = reinterpret_cast<byte*>(memory);
+// Marks in {native} the functions that function {index} reaches through
+// direct calls, including itself. Returns false if one of them is an import
+// other than a host function in {host_imports} and may thus run
+// JavaScript, or makes indirect calls, which could reach any function in
+// the table.
+bool CollectNativeFunctions(Zone* zone, WasmModule* module, uint32_t index,
+                            const std::vector<bool>& host_imports,
+                            std::vector<bool>* native) {
+  std::vector<bool> reached(module->functions->size(), false);
+  ZoneVector<uint32_t> worklist(zone);
+  worklist.push_back(index);
+  reached[index] = true;
+  while (!worklist.empty()) {
+    uint32_t current = worklist.back();
+    const WasmFunction& func = module->functions->at(current);
+    worklist.pop_back();
+    if (func.external) {
+      if (!host_imports[current])
+        return false;
+      continue;
+    }
+    ZoneVector<uint32_t> callees(zone);
+    if (!CollectDirectCallees(module->module_start + func.code_start_offset,
+                              module->module_start + func.code_end_offset,
+                              &callees)) {
+      return false;
+    }
+    for (uint32_t callee : callees) {
+      if (!reached[callee]) {
+        reached[callee] = true;
+        worklist.push_back(callee);
+      }
+    }
+  }
+  for (size_t i = 0; i < reached.size(); i++) {
+    if (reached[i])
+      (*native)[i] = true;
+  }
+  return true;
+}
+
+// Layout of the deoptimization data of the JS wrappers of exports, which
+// lets other instances call the wrapped code directly. The marker tells it
+// apart from the data of other WASM code, e.g. the instance data of
+// functions.
+const int kWasmExportMarker = 0;
+const int kWasmExportCode = 1;
+const int kWasmExportSignature = 2;
+const int kWasmExportInstance = 3;
+const int kWasmExportDataSize = 4;
+const int kWasmExportMarkerValue = 0x3e5;
 
-#if DEBUG
-  // Double check the API allocator actually zero-initialized the memory.
-  for (uint32_t i = 0; i < size; i++) {
-    DCHECK_EQ(0, (*backing_store)[i]);
+// Returns the code of the export that {function} wraps if it can replace an
+// import of signature {sig}, or a null handle if {function} is not the
+// export of a module instance or expects a different signature. Instances
+// with native exports are only called through their JS wrappers, which
+// check that no native thread uses the instance.
+Handle<Code> GetDirectImport(Handle<JSFunction> function, FunctionSig* sig) {
+  Code* wrapper = function->code();
+  if (wrapper->kind() != Code::WASM_FUNCTION)
+    return Handle<Code>::null();
+  FixedArray* data = wrapper->deoptimization_data();
+  if (data->length() != kWasmExportDataSize ||
+      data->get(kWasmExportMarker) != Smi::FromInt(kWasmExportMarkerValue) ||
+      !SignatureMatches(ByteArray::cast(data->get(kWasmExportSignature)),
+                        sig)) {
+    return Handle<Code>::null();
   }
-#endif
+  Handle<JSObject> instance(JSObject::cast(data->get(kWasmExportInstance)));
+  if (!GetInstanceNativeExports(instance).is_null())
+    return Handle<Code>::null();
+  return Handle<Code>(Code::cast(data->get(kWasmExportCode)));
+}
 
-  Handle<JSArrayBuffer> buffer = isolate->factory()->NewJSArrayBuffer();
-  JSArrayBuffer::Setup(buffer, isolate, true, memory, size);
-  buffer->set_is_neuterable(false);
-  return buffer;
+// Compiles the exports that can run on native threads, together with their
+// callees, into code objects that record traps in the word at
+// {trap_offset} in the globals area instead of throwing. The word at
+// {busy_offset} is set while they run. Unless {js_exports}, this is the
+// only code of the functions, which is installed into {code_table}, and
+// every export must run natively. Returns the table described at
+// {GetInstanceNativeExports}, or a null handle upon failure.
+Handle<FixedArray> CompileNativeExports(ErrorThrower& thrower,
+                                        Isolate* isolate,
+                                        ModuleEnv* module_env,
+                                        size_t trap_offset,
+                                        size_t busy_offset,
+                                        const std::vector<bool>& host_imports,
+                                        bool js_exports,
+                                        Handle<FixedArray> code_table) {
+  WasmModule* module = module_env->module;
+  size_t count = module->functions->size();
+  Zone zone;
+  std::vector<bool> native(count, false);
+  std::vector<uint32_t> exports;
+  for (uint32_t i = 0; i < count; i++) {
+    const WasmFunction& func = module->functions->at(i);
+    if (!func.exported)
+      continue;
+    if (CollectNativeFunctions(&zone, module, i, host_imports, &native)) {
+      exports.push_back(i);
+    } else if (!js_exports) {
+      thrower.Error("Export #%u:%s reaches an import that is not a host "
+                    "function or makes indirect calls.",
+                    i, module->GetName(func.name_offset));
+      return Handle<FixedArray>::null();
+    }
+  }
+
+  Factory* factory = isolate->factory();
+  Handle<FixedArray> table = factory->NewFixedArray(
+      kNativeExportsStart +
+      kNativeExportEntrySize * static_cast<int>(exports.size()));
+  table->set(kNativeExportsTrapOffset,
+             Smi::FromInt(static_cast<int>(trap_offset)));
+  table->set(kNativeExportsBusyOffset,
+             Smi::FromInt(static_cast<int>(busy_offset)));
+  if (exports.empty())
+    return table;
+
+  // Native code must not touch the JS heap, so it has no context to throw
+  // from and no function table.
+  WasmLinker linker(isolate, count);
+  ModuleEnv native_env = *module_env;
+  native_env.linker = &linker;
+  native_env.function_table = Handle<FixedArray>::null();
+  native_env.context = Handle<Context>::null();
+  native_env.trap_address = module_env->globals_area + trap_offset;
+
+  // Background threads may still run the code while the main thread
+  // collects garbage, so its pages must never be compacted.
+  std::vector<Handle<Code>> code(count);
+  for (uint32_t i = 0; i < count; i++) {
+    if (!native[i])
+      continue;
+    if (host_imports[i]) {
+      // The wrappers of host functions do not touch the JS heap either.
+      code[i] = Handle<Code>(Code::cast(code_table->get(i)));
+    } else {
+      code[i] = CompileFunction(thrower, isolate, &native_env,
+                                module->functions->at(i), i);
+    }
+    if (code[i].is_null())
+      return Handle<FixedArray>::null();
+    MemoryChunk::FromAddress(code[i]->address())->MarkNeverEvacuate();
+    linker.Finish(i, code[i]);
+    if (!js_exports)
+      code_table->set(i, *code[i]);
+  }
+  linker.Link(Handle<FixedArray>::null(), nullptr);
+
+  for (size_t k = 0; k < exports.size(); k++) {
+    uint32_t index = exports[k];
+    const WasmFunction& func = module->functions->at(index);
+    Handle<String> name =
+        factory->InternalizeUtf8String(module->GetName(func.name_offset));
+    Handle<Code> entry =
+        CompileCToWasmWrapper(isolate, &native_env, code[index], index);
+    if (entry.is_null())
+      return Handle<FixedArray>::null();
+    MemoryChunk::FromAddress(entry->address())->MarkNeverEvacuate();
+
+    Handle<ByteArray> sig = EncodeSignature(factory, func.sig);
+    int pos = kNativeExportsStart +
+              kNativeExportEntrySize * static_cast<int>(k);
+    table->set(pos + kNativeExportName, *name);
+    table->set(pos + kNativeExportEntry, *entry);
+    table->set(pos + kNativeExportSignature, *sig);
+  }
+  return table;
 }
 
 }  // namespace
 
 // Instantiates a wasm module as a JSObject.
-//  * allocates a backing store of {mem_size} bytes.
+//  * allocates a zero-page backed store of {mem_size} bytes, followed by a
+//    guard if memory accesses are masked
 //  * installs a named property "memory" for that buffer if exported
 //  * installs named properties on the object for exported functions
 //  * compiles wasm code to machine code
-MaybeHandle<JSObject> WasmModule::Instantiate(Isolate* isolate,
-                                              Handle<JSObject> ffi,
-                                              Handle<JSArrayBuffer> memory) {
+MaybeHandle<JSObject> WasmModule::Instantiate(
+    Isolate* isolate, Handle<JSObject> ffi, Handle<JSArrayBuffer> memory,
+    const WasmInstanceOptions& options, WasmInstantiateStats* stats) {
   this->shared_isolate = isolate;  // TODO: have a real shared isolate.
   ErrorThrower thrower(isolate, "WasmModule::Instantiate()");
 
@@ -322,6 +574,17 @@ MaybeHandle<JSObject> WasmModule::Instantiate(Isolate* isolate,
     thrower.Error("Out of memory: wasm memory too large");
     return MaybeHandle<JSObject>();
   }
+  if (mem_shared && !FLAG_harmony_sharedarraybuffer) {
+    thrower.Error("Shared memory requires --harmony-sharedarraybuffer");
+    return MaybeHandle<JSObject>();
+  }
+  // Masking relies on a power-of-two memory followed by a guard, which only
+  // memory allocated here is known to have.
+  if (options.mem_masked && !memory.is_null()) {
+    thrower.Error("Masked memory accesses require memory allocated by the "
+                  "instance, not external memory");
+    return MaybeHandle<JSObject>();
+  }
 
   Handle<Map> map = factory->NewMap(
       JS_OBJECT_TYPE,
@@ -333,20 +596,42 @@ MaybeHandle<JSObject> WasmModule::Instantiate(Isolate* isolate,
   Handle<JSObject> module = factory->NewJSObjectFromMap(map, TENURED);
   Handle<FixedArray> code_table =
       factory->NewFixedArray(static_cast<int>(functions->size()), TENURED);
+  Handle<FixedArray> instance_data = factory->NewFixedArray(1, TENURED);
+  instance_data->set(0, *module);
+
+  // The instance keeps the module bytes and the FFI object, so that it can
+  // be captured or saved without its caller holding on to them.
+  int module_size = static_cast<int>(module_end - module_start);
+  Handle<ByteArray> module_bytes = factory->NewByteArray(module_size, TENURED);
+  memcpy(module_bytes->GetDataStartAddress(), module_start, module_size);
+  module->SetInternalField(kWasmModuleBytes, *module_bytes);
+  if (ffi.is_null()) {
+    module->SetInternalField(kWasmModuleFFI, Smi::FromInt(0));
+  } else {
+    module->SetInternalField(kWasmModuleFFI, *ffi);
+  }
 
   //-------------------------------------------------------------------------
   // Allocate the linear memory.
   //-------------------------------------------------------------------------
-  uint32_t mem_size = 1 << min_mem_size_log2;
+  size_t mem_size = static_cast<size_t>(1) << min_mem_size_log2;
   byte* mem_addr = nullptr;
   Handle<JSArrayBuffer> mem_buffer;
   if (!memory.is_null()) {
     memory->set_is_neuterable(false);
+    // A shared memory passed to another isolate arrives as a new external
+    // buffer there; it keeps the memory alive until every isolate that
+    // instantiated with it has collected its buffer.
+    if (memory->is_shared())
+      RetainWrappedWasmMemory(isolate, memory);
     mem_addr = reinterpret_cast<byte*>(memory->backing_store());
-    mem_size = memory->byte_length()->Number();
+    mem_size = static_cast<size_t>(memory->byte_length()->Number());
     mem_buffer = memory;
   } else {
-    mem_buffer = NewArrayBuffer(isolate, mem_size, &mem_addr);
+    mem_buffer =
+        NewWasmMemoryBuffer(isolate, mem_size, &mem_addr,
+                            options.mem_huge_pages,
+                            options.mem_masked ? kMemGuardSize : 0, mem_shared);
     if (!mem_addr) {
       // Not enough space for backing store of memory
       thrower.Error("Out of memory: wasm memory");
@@ -355,7 +640,8 @@ MaybeHandle<JSObject> WasmModule::Instantiate(Isolate* isolate,
   }
 
   // Load initialized data segments.
-  LoadDataSegments(this, mem_addr, mem_size);
+  if (options.load_data_segments)
+    LoadDataSegments(this, mem_addr, mem_size, memory.is_null());
 
   module->SetInternalField(kWasmMemArrayBuffer, *mem_buffer);
 
@@ -369,10 +655,19 @@ MaybeHandle<JSObject> WasmModule::Instantiate(Isolate* isolate,
   // Allocate the globals area if necessary.
   //-------------------------------------------------------------------------
   size_t globals_size = AllocateGlobalsOffsets(globals);
+  size_t trap_offset = 0;
+  size_t busy_offset = 0;
+  if (options.parallel_exports) {
+    // Native threads record traps in a word after the globals, followed by
+    // the word that keeps JS off the instance while they run.
+    trap_offset = RoundUp(globals_size, kInt32Size);
+    busy_offset = trap_offset + kInt32Size;
+    globals_size = busy_offset + kInt32Size;
+  }
   byte* globals_addr = nullptr;
   if (globals_size > 0) {
     Handle<JSArrayBuffer> globals_buffer =
-        NewArrayBuffer(isolate, mem_size, &globals_addr);
+        NewWasmMemoryBuffer(isolate, globals_size, &globals_addr);
     if (!globals_addr) {
       // Not enough space for backing store of globals.
       thrower.Error("Out of memory: wasm globals");
@@ -387,8 +682,11 @@ MaybeHandle<JSObject> WasmModule::Instantiate(Isolate* isolate,
   //-------------------------------------------------------------------------
   // Compile all functions in the module.
   //-------------------------------------------------------------------------
+  base::ElapsedTimer compile_timer;
+  compile_timer.Start();
   int index = 0;
   WasmLinker linker(isolate, functions->size());
+  std::vector<bool> host_imports(functions->size(), false);
   ModuleEnv module_env;
   module_env.module = this;
   module_env.mem_start = reinterpret_cast<uintptr_t>(mem_addr);
@@ -400,6 +698,12 @@ MaybeHandle<JSObject> WasmModule::Instantiate(Isolate* isolate,
   module_env.memory = memory;
   module_env.context = isolate->native_context();
   module_env.asm_js = false;
+  module_env.mem_masked = options.mem_masked;
+  if (options.parallel_exports)
+    module_env.busy_address = module_env.globals_area + busy_offset;
+  // Exports that only C++ calls need no JS wrappers, and their functions
+  // are only compiled once, for native threads.
+  bool native_only = options.parallel_exports && !options.js_exports;
 
   // First pass: compile each function and initialize the code table.
   for (const WasmFunction& func : *functions) {
@@ -416,10 +720,32 @@ MaybeHandle<JSObject> WasmModule::Instantiate(Isolate* isolate,
         MaybeHandle<Object> result = Object::GetProperty(ffi, name);
         if (!result.is_null()) {
           Handle<Object> obj = result.ToHandleChecked();
-          if (obj->IsJSFunction()) {
+          Address callback;
+          Handle<ByteArray> host_sig;
+          if (GetWasmHostFunction(obj, &callback, &host_sig)) {
+#if USE_SIMULATOR
+            thrower.Error("FFI function #%d:%s is native, which the "
+                          "simulator does not support.", index, cstr);
+            return MaybeHandle<JSObject>();
+#else
+            if (!SignatureMatches(*host_sig, func.sig)) {
+              thrower.Error("FFI function #%d:%s has a different signature.",
+                            index, cstr);
+              return MaybeHandle<JSObject>();
+            }
+            code = CompileWasmToCWrapper(isolate, &module_env, callback,
+                                         index);
+            host_imports[index] = true;
+#endif
+          } else if (obj->IsJSFunction()) {
             function = Handle<JSFunction>::cast(obj);
-            code =
-                CompileWasmToJSWrapper(isolate, &module_env, function, index);
+            // Exports of other instances are called without converting the
+            // arguments and the result to JS and back.
+            code = GetDirectImport(function, func.sig);
+            if (code.is_null()) {
+              code = CompileWasmToJSWrapper(isolate, &module_env, function,
+                                            index);
+            }
           } else {
             thrower.Error("FFI function #%d:%s is not a JSFunction.", index,
                           cstr);
@@ -433,7 +759,7 @@ MaybeHandle<JSObject> WasmModule::Instantiate(Isolate* isolate,
         thrower.Error("FFI table is not an object.");
         return MaybeHandle<JSObject>();
       }
-    } else {
+    } else if (!native_only) {
       // Compile the function.
       code = CompileFunction(thrower, isolate, &module_env, func, index);
       if (code.is_null()) {
@@ -443,6 +769,20 @@ MaybeHandle<JSObject> WasmModule::Instantiate(Isolate* isolate,
       if (func.exported) {
         function =
             CompileJSToWasmWrapper(isolate, &module_env, name, code, index);
+        Handle<FixedArray> export_data =
+            factory->NewFixedArray(kWasmExportDataSize, TENURED);
+        export_data->set(kWasmExportMarker,
+                         Smi::FromInt(kWasmExportMarkerValue));
+        export_data->set(kWasmExportCode, *code);
+        export_data->set(kWasmExportSignature,
+                         *EncodeSignature(factory, func.sig));
+        export_data->set(kWasmExportInstance, *module);
+        function->code()->set_deoptimization_data(*export_data);
+        // The code embeds the addresses of the memory and the globals, which
+        // are freed together with the instance. Rooting the instance from the
+        // code keeps it alive for as long as the export or any instance
+        // calling the code directly.
+        code->set_deoptimization_data(*instance_data);
       }
     }
     if (!code.is_null()) {
@@ -450,21 +790,207 @@ MaybeHandle<JSObject> WasmModule::Instantiate(Isolate* isolate,
       linker.Finish(index, code);
       code_table->set(index, *code);
     }
-    if (func.exported) {
+    if (func.exported && !function.is_null()) {
       // Exported functions are installed as read-only properties on the module.
       JSObject::AddProperty(module, name, function, READ_ONLY);
     }
     index++;
   }
 
-  // Second pass: patch all direct call sites.
-  linker.Link(module_env.function_table, this->function_table);
+  // Second pass: patch all direct call sites. Native code makes no indirect
+  // calls, so there is no function table without JS exports.
+  if (native_only) {
+    linker.Link(Handle<FixedArray>::null(), nullptr);
+  } else {
+    linker.Link(module_env.function_table, this->function_table);
+  }
 
   module->SetInternalField(kWasmModuleFunctionTable, Smi::FromInt(0));
   module->SetInternalField(kWasmModuleCodeTable, *code_table);
+
+  //-------------------------------------------------------------------------
+  // Compile exports for native threads if requested.
+  //-------------------------------------------------------------------------
+  if (options.parallel_exports) {
+    Handle<FixedArray> exports = CompileNativeExports(
+        thrower, isolate, &module_env, trap_offset, busy_offset, host_imports,
+        options.js_exports, code_table);
+    if (exports.is_null()) {
+      thrower.Error("Compilation of native exports failed.");
+      return MaybeHandle<JSObject>();
+    }
+    module->SetInternalField(kWasmNativeExports, *exports);
+  } else {
+    module->SetInternalField(kWasmNativeExports, Smi::FromInt(0));
+  }
+  if (stats != nullptr)
+    stats->compile_time_ms = compile_timer.Elapsed().InMillisecondsF();
   return module;
 }
 
+bool WasmModule::ResetInstance(ErrorThrower& thrower,
+                               Handle<JSObject> instance,
+                               const WasmInstanceOptions& options) {
+  if (IsInstanceBusy(instance)) {
+    thrower.Error("Instance is busy");
+    return false;
+  }
+  Handle<JSArrayBuffer> mem_buffer = GetInstanceMemory(instance);
+  byte* mem_addr = reinterpret_cast<byte*>(mem_buffer->backing_store());
+  size_t mem_size = static_cast<size_t>(mem_buffer->byte_length()->Number());
+  // Only pages dirtied since the last reset are backed by physical memory;
+  // dropping them is cheaper than clearing them. Masked stores may also have
+  // spilled into the guard.
+  WasmMemory::Discard(mem_addr,
+                      mem_size + (options.mem_masked ? kMemGuardSize : 0));
+  LoadDataSegments(this, mem_addr, mem_size, true);
+
+  Handle<JSArrayBuffer> globals_buffer = GetInstanceGlobals(instance);
+  if (!globals_buffer.is_null()) {
+    memset(globals_buffer->backing_store(), 0,
+           static_cast<size_t>(globals_buffer->byte_length()->Number()));
+  }
+  return true;
+}
+
+namespace {
+Handle<JSArrayBuffer> GetInstanceBuffer(Handle<JSObject> instance,
+                                        int index) {
+  if (instance->GetInternalFieldCount() != kWasmModuleInternalFieldCount)
+    return Handle<JSArrayBuffer>::null();
+  Object* buffer = instance->GetInternalField(index);
+  if (!buffer->IsJSArrayBuffer())
+    return Handle<JSArrayBuffer>::null();
+  return Handle<JSArrayBuffer>(JSArrayBuffer::cast(buffer));
+}
+}  // namespace
+
+Handle<JSArrayBuffer> GetInstanceMemory(Handle<JSObject> instance) {
+  return GetInstanceBuffer(instance, kWasmMemArrayBuffer);
+}
+
+Handle<JSArrayBuffer> GetInstanceGlobals(Handle<JSObject> instance) {
+  return GetInstanceBuffer(instance, kWasmGlobalsArrayBuffer);
+}
+
+Handle<FixedArray> GetInstanceCodeTable(Handle<JSObject> instance) {
+  if (instance->GetInternalFieldCount() != kWasmModuleInternalFieldCount)
+    return Handle<FixedArray>::null();
+  return Handle<FixedArray>(
+      FixedArray::cast(instance->GetInternalField(kWasmModuleCodeTable)));
+}
+
+Handle<ByteArray> GetInstanceModuleBytes(Handle<JSObject> instance) {
+  if (instance->GetInternalFieldCount() != kWasmModuleInternalFieldCount)
+    return Handle<ByteArray>::null();
+  return Handle<ByteArray>(
+      ByteArray::cast(instance->GetInternalField(kWasmModuleBytes)));
+}
+
+Handle<JSObject> GetInstanceFFI(Handle<JSObject> instance) {
+  if (instance->GetInternalFieldCount() != kWasmModuleInternalFieldCount)
+    return Handle<JSObject>::null();
+  Object* ffi = instance->GetInternalField(kWasmModuleFFI);
+  if (!ffi->IsJSObject())
+    return Handle<JSObject>::null();
+  return Handle<JSObject>(JSObject::cast(ffi));
+}
+
+Handle<FixedArray> GetInstanceNativeExports(Handle<JSObject> instance) {
+  if (instance->GetInternalFieldCount() != kWasmModuleInternalFieldCount)
+    return Handle<FixedArray>::null();
+  Object* exports = instance->GetInternalField(kWasmNativeExports);
+  if (!exports->IsFixedArray())
+    return Handle<FixedArray>::null();
+  return Handle<FixedArray>(FixedArray::cast(exports));
+}
+
+bool CanRunNatively(WasmModule* module, uint32_t index,
+                    const std::vector<bool>& host_imports) {
+  Zone zone;
+  std::vector<bool> native(module->functions->size(), false);
+  return CollectNativeFunctions(&zone, module, index, host_imports, &native);
+}
+
+namespace {
+base::Atomic32* GetInstanceBusyWord(Handle<JSObject> instance) {
+  Handle<FixedArray> exports = GetInstanceNativeExports(instance);
+  if (exports.is_null())
+    return nullptr;
+  int busy_offset = Smi::cast(exports->get(kNativeExportsBusyOffset))->value();
+  return reinterpret_cast<base::Atomic32*>(
+      reinterpret_cast<byte*>(GetInstanceGlobals(instance)->backing_store()) +
+      busy_offset);
+}
+}  // namespace
+
+bool IsInstanceBusy(Handle<JSObject> instance) {
+  base::Atomic32* busy = GetInstanceBusyWord(instance);
+  return busy != nullptr && base::NoBarrier_Load(busy) != 0;
+}
+
+void SetInstanceBusy(Handle<JSObject> instance, bool busy) {
+  base::NoBarrier_Store(GetInstanceBusyWord(instance), busy ? 1 : 0);
+}
+
+Handle<ByteArray> EncodeSignature(Factory* factory, FunctionSig* sig) {
+  int params = static_cast<int>(sig->parameter_count());
+  Handle<ByteArray> bytes = factory->NewByteArray(1 + params, TENURED);
+  bytes->set(0, sig->return_count() > 0 ? sig->GetReturn() : kAstStmt);
+  for (int i = 0; i < params; i++) {
+    bytes->set(1 + i, sig->GetParam(i));
+  }
+  return bytes;
+}
+
+bool SignatureMatches(ByteArray* bytes, FunctionSig* sig) {
+  int params = static_cast<int>(sig->parameter_count());
+  if (bytes->length() != 1 + params)
+    return false;
+  if (bytes->get(0) !=
+      (sig->return_count() > 0 ? sig->GetReturn() : kAstStmt)) {
+    return false;
+  }
+  for (int i = 0; i < params; i++) {
+    if (bytes->get(1 + i) != sig->GetParam(i))
+      return false;
+  }
+  return true;
+}
+
+bool DiscardInstanceMemory(ErrorThrower& thrower, Handle<JSObject> instance,
+                           size_t offset, size_t size) {
+  Handle<JSArrayBuffer> mem_buffer = GetInstanceMemory(instance);
+  if (mem_buffer.is_null()) {
+    thrower.Error("Not a WASM instance");
+    return false;
+  }
+  if (IsInstanceBusy(instance)) {
+    thrower.Error("Instance is busy");
+    return false;
+  }
+  byte* mem_addr = reinterpret_cast<byte*>(mem_buffer->backing_store());
+  size_t mem_size = static_cast<size_t>(mem_buffer->byte_length()->Number());
+  if (offset > mem_size || size > mem_size - offset) {
+    thrower.Error("Discarded memory range is out of bounds");
+    return false;
+  }
+  intptr_t page_size = base::OS::CommitPageSize();
+  if (!IsAligned(reinterpret_cast<intptr_t>(mem_addr + offset), page_size) ||
+      !IsAligned(size, page_size)) {
+    thrower.Error("Discarded memory range is not page-aligned");
+    return false;
+  }
+  if (FindWrappedWasmMemory(mem_addr) != nullptr) {
+    WasmMemory::Decommit(mem_addr + offset, size);
+  } else {
+    // Replacing the pages of a buffer from elsewhere could detach them from
+    // a shared or file mapping, or from the allocator's huge pages.
+    memset(mem_addr + offset, 0, size);
+  }
+  return true;
+}
+
 Handle<Code> ModuleEnv::GetFunctionCode(uint32_t index) {
   DCHECK(IsValidFunction(index));
   if (linker)
@@ -488,11 +1014,9 @@ int32_t CompileAndRunWasmModule(Isolate* isolate,
                                 const byte* module_end,
                                 bool asm_js) {
   HandleScope scope(isolate);
-  Zone zone;
-  // Decode the module, but don't verify function bodies, since we'll
-  // be compiling them anyway.
+  // Verify the bodies while decoding, so compilation can skip the checks.
   ModuleResult result =
-      DecodeWasmModule(isolate, &zone, module_start, module_end, false, false);
+      DecodeWasmModule(isolate, module_start, module_end, true, false);
   if (result.failed()) {
     // Module verification failed. throw.
     std::ostringstream str;
@@ -512,22 +1036,29 @@ int32_t CompileAndRunWasmModule(Isolate* isolate, WasmModule* module) {
   ErrorThrower thrower(isolate, "CompileAndRunWasmModule");
 
   // Allocate temporary linear memory and globals.
-  size_t mem_size = 1 << module->min_mem_size_log2;
+  if (module->min_mem_size_log2 > WasmModule::kMaxMemSize) {
+    thrower.Error("Out of memory: wasm memory too large");
+    return -1;
+  }
+  size_t mem_size = static_cast<size_t>(1) << module->min_mem_size_log2;
   size_t globals_size = AllocateGlobalsOffsets(module->globals);
 
-  base::SmartArrayPointer<byte> mem_addr(new byte[mem_size]);
-  base::SmartArrayPointer<byte> globals_addr(new byte[globals_size]);
-
-  memset(mem_addr.get(), 0, mem_size);
-  memset(globals_addr.get(), 0, globals_size);
+  base::SmartPointer<WasmMemory> memory(WasmMemory::Allocate(mem_size));
+  base::SmartPointer<WasmMemory> globals(WasmMemory::Allocate(globals_size));
+  if (memory.is_empty() || globals.is_empty()) {
+    thrower.Error("Out of memory: wasm memory");
+    return -1;
+  }
+  byte* mem_addr = memory->start();
+  byte* globals_addr = globals->start();
 
   // Create module environment.
   WasmLinker linker(isolate, module->functions->size());
   ModuleEnv module_env;
   module_env.module = module;
-  module_env.mem_start = reinterpret_cast<uintptr_t>(mem_addr.get());
-  module_env.mem_end = reinterpret_cast<uintptr_t>(mem_addr.get()) + mem_size;
-  module_env.globals_area = reinterpret_cast<uintptr_t>(globals_addr.get());
+  module_env.mem_start = reinterpret_cast<uintptr_t>(mem_addr);
+  module_env.mem_end = reinterpret_cast<uintptr_t>(mem_addr) + mem_size;
+  module_env.globals_area = reinterpret_cast<uintptr_t>(globals_addr);
   module_env.linker = &linker;
   module_env.function_code = nullptr;
   module_env.function_table = BuildFunctionTable(isolate, module);
@@ -535,7 +1066,7 @@ int32_t CompileAndRunWasmModule(Isolate* isolate, WasmModule* module) {
 
   // Load data segments.
   // TODO(titzer): throw instead of crashing if segments don't fit in memory?
-  LoadDataSegments(module, mem_addr.get(), mem_size);
+  LoadDataSegments(module, mem_addr, mem_size, true);
 
   // Compile all functions.
   Handle<Code> main_code = Handle<Code>::null();  // record last code.
@@ -10,6 +10,7 @@
 
 #include "src/api.h"
 #include "src/handles.h"
+#include "src/zone-containers.h"
 
 namespace v8 {
 namespace internal {
@@ -42,15 +43,23 @@ enum WasmFunctionDeclBit {
   kDeclFunctionExport = 0x08
 };
 
+enum WasmMemoryDeclBit {
+  kDeclMemoryExport = 0x01,
+  kDeclMemoryShared = 0x02
+};
+
 // Constants for fixed-size elements within a module.
 static const size_t kDeclMemorySize = 3;
 static const size_t kDeclGlobalSize = 6;
 static const size_t kDeclDataSegmentSize = 13;
+static const size_t kMinSignatureSize = 2;
+static const size_t kMinFunctionSize = 2;
+static const size_t kMinFunctionTableEntrySize = 1;
 
 // Static representation of a wasm function.
 struct WasmFunction {
   FunctionSig* sig;      // signature of the function.
-  uint16_t sig_index;    // index into the signature table.
+  uint32_t sig_index;    // index into the signature table.
   uint32_t name_offset;  // offset in the module bytes of the name, if any.
   uint32_t code_start_offset;    // offset in the module bytes of code start.
   uint32_t code_end_offset;      // offset in the module bytes of code end.
@@ -80,24 +89,52 @@ struct WasmDataSegment {
   bool init;               // true if loaded upon instantiation.
 };
 
+// Options that select how {WasmModule::Instantiate} sets up an instance.
+struct WasmInstanceOptions {
+  bool load_data_segments = true;  // false if the memory holds the state.
+  bool mem_huge_pages = false;     // true if memory should use huge pages.
+  bool mem_masked = false;         // true if memory accesses wrap around.
+  bool parallel_exports = false;   // true if exports can run natively.
+  bool js_exports = true;          // false if only C++ calls exports.
+};
+
+// Measurements of a {WasmModule::Instantiate} call.
+struct WasmInstantiateStats {
+  double compile_time_ms = 0;  // time spent compiling code and wrappers.
+};
+
 // Static representation of a module.
+// All metadata of the module (including signatures) is allocated in a
+// single zone owned by the module, so deleting the module frees it at once.
 struct WasmModule {
   static const uint8_t kMinMemSize = 12;  // Minimum memory size = 4kb
+#if V8_HOST_ARCH_64_BIT
+  static const uint8_t kMaxMemSize = 32;  // Maximum memory size = 4gb
+#else
   static const uint8_t kMaxMemSize = 30;  // Maximum memory size = 1gb
+#endif
+  static const size_t kMemGuardSize = 8;  // Guard past masked memory.
 
+  WasmModule();
+  ~WasmModule();
+
+  Zone* zone;                 // zone that owns the metadata of this module.
   Isolate* shared_isolate;    // isolate for storing shared code.
   const byte* module_start;   // starting address for the module bytes.
   const byte* module_end;     // end address for the module bytes.
   uint8_t min_mem_size_log2;  // minimum size of the memory (log base 2).
   uint8_t max_mem_size_log2;  // maximum size of the memory (log base 2).
   bool mem_export;            // true if the memory is exported.
+  bool mem_shared;            // true if the memory is shared.
   bool mem_external;          // true if the memory is external.
+  bool function_bodies_verified;  // true if the decoder verified all bodies.
+  int module_fd;              // file holding the module bytes, or -1.
 
-  std::vector<WasmGlobal>* globals;             // globals in this module.
-  std::vector<FunctionSig*>* signatures;        // signatures in this module.
-  std::vector<WasmFunction>* functions;         // functions in this module.
-  std::vector<WasmDataSegment>* data_segments;  // data segments in this module.
-  std::vector<uint16_t>* function_table;        // function table.
+  ZoneVector<WasmGlobal>* globals;             // globals in this module.
+  ZoneVector<FunctionSig*>* signatures;        // signatures in this module.
+  ZoneVector<WasmFunction>* functions;         // functions in this module.
+  ZoneVector<WasmDataSegment>* data_segments;  // data segments in this module.
+  ZoneVector<uint32_t>* function_table;        // function table.
 
   // Get a pointer to a string stored in the module bytes representing a name.
   const char* GetName(uint32_t offset) {
@@ -113,9 +150,25 @@ struct WasmModule {
     return start < size && end < size;
   }
 
-  // Creates a new instantiation of the module in the given isolate.
-  MaybeHandle<JSObject> Instantiate(Isolate* isolate, Handle<JSObject> ffi,
-                                    Handle<JSArrayBuffer> memory);
+  // Creates a new instantiation of the module in the given isolate. Data
+  // segments should not be loaded if {memory} already holds the instance
+  // state, e.g. when it is a copy of another instance's memory.
+  // Stores measurements into {stats} if not null.
+  MaybeHandle<JSObject> Instantiate(
+      Isolate* isolate, Handle<JSObject> ffi, Handle<JSArrayBuffer> memory,
+      const WasmInstanceOptions& options = WasmInstanceOptions(),
+      WasmInstantiateStats* stats = nullptr);
+
+  // Returns an instance created by {Instantiate} with {options} and without
+  // external memory to its initial state: memory is zeroed and the data
+  // segments are loaded again, and the globals are zeroed. Compiled code and
+  // exports are kept. Returns false and reports an error if {instance} is
+  // busy, see {IsInstanceBusy}.
+  bool ResetInstance(ErrorThrower& thrower, Handle<JSObject> instance,
+                     const WasmInstanceOptions& options);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(WasmModule);
 };
 
 // forward declaration.
@@ -128,17 +181,23 @@ struct ModuleEnv {
   uintptr_t mem_start;     // address of the start of linear memory.
   uintptr_t mem_end;       // address of the end of linear memory.
 
-  WasmModule* module;
+  WasmModule* module = nullptr;
   WasmLinker* linker;
   std::vector<Handle<Code>>* function_code;
   Handle<FixedArray> function_table;
   Handle<JSArrayBuffer> memory;
   Handle<Context> context;
-  bool asm_js;                // true if the module originated from asm.js.
+  bool asm_js;                 // true if the module originated from asm.js.
+  bool mem_masked = false;     // true if memory addresses wrap around.
+  uintptr_t trap_address = 0;  // word recording traps in native code, or 0.
+  uintptr_t busy_address = 0;  // word set while native threads run, or 0.
 
   bool IsValidGlobal(uint32_t index) {
     return module && index < module->globals->size();
   }
+  bool FunctionBodiesVerified() {
+    return module && module->function_bodies_verified;
+  }
   bool IsValidFunction(uint32_t index) {
     return module && index < module->functions->size();
   }
@@ -171,6 +230,75 @@ struct ModuleEnv {
 std::ostream& operator<<(std::ostream& os, const WasmModule& module);
 std::ostream& operator<<(std::ostream& os, const WasmFunction& function);
 
+// Returns the memory buffer of {instance}, or a null handle if {instance} is
+// not a module instance.
+Handle<JSArrayBuffer> GetInstanceMemory(Handle<JSObject> instance);
+
+// Returns the globals buffer of {instance}, or a null handle if the module
+// has no globals or {instance} is not a module instance.
+Handle<JSArrayBuffer> GetInstanceGlobals(Handle<JSObject> instance);
+
+// Returns the code of the functions of {instance} by function index, as
+// linked, or a null handle if {instance} is not a module instance.
+Handle<FixedArray> GetInstanceCodeTable(Handle<JSObject> instance);
+
+// Returns a copy of the bytes of the module {instance} was instantiated
+// from, or a null handle if {instance} is not a module instance.
+Handle<ByteArray> GetInstanceModuleBytes(Handle<JSObject> instance);
+
+// Returns the FFI object {instance} was linked against, or a null handle if
+// there was none or {instance} is not a module instance.
+Handle<JSObject> GetInstanceFFI(Handle<JSObject> instance);
+
+// Layout of the table of exports that can run on native threads. It starts
+// with the offsets of the words in the globals area that record traps and
+// that are nonzero while native threads use the instance, followed by the
+// name, C entry point and signature of each export, encoded by
+// {EncodeSignature}.
+const int kNativeExportsTrapOffset = 0;
+const int kNativeExportsBusyOffset = 1;
+const int kNativeExportsStart = 2;
+const int kNativeExportName = 0;
+const int kNativeExportEntry = 1;
+const int kNativeExportSignature = 2;
+const int kNativeExportEntrySize = 3;
+
+// Returns the table of exports of {instance} that can run on native threads,
+// or a null handle if the module was not instantiated with
+// {WasmInstanceOptions::parallel_exports} or {instance} is not a module
+// instance. Exports run on native threads if they reach neither indirect
+// calls nor imports other than host functions, see {NewWasmHostFunction}.
+Handle<FixedArray> GetInstanceNativeExports(Handle<JSObject> instance);
+
+// Returns true if function {index} of {module} can run on native threads,
+// i.e. neither it nor the functions it reaches through direct calls make
+// indirect calls or call imports other than those set in {host_imports}.
+bool CanRunNatively(WasmModule* module, uint32_t index,
+                    const std::vector<bool>& host_imports);
+
+// Returns true while a call started by {CallAsync} runs on a native thread
+// and uses the memory of {instance}. Exported functions of a busy instance
+// throw when called from JS.
+bool IsInstanceBusy(Handle<JSObject> instance);
+
+// Marks {instance}, which must have native exports, as busy or idle.
+void SetInstanceBusy(Handle<JSObject> instance, bool busy);
+
+// Encodes {sig} as a byte array of the return type, or {kAstStmt} if there
+// is none, followed by the parameter types.
+Handle<ByteArray> EncodeSignature(Factory* factory, FunctionSig* sig);
+
+// Returns true if {bytes} encodes {sig}.
+bool SignatureMatches(ByteArray* bytes, FunctionSig* sig);
+
+// Zeroes {size} bytes of the memory of {instance} at {offset} and, if the
+// instance allocated its memory itself, returns their physical pages to the
+// OS, e.g. for allocators that free large blocks. External memory is only
+// cleared. The range must be page-aligned and within the memory. Returns
+// false and reports an error otherwise.
+bool DiscardInstanceMemory(ErrorThrower& thrower, Handle<JSObject> instance,
+                           size_t offset, size_t size);
+
 typedef Result<WasmModule*> ModuleResult;
 typedef Result<WasmFunction*> FunctionResult;
 
@@ -85,28 +85,127 @@ FOREACH_SIGNATURE(DECLARE_SIG)
 
 #define DECLARE_SIG_ENTRY(name, ...) &kSig_##name,
 
-static const FunctionSig* kSimpleExprSigs[] = {
+const FunctionSig* const WasmOpcodes::kSigTable[] = {
     nullptr,
     FOREACH_SIGNATURE(DECLARE_SIG_ENTRY)};
 
-static byte kSimpleExprSigTable[256];
+// The functions below compute the entries of the opcode info table at
+// compile time. Each is a single (C++11 constexpr) expression over the
+// opcode lists, so the table needs no initialization at runtime.
+template <typename... Types>
+static constexpr byte CountTypes(Types...) {
+  return static_cast<byte>(sizeof...(Types));
+}
+
+#define DECLARE_SIG_ARITY(name, ...) \
+  static constexpr byte kArity_##name = CountTypes(__VA_ARGS__) - 1;
+
+FOREACH_SIGNATURE(DECLARE_SIG_ARITY)
+#undef DECLARE_SIG_ARITY
+
+#define IS_OPCODE(name, opc, sig) opcode == opc ||
+
+static constexpr WasmOpcodeClass OpcodeClassOf(int opcode) {
+  return (FOREACH_CONTROL_OPCODE(IS_OPCODE) false) ? kControlOpcodeClass
+       : (FOREACH_MISC_OPCODE(IS_OPCODE) false) ? kMiscOpcodeClass
+       : (FOREACH_SIMPLE_OPCODE(IS_OPCODE) false) ? kSimpleOpcodeClass
+       : (FOREACH_LOAD_MEM_OPCODE(IS_OPCODE) false) ? kLoadMemOpcodeClass
+       : (FOREACH_STORE_MEM_OPCODE(IS_OPCODE) false) ? kStoreMemOpcodeClass
+       : (FOREACH_MISC_MEM_OPCODE(IS_OPCODE) false) ? kMiscMemOpcodeClass
+       : (FOREACH_ATOMIC_MEM_OPCODE(IS_OPCODE) false) ? kAtomicMemOpcodeClass
+       : kInvalidOpcodeClass;
+}
+
+#undef IS_OPCODE
+
+#define SIG_INDEX(name, opc, sig) \
+  opcode == opc ? static_cast<byte>(kSigEnum_##sig + 1) :
+
+static constexpr byte SigIndexOf(int opcode) {
+  return FOREACH_SIMPLE_OPCODE(SIG_INDEX)
+         FOREACH_LOAD_MEM_OPCODE(SIG_INDEX)
+         FOREACH_STORE_MEM_OPCODE(SIG_INDEX)
+         FOREACH_MISC_MEM_OPCODE(SIG_INDEX)
+         FOREACH_ATOMIC_MEM_OPCODE(SIG_INDEX)
+         0;
+}
+
+#undef SIG_INDEX
 
-// Initialize the signature table.
-static void InitSigTable() {
-#define SET_SIG_TABLE(name, opcode, sig) \
-  kSimpleExprSigTable[opcode] = static_cast<int>(kSigEnum_##sig) + 1;
-  FOREACH_SIMPLE_OPCODE(SET_SIG_TABLE);
-#undef SET_SIG_TABLE
+static constexpr byte LengthOf(int opcode) {
+  return (opcode == kExprI8Const || opcode == kExprBlock ||
+          opcode == kExprLoop || opcode == kExprBr ||
+          opcode == kExprBrIf) ? 2
+       : (opcode == kExprI32Const || opcode == kExprF32Const) ? 5
+       : (opcode == kExprI64Const || opcode == kExprF64Const) ? 9
+       : (opcode == kExprTableSwitch || opcode == kExprGetLocal ||
+          opcode == kExprSetLocal || opcode == kExprLoadGlobal ||
+          opcode == kExprStoreGlobal || opcode == kExprCallFunction ||
+          opcode == kExprCallIndirect) ? WasmOpcodeInfo::kVariableLength
+       : (OpcodeClassOf(opcode) == kLoadMemOpcodeClass ||
+          OpcodeClassOf(opcode) == kStoreMemOpcodeClass ||
+          OpcodeClassOf(opcode) == kAtomicMemOpcodeClass) ? 2
+       : 1;
 }
 
-FunctionSig* WasmOpcodes::Signature(WasmOpcode opcode) {
-  // TODO(titzer): use LazyInstance to make this thread safe.
-  if (kSimpleExprSigTable[kExprI32Add] == 0)
-    InitSigTable();
-  return const_cast<FunctionSig*>(
-      kSimpleExprSigs[kSimpleExprSigTable[static_cast<byte>(opcode)]]);
+#define SIG_ARITY(name, opc, sig) opcode == opc ? kArity_##sig :
+
+static constexpr byte ArityOf(int opcode) {
+  return (opcode == kExprBlock || opcode == kExprLoop ||
+          opcode == kExprTableSwitch || opcode == kExprReturn ||
+          opcode == kExprCallFunction ||
+          opcode == kExprCallIndirect) ? WasmOpcodeInfo::kVariableArity
+       : (opcode == kExprBr || opcode == kExprSetLocal ||
+          opcode == kExprStoreGlobal) ? 1
+       : (opcode == kExprIf || opcode == kExprBrIf) ? 2
+       : (opcode == kExprIfThen || opcode == kExprSelect) ? 3
+       : FOREACH_SIMPLE_OPCODE(SIG_ARITY)
+         FOREACH_LOAD_MEM_OPCODE(SIG_ARITY)
+         FOREACH_STORE_MEM_OPCODE(SIG_ARITY)
+         FOREACH_MISC_MEM_OPCODE(SIG_ARITY)
+         FOREACH_ATOMIC_MEM_OPCODE(SIG_ARITY)
+         0;
 }
 
+#undef SIG_ARITY
+
+static constexpr byte MemTypeOf(int opcode) {
+  return (opcode == kExprI32LoadMem8S || opcode == kExprI64LoadMem8S ||
+          opcode == kExprI32StoreMem8 || opcode == kExprI64StoreMem8) ? kMemI8
+       : (opcode == kExprI32LoadMem8U || opcode == kExprI64LoadMem8U) ? kMemU8
+       : (opcode == kExprI32LoadMem16S || opcode == kExprI64LoadMem16S ||
+          opcode == kExprI32StoreMem16 ||
+          opcode == kExprI64StoreMem16) ? kMemI16
+       : (opcode == kExprI32LoadMem16U ||
+          opcode == kExprI64LoadMem16U) ? kMemU16
+       : (opcode == kExprI64LoadMem32U) ? kMemU32
+       : (opcode == kExprI64LoadMem || opcode == kExprI64StoreMem) ? kMemI64
+       : (opcode == kExprF32LoadMem || opcode == kExprF32StoreMem) ? kMemF32
+       : (opcode == kExprF64LoadMem || opcode == kExprF64StoreMem) ? kMemF64
+       : kMemI32;
+}
+
+#define OPCODE_INFO(b) \
+  { static_cast<byte>(OpcodeClassOf(b)), SigIndexOf(b), LengthOf(b), \
+    ArityOf(b), MemTypeOf(b) }
+#define OPCODE_INFO_4(b) \
+  OPCODE_INFO(b), OPCODE_INFO(b + 1), OPCODE_INFO(b + 2), OPCODE_INFO(b + 3)
+#define OPCODE_INFO_16(b)                                        \
+  OPCODE_INFO_4(b), OPCODE_INFO_4(b + 4), OPCODE_INFO_4(b + 8), \
+      OPCODE_INFO_4(b + 12)
+#define OPCODE_INFO_64(b)                                             \
+  OPCODE_INFO_16(b), OPCODE_INFO_16(b + 16), OPCODE_INFO_16(b + 32), \
+      OPCODE_INFO_16(b + 48)
+
+const WasmOpcodeInfo WasmOpcodes::kInfoTable[256] = {
+    OPCODE_INFO_64(0), OPCODE_INFO_64(64), OPCODE_INFO_64(128),
+    OPCODE_INFO_64(192)};
+
+#undef OPCODE_INFO_64
+#undef OPCODE_INFO_16
+#undef OPCODE_INFO_4
+#undef OPCODE_INFO
+
 // TODO(titzer): pull WASM_64 up to a common header.
 #if !V8_TARGET_ARCH_32_BIT || V8_TARGET_ARCH_X64
 #define WASM_64 1
@@ -56,6 +56,25 @@ struct MemoryAccess {
 
 typedef Signature<LocalType> FunctionSig;
 
+// The local type that represents values of the C type {T}, or {kAstStmt}
+// for void. Only defined for the C types of WASM values.
+template <typename T>
+inline LocalType LocalTypeForC();
+template <>
+inline LocalType LocalTypeForC<void>() { return kAstStmt; }
+template <>
+inline LocalType LocalTypeForC<int32_t>() { return kAstI32; }
+template <>
+inline LocalType LocalTypeForC<uint32_t>() { return kAstI32; }
+template <>
+inline LocalType LocalTypeForC<int64_t>() { return kAstI64; }
+template <>
+inline LocalType LocalTypeForC<uint64_t>() { return kAstI64; }
+template <>
+inline LocalType LocalTypeForC<float>() { return kAstF32; }
+template <>
+inline LocalType LocalTypeForC<double>() { return kAstF64; }
+
 // Control expressions and blocks.
 #define FOREACH_CONTROL_OPCODE(V) \
   V(Nop,         0x00, _)         \
@@ -114,6 +133,17 @@ typedef Signature<LocalType> FunctionSig;
   V(F32StoreMem,   0x35, f_if)           \
   V(F64StoreMem,   0x36, d_id)             
 
+// Atomic read-modify-write expressions on 32-bit memory words. They take a
+// memory access byte like loads and stores and return the old value.
+#define FOREACH_ATOMIC_MEM_OPCODE(V)      \
+  V(I32AtomicAdd,             0xb6, i_ii)  \
+  V(I32AtomicSub,             0xb7, i_ii)  \
+  V(I32AtomicAnd,             0xb8, i_ii)  \
+  V(I32AtomicIor,             0xb9, i_ii)  \
+  V(I32AtomicXor,             0xba, i_ii)  \
+  V(I32AtomicExchange,        0xbb, i_ii)  \
+  V(I32AtomicCompareExchange, 0xbc, i_iii)
+
 // Load memory expressions.
 #define FOREACH_MISC_MEM_OPCODE(V) \
   V(MemorySize, 0x3b, i_v)              \
@@ -248,11 +278,13 @@ typedef Signature<LocalType> FunctionSig;
   FOREACH_SIMPLE_OPCODE(V)    \
   FOREACH_STORE_MEM_OPCODE(V) \
   FOREACH_LOAD_MEM_OPCODE(V)  \
-  FOREACH_MISC_MEM_OPCODE(V)
+  FOREACH_MISC_MEM_OPCODE(V)  \
+  FOREACH_ATOMIC_MEM_OPCODE(V)
 
 // All signatures.
 #define FOREACH_SIGNATURE(V)         \
   V(i_ii, kAstI32, kAstI32, kAstI32) \
+  V(i_iii, kAstI32, kAstI32, kAstI32, kAstI32) \
   V(i_i, kAstI32, kAstI32)           \
   V(i_v, kAstI32)                    \
   V(i_ff, kAstI32, kAstF32, kAstF32) \
@@ -287,6 +319,31 @@ enum WasmOpcode {
 #undef DECLARE_NAMED_ENUM
 };
 
+// Classes of opcodes that are decoded the same way.
+enum WasmOpcodeClass {
+  kInvalidOpcodeClass = 0,  // not an opcode
+  kControlOpcodeClass,      // FOREACH_CONTROL_OPCODE
+  kMiscOpcodeClass,         // FOREACH_MISC_OPCODE
+  kSimpleOpcodeClass,       // FOREACH_SIMPLE_OPCODE
+  kLoadMemOpcodeClass,      // FOREACH_LOAD_MEM_OPCODE
+  kStoreMemOpcodeClass,     // FOREACH_STORE_MEM_OPCODE
+  kMiscMemOpcodeClass,      // FOREACH_MISC_MEM_OPCODE
+  kAtomicMemOpcodeClass     // FOREACH_ATOMIC_MEM_OPCODE
+};
+
+// Static properties of an opcode, computed at compile time from the
+// FOREACH_*_OPCODE lists and stored in a table indexed by the opcode byte.
+struct WasmOpcodeInfo {
+  byte opcode_class;  // a WasmOpcodeClass
+  byte sig_index;     // fixed signature, or 0 if the opcode has none
+  byte length;        // encoded length, or kVariableLength
+  byte arity;         // number of operands, or kVariableArity
+  byte mem_type;      // a MemType, for loads and stores only
+
+  static const byte kVariableLength = 0;
+  static const byte kVariableArity = 0xff;
+};
+
 // A collection of opcode-related static methods.
 class WasmOpcodes {
  public:
@@ -294,7 +351,26 @@ class WasmOpcodes {
   static const char* OpcodeName(WasmOpcode opcode);
   static const char* TypeName(LocalType type);
   static const char* TypeName(MemType type);
-  static FunctionSig* Signature(WasmOpcode opcode);
+
+  static const WasmOpcodeInfo& Info(byte opcode) { return kInfoTable[opcode]; }
+
+  static WasmOpcodeClass Class(byte opcode) {
+    return static_cast<WasmOpcodeClass>(kInfoTable[opcode].opcode_class);
+  }
+
+  // The signature of a simple expression, or nullptr for any other opcode.
+  static FunctionSig* Signature(WasmOpcode opcode) {
+    const WasmOpcodeInfo& info = Info(static_cast<byte>(opcode));
+    return info.opcode_class == kSimpleOpcodeClass
+               ? const_cast<FunctionSig*>(kSigTable[info.sig_index])
+               : nullptr;
+  }
+
+  // The signature of any opcode with fixed operand and result types,
+  // including memory accesses, or nullptr.
+  static FunctionSig* FixedSignature(const WasmOpcodeInfo& info) {
+    return const_cast<FunctionSig*>(kSigTable[info.sig_index]);
+  }
 
   static byte MemSize(MemType type) {
     switch (type) {
@@ -360,8 +436,11 @@ class WasmOpcodes {
     }
   }
 
-  static byte LoadStoreAccessOf(MemType type, bool with_offset = false) {
-    return MemoryAccess::OffsetField::encode(with_offset);
+  static byte LoadStoreAccessOf(
+      MemType type, bool with_offset = false,
+      MemoryAccess::Atomicity atomicity = MemoryAccess::kNone) {
+    return MemoryAccess::OffsetField::encode(with_offset) |
+           MemoryAccess::AtomicityField::encode(atomicity);
   }
 
   static char ShortNameOf(LocalType type) {
@@ -380,6 +459,10 @@ class WasmOpcodes {
         return 'x';
     }
   }
+
+ private:
+  static const WasmOpcodeInfo kInfoTable[256];
+  static const FunctionSig* const kSigTable[];
 };
 }
 }
@@ -0,0 +1,357 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "include/v8-platform.h"
+#include "src/v8.h"
+
+#include "src/api.h"
+#include "src/base/atomicops.h"
+#include "src/base/platform/semaphore.h"
+#include "src/conversions.h"
+
+#include "src/wasm/tf-builder.h"
+#include "src/wasm/wasm-module.h"
+#include "src/wasm/wasm-parallel.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+namespace {
+// The C entry point of an export compiled for native threads, see
+// {CompileCToWasmWrapper}.
+typedef int32_t (*NativeEntry)(byte* slots);
+
+// Finds the export {name} in the table of native exports and returns the
+// position of its entry, or -1 if it cannot run on native threads.
+int LookupNativeExport(Handle<FixedArray> exports, Handle<String> name) {
+  for (int pos = kNativeExportsStart; pos < exports->length();
+       pos += kNativeExportEntrySize) {
+    if (String::cast(exports->get(pos + kNativeExportName))->Equals(*name))
+      return pos;
+  }
+  return -1;
+}
+
+base::Atomic32* TrapWord(Handle<JSObject> instance,
+                         Handle<FixedArray> exports) {
+  Handle<JSArrayBuffer> globals = GetInstanceGlobals(instance);
+  int trap_offset = Smi::cast(exports->get(kNativeExportsTrapOffset))->value();
+  return reinterpret_cast<base::Atomic32*>(
+      reinterpret_cast<byte*>(globals->backing_store()) + trap_offset);
+}
+
+template <typename T>
+void WriteSlot(byte* slot, T value) {
+  memcpy(slot, &value, sizeof(value));
+}
+
+template <typename T>
+T ReadSlot(const byte* slot) {
+  T value;
+  memcpy(&value, slot, sizeof(value));
+  return value;
+}
+
+// The state of one {ParallelFor} call, shared by all threads running it.
+// Chunks are claimed in increasing order through {next_chunk}.
+struct ParallelJob {
+  NativeEntry entry;
+  int64_t begin;
+  int64_t end;
+  int64_t grain;
+  base::Atomic32 chunk_count;
+  base::Atomic32 next_chunk;
+  base::Atomic32* trap;  // nonzero once a chunk has trapped.
+  base::Semaphore done;  // signalled by each background task.
+
+  ParallelJob() : done(0) {}
+};
+
+void RunChunks(ParallelJob* job) {
+  byte slots[2 * TFBuilder::kSlotSize];
+  while (true) {
+    base::Atomic32 chunk =
+        base::NoBarrier_AtomicIncrement(&job->next_chunk, 1) - 1;
+    if (chunk >= job->chunk_count)
+      return;
+    // After a trap the result is discarded, so skip the remaining chunks.
+    if (base::NoBarrier_Load(job->trap) != 0)
+      return;
+    int64_t from = job->begin + chunk * job->grain;
+    int64_t to = std::min(from + job->grain, job->end);
+    WriteSlot(slots, static_cast<int32_t>(from));
+    WriteSlot(slots + TFBuilder::kSlotSize, static_cast<int32_t>(to));
+    job->entry(slots);
+  }
+}
+
+class ParallelForTask : public v8::Task {
+ public:
+  explicit ParallelForTask(ParallelJob* job) : job_(job) {}
+
+  void Run() override {
+    RunChunks(job_);
+    job_->done.Signal();
+  }
+
+ private:
+  ParallelJob* job_;
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelForTask);
+};
+
+// The state of one {CallAsync} call. It is created and deleted on the main
+// thread; the background thread only runs {entry} on {slots}.
+struct AsyncCall {
+  v8::Isolate* isolate;
+  v8::Global<v8::Context> context;
+  v8::Global<v8::Object> instance;  // keeps the memory and code alive.
+  v8::Global<v8::Promise::Resolver> resolver;
+  NativeEntry entry;
+  LocalType return_type;
+  base::Atomic32* trap;
+  std::vector<byte> slots;
+};
+
+// Converts the result of a call like {TFBuilder::ToJS}.
+Handle<Object> ResultToJS(Isolate* isolate, LocalType type,
+                          const byte* slot) {
+  Factory* factory = isolate->factory();
+  switch (type) {
+    case kAstI32:
+      return factory->NewNumberFromInt(ReadSlot<int32_t>(slot));
+    case kAstI64:
+      // Like {ToJS}, only the lower 32 bits are used.
+      return factory->NewNumberFromInt(
+          static_cast<int32_t>(ReadSlot<int64_t>(slot)));
+    case kAstF32:
+      return factory->NewNumber(ReadSlot<float>(slot));
+    case kAstF64:
+      return factory->NewNumber(ReadSlot<double>(slot));
+    case kAstStmt:
+      return factory->undefined_value();
+    case kAstEnd:
+      break;
+  }
+  UNREACHABLE();
+  return Handle<Object>::null();
+}
+
+// Settles the promise of a finished {AsyncCall} on the main thread and
+// releases the instance.
+class SettleTask : public v8::Task {
+ public:
+  explicit SettleTask(AsyncCall* call) : call_(call) {}
+
+  void Run() override {
+    v8::Isolate* v8_isolate = call_->isolate;
+    Isolate* isolate = reinterpret_cast<Isolate*>(v8_isolate);
+    v8::HandleScope scope(v8_isolate);
+    v8::Local<v8::Context> context = call_->context.Get(v8_isolate);
+    v8::Context::Scope context_scope(context);
+    v8::Local<v8::Promise::Resolver> resolver =
+        call_->resolver.Get(v8_isolate);
+
+    Handle<JSObject> instance = Handle<JSObject>::cast(
+        v8::Utils::OpenHandle(*call_->instance.Get(v8_isolate)));
+    SetInstanceBusy(instance, false);
+
+    // The platform's task queue orders the stores of the call before these
+    // loads.
+    base::Atomic32 reason = base::NoBarrier_Load(call_->trap);
+    if (reason != 0) {
+      base::NoBarrier_Store(call_->trap, 0);
+      Handle<String> message = isolate->factory()->NewStringFromAsciiChecked(
+          TrapMessage(reason - 1));
+      USE(resolver->Reject(context, v8::Utils::ToLocal(message)));
+    } else {
+      Handle<Object> result =
+          ResultToJS(isolate, call_->return_type, &call_->slots[0]);
+      USE(resolver->Resolve(context, v8::Utils::ToLocal(result)));
+    }
+    delete call_;
+  }
+
+ private:
+  AsyncCall* call_;
+
+  DISALLOW_COPY_AND_ASSIGN(SettleTask);
+};
+
+class AsyncCallTask : public v8::Task {
+ public:
+  explicit AsyncCallTask(AsyncCall* call) : call_(call) {}
+
+  void Run() override {
+    call_->entry(&call_->slots[0]);
+    V8::GetCurrentPlatform()->CallOnForegroundThread(call_->isolate,
+                                                     new SettleTask(call_));
+  }
+
+ private:
+  AsyncCall* call_;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncCallTask);
+};
+}  // namespace
+
+bool ParallelFor(ErrorThrower& thrower, Isolate* isolate,
+                 Handle<JSObject> instance, Handle<String> name,
+                 int32_t begin, int32_t end, int32_t grain) {
+  Handle<FixedArray> exports = GetInstanceNativeExports(instance);
+  if (exports.is_null()) {
+    thrower.Error("Not a WASM instance with parallel exports");
+    return false;
+  }
+  if (IsInstanceBusy(instance)) {
+    thrower.Error("Instance is busy");
+    return false;
+  }
+  if (begin > end || grain <= 0) {
+    thrower.Error("Invalid index range or grain");
+    return false;
+  }
+  int64_t chunk_count =
+      (static_cast<int64_t>(end) - begin + grain - 1) / grain;
+  if (chunk_count > kMaxInt / 2) {
+    // Leaves room for the threads claiming chunks past the last one.
+    thrower.Error("Too many chunks; use a larger grain");
+    return false;
+  }
+  int pos = LookupNativeExport(exports, name);
+  if (pos < 0) {
+    thrower.Error("Export cannot run on native threads");
+    return false;
+  }
+  ByteArray* sig = ByteArray::cast(exports->get(pos + kNativeExportSignature));
+  if (sig->length() != 3 || sig->get(1) != kAstI32 || sig->get(2) != kAstI32) {
+    thrower.Error("Export must take an (i32, i32) index range");
+    return false;
+  }
+#if USE_SIMULATOR
+  thrower.Error("Native threads are not supported by the simulator");
+  return false;
+#else
+  Code* code = Code::cast(exports->get(pos + kNativeExportEntry));
+  base::Atomic32* trap = TrapWord(instance, exports);
+
+  ParallelJob job;
+  job.entry = FUNCTION_CAST<NativeEntry>(code->entry());
+  job.begin = begin;
+  job.end = end;
+  job.grain = grain;
+  job.chunk_count = static_cast<base::Atomic32>(chunk_count);
+  job.next_chunk = 0;
+  job.trap = trap;
+  base::NoBarrier_Store(trap, 0);
+
+  // The calling thread takes part, so one chunk needs no background task.
+  // It also blocks until the tasks are done, so no GC can move the code or
+  // free the memory in the meantime.
+  int tasks = static_cast<int>(std::min<size_t>(
+      V8::GetCurrentPlatform()->NumberOfAvailableBackgroundThreads(),
+      job.chunk_count > 0 ? job.chunk_count - 1 : 0));
+  for (int i = 0; i < tasks; i++) {
+    V8::GetCurrentPlatform()->CallOnBackgroundThread(
+        new ParallelForTask(&job), v8::Platform::kLongRunningTask);
+  }
+  RunChunks(&job);
+  for (int i = 0; i < tasks; i++) {
+    job.done.Wait();
+  }
+
+  // The semaphore orders the stores of the tasks before these loads.
+  base::Atomic32 reason = base::NoBarrier_Load(trap);
+  if (reason != 0) {
+    base::NoBarrier_Store(trap, 0);
+    Handle<String> message =
+        isolate->factory()->NewStringFromAsciiChecked(TrapMessage(reason - 1));
+    isolate->Throw(*message);
+    return false;
+  }
+  return true;
+#endif
+}
+
+MaybeHandle<JSObject> CallAsync(ErrorThrower& thrower, Isolate* isolate,
+                                Handle<JSObject> instance,
+                                Handle<String> name,
+                                const std::vector<double>& args) {
+  Handle<FixedArray> exports = GetInstanceNativeExports(instance);
+  if (exports.is_null()) {
+    thrower.Error("Not a WASM instance with parallel exports");
+    return MaybeHandle<JSObject>();
+  }
+  if (IsInstanceBusy(instance)) {
+    thrower.Error("Instance is busy");
+    return MaybeHandle<JSObject>();
+  }
+  int pos = LookupNativeExport(exports, name);
+  if (pos < 0) {
+    thrower.Error("Export cannot run on native threads");
+    return MaybeHandle<JSObject>();
+  }
+#if USE_SIMULATOR
+  thrower.Error("Native threads are not supported by the simulator");
+  return MaybeHandle<JSObject>();
+#else
+  v8::Isolate* v8_isolate = reinterpret_cast<v8::Isolate*>(isolate);
+  v8::Local<v8::Context> context = v8_isolate->GetCurrentContext();
+  v8::Local<v8::Promise::Resolver> resolver;
+  if (!v8::Promise::Resolver::New(context).ToLocal(&resolver)) {
+    thrower.Error("Could not create a promise");
+    return MaybeHandle<JSObject>();
+  }
+
+  // Convert the arguments like {TFBuilder::FromJS}.
+  ByteArray* sig = ByteArray::cast(exports->get(pos + kNativeExportSignature));
+  int params = sig->length() - 1;
+  AsyncCall* call = new AsyncCall();
+  call->slots.resize(std::max(params, 1) * TFBuilder::kSlotSize);
+  for (int i = 0; i < params; i++) {
+    double arg = i < static_cast<int>(args.size())
+                     ? args[i]
+                     : std::numeric_limits<double>::quiet_NaN();
+    byte* slot = &call->slots[i * TFBuilder::kSlotSize];
+    switch (static_cast<LocalType>(sig->get(1 + i))) {
+      case kAstI32:
+        WriteSlot(slot, DoubleToInt32(arg));
+        break;
+      case kAstI64:
+        WriteSlot(slot, static_cast<int64_t>(DoubleToInt32(arg)));
+        break;
+      case kAstF32:
+        WriteSlot(slot, DoubleToFloat32(arg));
+        break;
+      case kAstF64:
+        WriteSlot(slot, arg);
+        break;
+      default:
+        UNREACHABLE();
+    }
+  }
+
+  Code* code = Code::cast(exports->get(pos + kNativeExportEntry));
+  call->isolate = v8_isolate;
+  call->context.Reset(v8_isolate, context);
+  call->instance.Reset(v8_isolate, v8::Utils::ToLocal(instance));
+  call->resolver.Reset(v8_isolate, resolver);
+  call->entry = FUNCTION_CAST<NativeEntry>(code->entry());
+  call->return_type = static_cast<LocalType>(sig->get(0));
+  call->trap = TrapWord(instance, exports);
+  base::NoBarrier_Store(call->trap, 0);
+
+  // The busy word keeps JS, other native calls and the functions that
+  // reset, snapshot or discard memory off the instance until the promise
+  // settles.
+  SetInstanceBusy(instance, true);
+  V8::GetCurrentPlatform()->CallOnBackgroundThread(
+      new AsyncCallTask(call), v8::Platform::kLongRunningTask);
+  return Handle<JSObject>::cast(v8::Utils::OpenHandle(*resolver->GetPromise()));
+#endif
+}
+}
+}
+}
@@ -0,0 +1,54 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef V8_WASM_PARALLEL_H_
+#define V8_WASM_PARALLEL_H_
+
+#include <vector>
+
+#include "src/handles.h"
+#include "src/wasm/wasm-result.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+// Runs the export {name} of {instance} over the index range [begin, end),
+// split into chunks of {grain} indices, by calling it as
+// {name}(chunk_begin, chunk_end) on the background threads of the platform
+// and on the calling thread, which waits for all chunks to finish. The
+// instance must have been created with
+// {WasmInstanceOptions::parallel_exports}, and the export must take two i32
+// parameters and not reach JS imports or indirect calls. Chunks may run in
+// any order and concurrently on the shared memory.
+// Returns false and reports an error or throws the trap message if the
+// export cannot run on native threads, {instance} is busy or a chunk
+// trapped; chunks that started before a trap run to completion.
+bool ParallelFor(ErrorThrower& thrower, Isolate* isolate,
+                 Handle<JSObject> instance, Handle<String> name,
+                 int32_t begin, int32_t end, int32_t grain);
+
+// Calls the export {name} of {instance} with {args} on a background thread
+// of the platform and returns a promise for its result. The arguments and
+// the result are converted like those of the exported JS function; missing
+// arguments are NaN. The instance must have been created with
+// {WasmInstanceOptions::parallel_exports}, and the export must not reach JS
+// imports or indirect calls. {instance} is busy until the promise settles,
+// which happens in a foreground task of the platform: it is resolved with
+// the result or rejected with the trap message. Returns a null handle and
+// reports an error if the call cannot be started.
+// The embedder must keep the isolate alive and pump its message loop until
+// the promise settles. The background thread runs code and uses memory
+// that the isolate frees when it is disposed, and the task that settles
+// the promise is only run by {v8::platform::PumpMessageLoop}; an isolate
+// disposed earlier leaks the call at best.
+MaybeHandle<JSObject> CallAsync(ErrorThrower& thrower, Isolate* isolate,
+                                Handle<JSObject> instance,
+                                Handle<String> name,
+                                const std::vector<double>& args);
+}
+}
+}
+
+#endif  // V8_WASM_PARALLEL_H_
@@ -0,0 +1,488 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "src/v8.h"
+
+#include "src/base/platform/platform.h"
+#include "src/global-handles.h"
+
+#include "src/wasm/module-decoder.h"
+#include "src/wasm/wasm-memory.h"
+#include "src/wasm/wasm-snapshot.h"
+
+#if V8_OS_POSIX
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if V8_OS_LINUX
+#include <sys/syscall.h>
+#endif
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+namespace {
+// Internal constants for the layout of the snapshot object.
+const int kWasmSnapshotInternalFieldCount = 2;
+const int kWasmSnapshotForeign = 0;
+const int kWasmSnapshotMarker = 1;
+const int kWasmSnapshotMarkerValue = 0x5a5e;
+
+bool IsZeroPage(const byte* start, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    if (start[i] != 0)
+      return false;
+  }
+  return true;
+}
+
+#if V8_OS_POSIX
+// Writes {size} bytes to {fd} at the file offset {offset}.
+bool WriteFully(int fd, const byte* data, size_t size, size_t offset) {
+  size_t written = 0;
+  while (written < size) {
+    ssize_t result = pwrite(fd, data + written, size - written,
+                            static_cast<off_t>(offset + written));
+    if (result <= 0)
+      return false;
+    written += static_cast<size_t>(result);
+  }
+  return true;
+}
+
+// Writes the non-zero pages of the memory to {fd} at the file offset
+// {offset}, leaving holes that read as zero for the rest.
+bool WriteNonZeroPages(int fd, const byte* mem_addr, size_t mem_size,
+                       size_t offset) {
+  size_t page_size = static_cast<size_t>(base::OS::CommitPageSize());
+  for (size_t page = 0; page < mem_size; page += page_size) {
+    size_t size = Min(page_size, mem_size - page);
+    if (IsZeroPage(mem_addr + page, size))
+      continue;
+    if (!WriteFully(fd, mem_addr + page, size, offset + page))
+      return false;
+  }
+  return true;
+}
+#endif
+
+// Layout of the header of a saved instance state. It is followed by the
+// globals area, the function table entries and, at {mem_offset}, the memory
+// image. States are only restored on the machine that saved them, so the
+// header is in host byte order.
+struct WasmStateHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t module_size;    // size of the module bytes.
+  uint32_t module_hash;    // hash of the module bytes.
+  uint64_t mem_size;       // size of the memory image.
+  uint64_t mem_offset;     // file offset of the memory image.
+  uint32_t globals_size;   // size of the globals area.
+  uint32_t table_size;     // number of function table entries.
+};
+
+const uint32_t kWasmStateMagic = 0x54534157;  // "WAST"
+const uint32_t kWasmStateVersion = 1;
+// Keeps the memory image mappable with pages of up to 64kb.
+const size_t kWasmStateMemoryAlignment = 64 * KB;
+
+// FNV-1a hash, used to check that a state is restored with its own module.
+uint32_t HashModuleBytes(WasmModule* module) {
+  uint32_t hash = 2166136261u;
+  for (const byte* pc = module->module_start; pc < module->module_end; pc++) {
+    hash = (hash ^ *pc) * 16777619u;
+  }
+  return hash;
+}
+
+struct WasmSnapshotOwner {
+  Object** location;       // weak global handle to the snapshot object.
+  WasmSnapshot* snapshot;  // the snapshot owned by the object.
+};
+
+void DeleteWasmSnapshot(const v8::WeakCallbackInfo<void>& data) {
+  WasmSnapshotOwner* owner =
+      reinterpret_cast<WasmSnapshotOwner*>(data.GetParameter());
+  GlobalHandles::Destroy(owner->location);
+  delete owner->snapshot;
+  delete owner;
+}
+}  // namespace
+
+WasmSnapshot* WasmSnapshot::New(Isolate* isolate, ErrorThrower& thrower,
+                                Handle<JSObject> instance) {
+  Handle<JSArrayBuffer> mem_buffer = GetInstanceMemory(instance);
+  if (mem_buffer.is_null()) {
+    thrower.Error("Argument is not a WASM instance");
+    return nullptr;
+  }
+  if (IsInstanceBusy(instance)) {
+    // Native threads may be writing the memory.
+    thrower.Error("Instance is busy");
+    return nullptr;
+  }
+
+  // Forks are compiled from the module bytes, so the snapshot keeps its own
+  // copy of them outside of the heap.
+  Handle<ByteArray> instance_bytes = GetInstanceModuleBytes(instance);
+  size_t size = static_cast<size_t>(instance_bytes->length());
+  byte* module_bytes = new byte[size];
+  memcpy(module_bytes, instance_bytes->GetDataStartAddress(), size);
+
+  // Every fork compiles the bodies, which skips the checks once they are
+  // verified here.
+  ModuleResult result = DecodeWasmModule(isolate, module_bytes,
+                                         module_bytes + size, true, false);
+  if (result.failed()) {
+    thrower.Failed("", result);
+    if (result.val)
+      delete result.val;
+    delete[] module_bytes;
+    return nullptr;
+  }
+  base::SmartPointer<WasmSnapshot> snapshot(
+      new WasmSnapshot(isolate, module_bytes, result.val,
+                       GetInstanceFFI(instance)));
+
+  const byte* mem_addr =
+      reinterpret_cast<const byte*>(mem_buffer->backing_store());
+  size_t mem_size = static_cast<size_t>(mem_buffer->byte_length()->Number());
+  if (!snapshot->CaptureMemory(mem_addr, mem_size)) {
+    thrower.Error("Out of memory: wasm snapshot");
+    return nullptr;
+  }
+
+  Handle<JSArrayBuffer> globals_buffer = GetInstanceGlobals(instance);
+  if (!globals_buffer.is_null()) {
+    snapshot->globals_size_ =
+        static_cast<size_t>(globals_buffer->byte_length()->Number());
+    snapshot->globals_image_.Reset(new byte[snapshot->globals_size_]);
+    memcpy(snapshot->globals_image_.get(), globals_buffer->backing_store(),
+           snapshot->globals_size_);
+  }
+  return snapshot.Detach();
+}
+
+WasmSnapshot::WasmSnapshot(Isolate* isolate, byte* module_bytes,
+                           WasmModule* module, Handle<JSObject> ffi)
+    : isolate_(isolate),
+      module_bytes_(module_bytes),
+      module_(module),
+      ffi_(nullptr),
+      fd_(-1),
+      mem_size_(0),
+      globals_size_(0) {
+  if (!ffi.is_null())
+    ffi_ = isolate->global_handles()->Create(*ffi).location();
+}
+
+WasmSnapshot::~WasmSnapshot() {
+#if V8_OS_POSIX
+  if (fd_ >= 0)
+    close(fd_);
+#endif
+  if (ffi_ != nullptr)
+    GlobalHandles::Destroy(ffi_);
+}
+
+bool WasmSnapshot::CaptureMemory(const byte* mem_addr, size_t mem_size) {
+  mem_size_ = mem_size;
+#if V8_OS_LINUX && defined(__NR_memfd_create)
+  // Older kernels lack memfd_create; they get the copying fallback.
+  int fd = static_cast<int>(syscall(__NR_memfd_create, "wasm-snapshot", 0));
+  if (fd >= 0) {
+    size_t page_size = static_cast<size_t>(base::OS::CommitPageSize());
+    off_t file_size = static_cast<off_t>(RoundUp(mem_size, page_size));
+    if (ftruncate(fd, file_size) == 0 &&
+        WriteNonZeroPages(fd, mem_addr, mem_size, 0)) {
+      fd_ = fd;
+      return true;
+    }
+    close(fd);
+  }
+#endif
+  byte* image = new (std::nothrow) byte[mem_size];
+  if (image == nullptr)
+    return false;
+  memcpy(image, mem_addr, mem_size);
+  mem_image_.Reset(image);
+  return true;
+}
+
+MaybeHandle<JSObject> WasmSnapshot::Fork() {
+  WasmMemory* memory = is_copy_on_write()
+                           ? WasmMemory::MapCopyOnWrite(fd_, mem_size_)
+                           : WasmMemory::Allocate(mem_size_);
+  if (memory == nullptr) {
+    ErrorThrower thrower(isolate_, "WasmSnapshot::Fork()");
+    thrower.Error("Out of memory: wasm memory");
+    return MaybeHandle<JSObject>();
+  }
+  if (!is_copy_on_write())
+    memcpy(memory->start(), mem_image_.get(), mem_size_);
+  Handle<JSArrayBuffer> mem_buffer = WrapWasmMemory(isolate_, memory);
+
+  Handle<JSObject> ffi;
+  if (ffi_ != nullptr)
+    ffi = Handle<JSObject>(JSObject::cast(*ffi_), isolate_);
+  WasmInstanceOptions options;
+  options.load_data_segments = false;
+  MaybeHandle<JSObject> result =
+      module_->Instantiate(isolate_, ffi, mem_buffer, options);
+
+  Handle<JSObject> instance;
+  if (result.ToHandle(&instance) && globals_size_ > 0) {
+    Handle<JSArrayBuffer> globals_buffer = GetInstanceGlobals(instance);
+    size_t size = static_cast<size_t>(globals_buffer->byte_length()->Number());
+    memcpy(globals_buffer->backing_store(), globals_image_.get(),
+           Min(size, globals_size_));
+  }
+  return result;
+}
+
+Handle<JSObject> WasmSnapshot::ToObject(Isolate* isolate,
+                                        WasmSnapshot* snapshot) {
+  Factory* factory = isolate->factory();
+  Handle<Map> map = factory->NewMap(
+      JS_OBJECT_TYPE,
+      JSObject::kHeaderSize + kWasmSnapshotInternalFieldCount * kPointerSize);
+  Handle<JSObject> object = factory->NewJSObjectFromMap(map);
+  object->SetInternalField(
+      kWasmSnapshotForeign,
+      *factory->NewForeign(reinterpret_cast<Address>(snapshot)));
+  object->SetInternalField(kWasmSnapshotMarker,
+                           Smi::FromInt(kWasmSnapshotMarkerValue));
+
+  // The snapshot, including its memfd, is released with the object.
+  WasmSnapshotOwner* owner = new WasmSnapshotOwner();
+  owner->location = isolate->global_handles()->Create(*object).location();
+  owner->snapshot = snapshot;
+  GlobalHandles::MakeWeak(owner->location, owner, &DeleteWasmSnapshot,
+                          v8::WeakCallbackType::kParameter);
+  return object;
+}
+
+WasmSnapshot* WasmSnapshot::FromObject(Handle<Object> object) {
+  if (!object->IsJSObject())
+    return nullptr;
+  Handle<JSObject> js_object = Handle<JSObject>::cast(object);
+  if (js_object->GetInternalFieldCount() != kWasmSnapshotInternalFieldCount ||
+      js_object->GetInternalField(kWasmSnapshotMarker) !=
+          Smi::FromInt(kWasmSnapshotMarkerValue)) {
+    return nullptr;
+  }
+  Foreign* foreign =
+      Foreign::cast(js_object->GetInternalField(kWasmSnapshotForeign));
+  return reinterpret_cast<WasmSnapshot*>(foreign->foreign_address());
+}
+
+#if V8_OS_POSIX
+bool SaveInstanceState(ErrorThrower& thrower, Handle<JSObject> instance,
+                       const char* path) {
+  Handle<JSArrayBuffer> mem_buffer = GetInstanceMemory(instance);
+  if (mem_buffer.is_null()) {
+    thrower.Error("Argument is not a WASM instance");
+    return false;
+  }
+  if (IsInstanceBusy(instance)) {
+    thrower.Error("Instance is busy");
+    return false;
+  }
+
+  // The state is tied to the module bytes the instance keeps. They are
+  // decoded from a copy outside of the heap, without verifying bodies.
+  Handle<ByteArray> instance_bytes = GetInstanceModuleBytes(instance);
+  size_t module_size = static_cast<size_t>(instance_bytes->length());
+  base::SmartArrayPointer<byte> module_bytes(new byte[module_size]);
+  memcpy(module_bytes.get(), instance_bytes->GetDataStartAddress(),
+         module_size);
+  ModuleResult result =
+      DecodeWasmModule(instance->GetIsolate(), module_bytes.get(),
+                       module_bytes.get() + module_size, false, false);
+  if (result.failed()) {
+    thrower.Failed("", result);
+    if (result.val)
+      delete result.val;
+    return false;
+  }
+  base::SmartPointer<WasmModule> module(result.val);
+
+  Handle<JSArrayBuffer> globals_buffer = GetInstanceGlobals(instance);
+  const byte* mem_addr =
+      reinterpret_cast<const byte*>(mem_buffer->backing_store());
+  size_t globals_size = 0;
+  const byte* globals_addr = nullptr;
+  if (!globals_buffer.is_null()) {
+    globals_size = static_cast<size_t>(globals_buffer->byte_length()->Number());
+    globals_addr =
+        reinterpret_cast<const byte*>(globals_buffer->backing_store());
+  }
+
+  WasmStateHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kWasmStateMagic;
+  header.version = kWasmStateVersion;
+  header.module_size =
+      static_cast<uint32_t>(module->module_end - module->module_start);
+  header.module_hash = HashModuleBytes(module.get());
+  header.mem_size = static_cast<uint64_t>(mem_buffer->byte_length()->Number());
+  header.globals_size = static_cast<uint32_t>(globals_size);
+  header.table_size = static_cast<uint32_t>(module->function_table->size());
+  size_t table_offset = sizeof(header) + globals_size;
+  size_t table_bytes = header.table_size * sizeof(uint32_t);
+  header.mem_offset =
+      RoundUp(table_offset + table_bytes, kWasmStateMemoryAlignment);
+
+  // The state is written to a temporary file in the same directory and
+  // renamed over {path} at the end. Instances restored from a previous state
+  // at {path} keep mapping its old contents, and a failed save leaves the
+  // previous state in place.
+  std::string temp_path(path);
+  temp_path += ".XXXXXX";
+  int fd = mkstemp(&temp_path[0]);
+  if (fd < 0) {
+    thrower.Error("Could not create state file %s", path);
+    return false;
+  }
+  size_t mem_size = static_cast<size_t>(header.mem_size);
+  size_t file_size = static_cast<size_t>(header.mem_offset) +
+                     RoundUp(mem_size, kWasmStateMemoryAlignment);
+  bool ok =
+      fchmod(fd, 0644) == 0 &&
+      ftruncate(fd, static_cast<off_t>(file_size)) == 0 &&
+      WriteFully(fd, reinterpret_cast<const byte*>(&header), sizeof(header),
+                 0) &&
+      WriteFully(fd, globals_addr, globals_size, sizeof(header)) &&
+      WriteFully(fd,
+                 reinterpret_cast<const byte*>(module->function_table->data()),
+                 table_bytes, table_offset) &&
+      WriteNonZeroPages(fd, mem_addr, mem_size,
+                        static_cast<size_t>(header.mem_offset));
+  ok = close(fd) == 0 && ok;
+  if (!ok || rename(temp_path.c_str(), path) != 0) {
+    unlink(temp_path.c_str());
+    thrower.Error("Could not write state file %s", path);
+    return false;
+  }
+  return true;
+}
+
+MaybeHandle<JSObject> RestoreInstanceState(Isolate* isolate,
+                                           ErrorThrower& thrower,
+                                           WasmModule* module,
+                                           Handle<JSObject> ffi,
+                                           const char* path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    thrower.Error("Could not open state file %s", path);
+    return MaybeHandle<JSObject>();
+  }
+
+  WasmStateHeader header;
+  struct stat file_stat;
+  size_t table_size = module->function_table->size();
+  bool valid =
+      fstat(fd, &file_stat) == 0 &&
+      pread(fd, &header, sizeof(header), 0) ==
+          static_cast<ssize_t>(sizeof(header)) &&
+      header.magic == kWasmStateMagic &&
+      header.version == kWasmStateVersion &&
+      header.module_size ==
+          static_cast<uint32_t>(module->module_end - module->module_start) &&
+      header.module_hash == HashModuleBytes(module) &&
+      header.table_size == table_size &&
+      header.mem_size <=
+          (static_cast<uint64_t>(1) << WasmModule::kMaxMemSize) &&
+      header.mem_offset % kWasmStateMemoryAlignment == 0 &&
+      sizeof(header) + header.globals_size + table_size * sizeof(uint32_t) <=
+          header.mem_offset;
+  if (!valid) {
+    close(fd);
+    thrower.Error("State file %s does not belong to this module", path);
+    return MaybeHandle<JSObject>();
+  }
+
+  // The function table binding must match the one of the module. The file
+  // must cover the whole memory image, since pages of the mapping beyond
+  // the end of a truncated file fault when accessed.
+  uint64_t file_size = static_cast<uint64_t>(file_stat.st_size);
+  base::SmartArrayPointer<byte> globals(new byte[header.globals_size]);
+  std::vector<uint32_t> table(table_size);
+  size_t table_bytes = table_size * sizeof(uint32_t);
+  valid = header.mem_offset <= file_size &&
+          header.mem_size <= file_size - header.mem_offset &&
+          pread(fd, globals.get(), header.globals_size, sizeof(header)) ==
+              static_cast<ssize_t>(header.globals_size) &&
+          pread(fd, table.data(), table_bytes,
+                sizeof(header) + header.globals_size) ==
+              static_cast<ssize_t>(table_bytes) &&
+          std::equal(table.begin(), table.end(),
+                     module->function_table->begin());
+  WasmMemory* memory = nullptr;
+  if (valid) {
+    // The mapping keeps its own reference to the file.
+    memory = WasmMemory::MapCopyOnWrite(
+        fd, static_cast<size_t>(header.mem_size),
+        static_cast<size_t>(header.mem_offset));
+  }
+  close(fd);
+  if (!valid) {
+    thrower.Error("State file %s is corrupt", path);
+    return MaybeHandle<JSObject>();
+  }
+  if (memory == nullptr) {
+    thrower.Error("Could not map state file %s", path);
+    return MaybeHandle<JSObject>();
+  }
+
+  Handle<JSArrayBuffer> mem_buffer = WrapWasmMemory(isolate, memory);
+  WasmInstanceOptions options;
+  options.load_data_segments = false;
+  MaybeHandle<JSObject> result =
+      module->Instantiate(isolate, ffi, mem_buffer, options);
+  Handle<JSObject> instance;
+  if (!result.ToHandle(&instance))
+    return result;
+
+  Handle<JSArrayBuffer> globals_buffer = GetInstanceGlobals(instance);
+  size_t globals_size =
+      globals_buffer.is_null()
+          ? 0
+          : static_cast<size_t>(globals_buffer->byte_length()->Number());
+  if (globals_size != header.globals_size) {
+    thrower.Error("State file %s does not belong to this module", path);
+    return MaybeHandle<JSObject>();
+  }
+  if (globals_size > 0)
+    memcpy(globals_buffer->backing_store(), globals.get(), globals_size);
+  return instance;
+}
+#else
+bool SaveInstanceState(ErrorThrower& thrower, Handle<JSObject> instance,
+                       const char* path) {
+  thrower.Error("Saving instance state is not supported on this platform");
+  return false;
+}
+
+MaybeHandle<JSObject> RestoreInstanceState(Isolate* isolate,
+                                           ErrorThrower& thrower,
+                                           WasmModule* module,
+                                           Handle<JSObject> ffi,
+                                           const char* path) {
+  thrower.Error("Restoring instance state is not supported on this platform");
+  return MaybeHandle<JSObject>();
+}
+#endif
+}
+}
+}
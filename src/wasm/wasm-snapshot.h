@@ -0,0 +1,86 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef V8_WASM_SNAPSHOT_H_
+#define V8_WASM_SNAPSHOT_H_
+
+#include "src/base/smart-pointers.h"
+#include "src/handles.h"
+#include "src/wasm/wasm-module.h"
+#include "src/wasm/wasm-result.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+// An image of the memory and globals of an instance, taken e.g. after an
+// expensive initialization, from which new instances can be forked. On Linux
+// the memory image lives in a sparse memfd and forked instances map it
+// copy-on-write, so they share all pages that none of them has written.
+// Elsewhere forks copy the image.
+class WasmSnapshot {
+ public:
+  // Captures the state of {instance}. The module bytes the instance keeps
+  // are copied and decoded again, and forks are linked against the FFI
+  // object of the instance. Returns {nullptr} and reports an error through
+  // {thrower} upon failure or if {instance} is busy, see {IsInstanceBusy}.
+  static WasmSnapshot* New(Isolate* isolate, ErrorThrower& thrower,
+                           Handle<JSObject> instance);
+  ~WasmSnapshot();
+
+  // Creates a new instance in the captured state. Its functions are
+  // compiled, but data segments are not loaded again.
+  MaybeHandle<JSObject> Fork();
+
+  // Wraps the snapshot into a JS object that owns it, and unwraps it again.
+  static Handle<JSObject> ToObject(Isolate* isolate, WasmSnapshot* snapshot);
+  static WasmSnapshot* FromObject(Handle<Object> object);
+
+  size_t mem_size() const { return mem_size_; }
+  size_t globals_size() const { return globals_size_; }
+  bool is_copy_on_write() const { return fd_ >= 0; }
+
+ private:
+  WasmSnapshot(Isolate* isolate, byte* module_bytes, WasmModule* module,
+               Handle<JSObject> ffi);
+
+  bool CaptureMemory(const byte* mem_addr, size_t mem_size);
+
+  Isolate* isolate_;
+  base::SmartArrayPointer<byte> module_bytes_;  // owned copy of the module.
+  base::SmartPointer<WasmModule> module_;
+  Object** ffi_;  // global handle to the FFI object, if any.
+  int fd_;        // memfd holding the memory image, or -1.
+  base::SmartArrayPointer<byte> mem_image_;  // memory image if no memfd.
+  size_t mem_size_;
+  base::SmartArrayPointer<byte> globals_image_;
+  size_t globals_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(WasmSnapshot);
+};
+
+// Writes the memory, globals and function table binding of {instance} to
+// the file at {path}, tied to the module bytes the instance keeps. Zero
+// pages of the memory are left as holes in the file. The file is replaced
+// by a rename, so instances restored from an earlier state at {path} keep
+// their contents. Returns false and reports an error through {thrower} upon
+// failure or if {instance} is busy.
+bool SaveInstanceState(ErrorThrower& thrower, Handle<JSObject> instance,
+                       const char* path);
+
+// Instantiates {module}, linked against {ffi}, in the state saved at {path}
+// by {SaveInstanceState}. The memory image is mapped copy-on-write from the
+// file and passed to {WasmModule::Instantiate} as external memory, so data
+// segments are not loaded again. Fails if the file was saved for another
+// module or is too short for the memory image.
+MaybeHandle<JSObject> RestoreInstanceState(Isolate* isolate,
+                                           ErrorThrower& thrower,
+                                           WasmModule* module,
+                                           Handle<JSObject> ffi,
+                                           const char* path);
+}
+}
+}
+
+#endif  // V8_WASM_SNAPSHOT_H_
@@ -193,6 +193,119 @@ Handle<Code> CompileWasmToJSWrapper(Isolate* isolate,
   }
   return code;
 }
+
+Handle<Code> CompileWasmToCWrapper(Isolate* isolate,
+                                   ModuleEnv* module,
+                                   Address callback,
+                                   uint32_t index) {
+  WasmFunction* func = &module->module->functions->at(index);
+
+  //----------------------------------------------------------------------------
+  // Create the TFGraph
+  //----------------------------------------------------------------------------
+  Zone zone;
+  compiler::Graph graph(&zone);
+  compiler::CommonOperatorBuilder common(&zone);
+  compiler::MachineOperatorBuilder machine(&zone);
+  compiler::JSGraph jsgraph(isolate, &graph, &common, nullptr, nullptr,
+                            &machine);
+
+  TFNode* control = nullptr;
+  TFNode* effect = nullptr;
+
+  TFBuilder builder(&zone, &jsgraph);
+  builder.control = &control;
+  builder.effect = &effect;
+  builder.module = module;
+  builder.BuildWasmToCWrapper(callback, func->sig);
+
+  //----------------------------------------------------------------------------
+  // Run the compilation pipeline.
+  //----------------------------------------------------------------------------
+  // The graph consists of machine operators only, so no lowering is needed.
+  compiler::CallDescriptor* incoming =
+      module->GetWasmCallDescriptor(&zone, func->sig);
+  CompilationInfo info("wasm-to-c", isolate, &zone);
+  info.set_output_code_kind(Code::WASM_FUNCTION);
+  Handle<Code> code = compiler::Pipeline::GenerateCodeForTesting(
+      &info, incoming, &graph, nullptr);
+
+#ifdef ENABLE_DISASSEMBLER
+  // Disassemble the wrapper code for debugging.
+  if (!code.is_null() && FLAG_print_opt_code) {
+    static const int kBufferSize = 128;
+    char buffer[kBufferSize];
+    const char* name = "";
+    if (func->name_offset > 0) {
+      const byte* ptr = module->module->module_start + func->name_offset;
+      name = reinterpret_cast<const char*>(ptr);
+    }
+    snprintf(buffer, kBufferSize, "WASM->C function wrapper #%d:%s", index,
+             name);
+    OFStream os(stdout);
+    code->Disassemble(buffer, os);
+  }
+#endif
+  return code;
+}
+
+Handle<Code> CompileCToWasmWrapper(Isolate* isolate,
+                                   ModuleEnv* module,
+                                   Handle<Code> wasm_code,
+                                   uint32_t index) {
+  WasmFunction* func = &module->module->functions->at(index);
+
+  //----------------------------------------------------------------------------
+  // Create the TFGraph
+  //----------------------------------------------------------------------------
+  Zone zone;
+  compiler::Graph graph(&zone);
+  compiler::CommonOperatorBuilder common(&zone);
+  compiler::MachineOperatorBuilder machine(&zone);
+  compiler::JSGraph jsgraph(isolate, &graph, &common, nullptr, nullptr,
+                            &machine);
+
+  TFNode* control = nullptr;
+  TFNode* effect = nullptr;
+
+  TFBuilder builder(&zone, &jsgraph);
+  builder.control = &control;
+  builder.effect = &effect;
+  builder.module = module;
+  builder.BuildCToWasmWrapper(wasm_code, func->sig);
+
+  //----------------------------------------------------------------------------
+  // Run the compilation pipeline.
+  //----------------------------------------------------------------------------
+  // The graph consists of machine operators only, so no lowering is needed.
+  compiler::MachineSignature::Builder sig_builder(&zone, 1, 1);
+  sig_builder.AddReturn(compiler::kMachInt32);
+  sig_builder.AddParam(compiler::kMachPtr);
+  compiler::CallDescriptor* incoming =
+      compiler::Linkage::GetSimplifiedCDescriptor(&zone, sig_builder.Build());
+  CompilationInfo info("c-to-wasm", isolate, &zone);
+  info.set_output_code_kind(Code::WASM_FUNCTION);
+  Handle<Code> code = compiler::Pipeline::GenerateCodeForTesting(
+      &info, incoming, &graph, nullptr);
+
+#ifdef ENABLE_DISASSEMBLER
+  // Disassemble the wrapper code for debugging.
+  if (!code.is_null() && FLAG_print_opt_code) {
+    static const int kBufferSize = 128;
+    char buffer[kBufferSize];
+    const char* name = "";
+    if (func->name_offset > 0) {
+      const byte* ptr = module->module->module_start + func->name_offset;
+      name = reinterpret_cast<const char*>(ptr);
+    }
+    snprintf(buffer, kBufferSize, "C->WASM function wrapper #%d:%s", index,
+             name);
+    OFStream os(stdout);
+    code->Disassemble(buffer, os);
+  }
+#endif
+  return code;
+}
 }
 }
 }
@@ -18,6 +18,14 @@ Handle<Code> CompileWasmToJSWrapper(Isolate* isolate,
                                     Handle<JSFunction> function,
                                     uint32_t index);
 
+// Wraps a native function, producing a code object that can be called from
+// WASM. {callback} is called with the C calling convention, receiving the
+// start and size of the linear memory followed by the WASM parameters.
+Handle<Code> CompileWasmToCWrapper(Isolate* isolate,
+                                   ModuleEnv* module,
+                                   Address callback,
+                                   uint32_t index);
+
 // Wraps a given wasm code object, producing a JSFunction that can be called
 // from JavaScript.
 Handle<JSFunction> CompileJSToWasmWrapper(Isolate* isolate,
@@ -25,6 +33,16 @@ Handle<JSFunction> CompileJSToWasmWrapper(Isolate* isolate,
                                           Handle<String> name,
                                           Handle<Code> wasm_code,
                                           uint32_t index);
+
+// Wraps a given wasm code object, producing a code object that native code
+// can call with the C calling convention as {int32_t entry(byte* slots)}.
+// The parameters are read from consecutive slots of
+// {TFBuilder::kSlotSize} bytes, and the result is stored into the first
+// slot. The wrapper itself returns 0.
+Handle<Code> CompileCToWasmWrapper(Isolate* isolate,
+                                   ModuleEnv* module,
+                                   Handle<Code> wasm_code,
+                                   uint32_t index);
 }
 }
 }
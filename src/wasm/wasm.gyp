@@ -21,18 +21,34 @@
           'encoder.h',
 	  'module-decoder.cc',
 	  'module-decoder.h',
+          'module-file.cc',
+          'module-file.h',
           'tf-builder.h',
           'tf-builder.cc',
+          'wasm-atomics.cc',
+          'wasm-atomics.h',
+          'wasm-compiled-module.cc',
+          'wasm-compiled-module.h',
+          'wasm-host.cc',
+          'wasm-host.h',
+          'wasm-instance-pool.cc',
+          'wasm-instance-pool.h',
           'wasm-js.cc',
           'wasm-js.h',
           'wasm-linkage.cc',
           'wasm-macro-gen.h',
+          'wasm-memory.cc',
+          'wasm-memory.h',
           'wasm-module.cc',
           'wasm-module.h',
           'wasm-opcodes.cc',
           'wasm-opcodes.h',
+          'wasm-parallel.cc',
+          'wasm-parallel.h',
           'wasm-result.cc',
           'wasm-result.h',
+          'wasm-snapshot.cc',
+          'wasm-snapshot.h',
           'wasm-wrapper.cc',
           'wasm-wrapper.h',
         ],
@@ -5,10 +5,28 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if V8_OS_POSIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if V8_OS_LINUX
+#include <sys/syscall.h>
+#endif
+
+#include "include/libplatform/libplatform.h"
+#include "src/base/platform/platform.h"
 #include "src/wasm/encoder.h"
+#include "src/wasm/module-decoder.h"
+#include "src/wasm/module-file.h"
+#include "src/wasm/wasm-compiled-module.h"
+#include "src/wasm/wasm-host.h"
+#include "src/wasm/wasm-instance-pool.h"
 #include "src/wasm/wasm-macro-gen.h"
 #include "src/wasm/wasm-module.h"
 #include "src/wasm/wasm-opcodes.h"
+#include "src/wasm/wasm-parallel.h"
+#include "src/wasm/wasm-snapshot.h"
 
 #include "test/cctest/cctest.h"
 
@@ -32,21 +50,23 @@ void TestModule(WasmModuleIndex* module, int32_t expected_result) {
 TEST(Run_WasmModule_CallAdd_rev) {
   static const byte data[] = {
       // sig#0 ------------------------------------------
-      kDeclSignatures, 2,
+      kDeclSignatures, 7,            // section size
+      2,
       0, kAstI32,                    // void -> int
       2, kAstI32, kAstI32, kAstI32,  // int,int -> int
       // func#0 (main) ----------------------------------
-      kDeclFunctions, 2,
+      kDeclFunctions, 18,            // section size
+      2,
       kDeclFunctionExport,
-      0, 0,                          // sig index
-      6, 0,                          // body size
+      0,                             // sig index
+      6,                             // body size
       kExprCallFunction, 1,          // --
       kExprI8Const, 77,              // --
       kExprI8Const, 22,              // --
       // func#1 -----------------------------------------
       0,                             // no name, not exported
-      1, 0,                          // sig index
-      5, 0,                          // body size
+      1,                             // sig index
+      5,                             // body size
       kExprI32Add,                   // --
       kExprGetLocal, 0,              // --
       kExprGetLocal, 1,              // --
@@ -142,6 +162,103 @@ TEST(Run_WasmModule_CheckMemoryIsZero) {
 }
 
 
+TEST(Run_WasmModule_MappedFile) {
+  static const byte kDataSegmentDest0 = 12;
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  uint16_t f_index = builder->AddFunction();
+  WasmFunctionBuilder* f = builder->FunctionAt(f_index);
+  f->ReturnType(kAstI32);
+  f->Exported(1);
+  byte code[] = {
+      WASM_LOAD_MEM(kMemI32, WASM_I8(kDataSegmentDest0))};
+  f->AddBody(code, sizeof(code));
+  byte data[] = {0x11, 0x22, 0x33, 0x44};
+  builder->AddDataSegment(
+      new(&zone) WasmDataSegmentEncoder(
+          &zone, data, sizeof(data), kDataSegmentDest0));
+  WasmModuleWriter* writer = builder->Build(&zone);
+  WasmModuleIndex* module = writer->WriteTo(&zone);
+
+  // Write the module to a temporary file.
+  FILE* temp = base::OS::OpenTemporaryFile();
+  CHECK_NOT_NULL(temp);
+  size_t size = static_cast<size_t>(module->End() - module->Begin());
+  CHECK_EQ(size, fwrite(module->Begin(), 1, size, temp));
+  fflush(temp);
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/self/fd/%d", fileno(temp));
+
+  // Decode and run directly from the mapping.
+  base::SmartPointer<ModuleFile> file(ModuleFile::Open(path));
+  CHECK(!file.is_empty());
+  CHECK_EQ(size, file->size());
+  CHECK_EQ(0, memcmp(module->Begin(), file->start(), size));
+  Isolate* isolate = CcTest::InitIsolateOnce();
+  int32_t result =
+      CompileAndRunWasmModule(isolate, file->start(), file->end());
+  CHECK_EQ(0x44332211, result);
+  fclose(temp);
+}
+
+
+TEST(Run_WasmModule_InstantiateModuleFile) {
+  static const byte data[] = {
+      kDeclMemory, 3,                // section size
+      16, 16, 0,                     // 64kb memory
+      kDeclSignatures, 3,            // section size
+      1,
+      0, kAstI32,                    // void -> int
+      kDeclFunctions, 12,            // section size
+      1,
+      kDeclFunctionName | kDeclFunctionExport,
+      0,                             // sig index
+      41, 0, 0, 0,                   // name offset
+      4,                             // body size
+      WASM_LOAD_MEM(kMemI32, WASM_I8(12)),
+      kDeclDataSegments, 14,         // section size
+      1,
+      12, 0, 0, 0,                   // dest addr
+      46, 0, 0, 0,                   // source offset
+      4, 0, 0, 0,                    // source size
+      1,                             // init
+      kDeclEnd,
+      'm', 'a', 'i', 'n', 0,
+      0x11, 0x22, 0x33, 0x44         // data segment bytes
+  };
+  FILE* temp = base::OS::OpenTemporaryFile();
+  CHECK_NOT_NULL(temp);
+  CHECK_EQ(arraysize(data), fwrite(data, 1, arraysize(data), temp));
+  fflush(temp);
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/self/fd/%d", fileno(temp));
+
+  Isolate* isolate = CcTest::InitIsolateOnce();
+  HandleScope scope(isolate);
+  Factory* factory = isolate->factory();
+  Handle<JSObject> instance =
+      InstantiateModuleFile(isolate, path, Handle<JSObject>::null(),
+                            Handle<JSArrayBuffer>::null())
+          .ToHandleChecked();
+  Handle<Object> main =
+      Object::GetProperty(instance, factory->InternalizeUtf8String("main"))
+          .ToHandleChecked();
+  Handle<Object> value =
+      Execution::Call(isolate, main, factory->undefined_value(), 0, nullptr)
+          .ToHandleChecked();
+  CHECK_EQ(0x44332211, value->Number());
+  fclose(temp);
+
+  // Files that cannot be mapped are reported as errors.
+  CHECK(InstantiateModuleFile(isolate, "/nonexistent/module.wasm",
+                              Handle<JSObject>::null(),
+                              Handle<JSArrayBuffer>::null())
+            .is_null());
+  CHECK(isolate->has_scheduled_exception());
+  isolate->clear_scheduled_exception();
+}
+
+
 TEST(Run_WasmModule_CallMain_recursive) {
   Zone zone;
   WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
@@ -191,3 +308,1093 @@ TEST(Run_WasmModule_Global) {
   WasmModuleWriter* writer = builder->Build(&zone);
   TestModule(writer->WriteTo(&zone), 97);
 }
+
+
+TEST(Run_WasmModule_InstancePool) {
+  static const byte data[] = {
+      kDeclMemory, 3,                // section size
+      12, 12, 1,                     // 4kb memory, exported
+      kDeclDataSegments, 14,         // section size
+      1,
+      12, 0, 0, 0,                   // dest addr
+      22, 0, 0, 0,                   // source offset
+      4, 0, 0, 0,                    // source size
+      1,                             // init
+      kDeclEnd,
+      0x11, 0x22, 0x33, 0x44         // data segment bytes
+  };
+  Isolate* isolate = CcTest::InitIsolateOnce();
+  HandleScope scope(isolate);
+  ErrorThrower thrower(isolate, "Run_WasmModule_InstancePool");
+  base::SmartPointer<WasmInstancePool> pool(
+      WasmInstancePool::New(isolate, thrower, data, data + arraysize(data),
+                            Handle<JSObject>::null()));
+  CHECK(!pool.is_empty());
+  CHECK_EQ(0u, pool->idle_count());
+
+  Handle<JSObject> instance = pool->Acquire().ToHandleChecked();
+  Handle<String> name = isolate->factory()->InternalizeUtf8String("memory");
+  Handle<JSArrayBuffer> memory = Handle<JSArrayBuffer>::cast(
+      Object::GetProperty(instance, name).ToHandleChecked());
+  byte* mem = reinterpret_cast<byte*>(memory->backing_store());
+  CHECK_EQ(0x11, mem[12]);
+  CHECK_EQ(0x44, mem[15]);
+
+  // Dirty the memory, including the data segment.
+  mem[0] = 1;
+  mem[13] = 2;
+  mem[4095] = 3;
+  CHECK(pool->Release(thrower, instance));
+  CHECK_EQ(1u, pool->idle_count());
+
+  // The same instance comes back in its initial state.
+  Handle<JSObject> again = pool->Acquire().ToHandleChecked();
+  CHECK_EQ(0u, pool->idle_count());
+  CHECK(again.is_identical_to(instance));
+  CHECK_EQ(0, mem[0]);
+  CHECK_EQ(0x22, mem[13]);
+  CHECK_EQ(0, mem[4095]);
+
+  // An empty pool instantiates a fresh instance.
+  Handle<JSObject> other = pool->Acquire().ToHandleChecked();
+  CHECK(!other.is_identical_to(instance));
+  CHECK(pool->Release(thrower, other));
+  CHECK(pool->Release(thrower, again));
+  CHECK_EQ(2u, pool->idle_count());
+}
+
+
+#if V8_OS_POSIX
+namespace {
+// Creates an empty file with a unique name in the temporary directory and
+// stores its path in {path}. Saved states replace their file by a rename,
+// which needs a real path rather than one below /proc/self/fd.
+void CreateTemporaryFile(char* path, size_t size) {
+  const char* dir = getenv("TMPDIR");
+  snprintf(path, size, "%s/wasm-state-XXXXXX", dir != nullptr ? dir : "/tmp");
+  int fd = mkstemp(path);
+  CHECK_LE(0, fd);
+  close(fd);
+}
+}  // namespace
+
+
+TEST(Run_WasmModule_SaveRestoreState) {
+  static const byte data[] = {
+      kDeclMemory, 3,                // section size
+      16, 16, 1,                     // 64kb memory, exported
+      kDeclGlobals, 7,               // section size
+      1,
+      0, 0, 0, 0, kMemI32, 0,        // global#0
+      kDeclDataSegments, 14,         // section size
+      1,
+      12, 0, 0, 0,                   // dest addr
+      31, 0, 0, 0,                   // source offset
+      4, 0, 0, 0,                    // source size
+      1,                             // init
+      kDeclEnd,
+      0x11, 0x22, 0x33, 0x44         // data segment bytes
+  };
+  Isolate* isolate = CcTest::InitIsolateOnce();
+  HandleScope scope(isolate);
+  ModuleResult result =
+      DecodeWasmModule(isolate, data, data + arraysize(data), false, false);
+  CHECK(result.ok());
+  base::SmartPointer<WasmModule> module(result.val);
+
+  Handle<JSObject> instance =
+      module->Instantiate(isolate, Handle<JSObject>::null(),
+                          Handle<JSArrayBuffer>::null())
+          .ToHandleChecked();
+  Handle<JSArrayBuffer> memory = GetInstanceMemory(instance);
+  Handle<JSArrayBuffer> globals = GetInstanceGlobals(instance);
+  CHECK(!memory.is_null());
+  CHECK(!globals.is_null());
+  byte* mem = reinterpret_cast<byte*>(memory->backing_store());
+  mem[13] = 0x55;
+  mem[40000] = 0x66;
+  *reinterpret_cast<int32_t*>(globals->backing_store()) = 12345;
+
+  char path[256];
+  CreateTemporaryFile(path, sizeof(path));
+  ErrorThrower thrower(isolate, "Run_WasmModule_SaveRestoreState");
+  CHECK(SaveInstanceState(thrower, instance, path));
+  Handle<JSObject> restored =
+      RestoreInstanceState(isolate, thrower, module.get(),
+                           Handle<JSObject>::null(), path)
+          .ToHandleChecked();
+  byte* restored_mem =
+      reinterpret_cast<byte*>(GetInstanceMemory(restored)->backing_store());
+  CHECK(restored_mem != mem);
+  // The data segment is not loaded over the saved memory.
+  CHECK_EQ(0x11, restored_mem[12]);
+  CHECK_EQ(0x55, restored_mem[13]);
+  CHECK_EQ(0x66, restored_mem[40000]);
+  CHECK_EQ(0, restored_mem[0]);
+  CHECK_EQ(12345, *reinterpret_cast<int32_t*>(
+                      GetInstanceGlobals(restored)->backing_store()));
+
+  // Writes to the restored memory stay private.
+  restored_mem[0] = 1;
+  CHECK_EQ(0, mem[0]);
+
+  // Saving over the mapped file leaves the restored instance alone, while
+  // new instances see the new state.
+  mem[13] = 0x77;
+  mem[40000] = 0;
+  CHECK(SaveInstanceState(thrower, instance, path));
+  CHECK_EQ(0x55, restored_mem[13]);
+  CHECK_EQ(0x66, restored_mem[40000]);
+  Handle<JSObject> again =
+      RestoreInstanceState(isolate, thrower, module.get(),
+                           Handle<JSObject>::null(), path)
+          .ToHandleChecked();
+  byte* again_mem =
+      reinterpret_cast<byte*>(GetInstanceMemory(again)->backing_store());
+  CHECK_EQ(0x77, again_mem[13]);
+  CHECK_EQ(0, again_mem[40000]);
+  CHECK(!thrower.error());
+
+  unlink(path);
+}
+
+
+TEST(Run_WasmModule_RestoreStateRejectsMismatch) {
+  static const byte data[] = {
+      kDeclMemory, 3,                // section size
+      16, 16, 1,                     // 64kb memory, exported
+      kDeclDataSegments, 14,         // section size
+      1,
+      12, 0, 0, 0,                   // dest addr
+      22, 0, 0, 0,                   // source offset
+      4, 0, 0, 0,                    // source size
+      1,                             // init
+      kDeclEnd,
+      0x11, 0x22, 0x33, 0x44         // data segment bytes
+  };
+  // Same layout, different data segment bytes.
+  static const byte other_data[] = {
+      kDeclMemory, 3,                // section size
+      16, 16, 1,                     // 64kb memory, exported
+      kDeclDataSegments, 14,         // section size
+      1,
+      12, 0, 0, 0,                   // dest addr
+      22, 0, 0, 0,                   // source offset
+      4, 0, 0, 0,                    // source size
+      1,                             // init
+      kDeclEnd,
+      0x55, 0x66, 0x77, 0x88         // data segment bytes
+  };
+  Isolate* isolate = CcTest::InitIsolateOnce();
+  HandleScope scope(isolate);
+  ModuleResult result =
+      DecodeWasmModule(isolate, data, data + arraysize(data), false, false);
+  CHECK(result.ok());
+  base::SmartPointer<WasmModule> module(result.val);
+  ModuleResult other_result = DecodeWasmModule(
+      isolate, other_data, other_data + arraysize(other_data), false, false);
+  CHECK(other_result.ok());
+  base::SmartPointer<WasmModule> other_module(other_result.val);
+
+  Handle<JSObject> instance =
+      module->Instantiate(isolate, Handle<JSObject>::null(),
+                          Handle<JSArrayBuffer>::null())
+          .ToHandleChecked();
+  char path[256];
+  CreateTemporaryFile(path, sizeof(path));
+  {
+    ErrorThrower thrower(isolate, "Run_WasmModule_RestoreStateRejectsMismatch");
+    CHECK(SaveInstanceState(thrower, instance, path));
+  }
+
+  // A state saved for another module is rejected.
+  {
+    ErrorThrower thrower(isolate, "Run_WasmModule_RestoreStateRejectsMismatch");
+    CHECK(RestoreInstanceState(isolate, thrower, other_module.get(),
+                               Handle<JSObject>::null(), path)
+              .is_null());
+    CHECK(thrower.error());
+    CHECK(isolate->has_scheduled_exception());
+    isolate->clear_scheduled_exception();
+  }
+
+  // A file that ends inside the memory image is rejected.
+  CHECK_EQ(0, truncate(path, 64 * 1024 + 4096));
+  {
+    ErrorThrower thrower(isolate, "Run_WasmModule_RestoreStateRejectsMismatch");
+    CHECK(RestoreInstanceState(isolate, thrower, module.get(),
+                               Handle<JSObject>::null(), path)
+              .is_null());
+    CHECK(thrower.error());
+    CHECK(isolate->has_scheduled_exception());
+    isolate->clear_scheduled_exception();
+  }
+
+  unlink(path);
+}
+#endif  // V8_OS_POSIX
+
+
+#if V8_OS_LINUX
+namespace {
+// Returns the inode of the file mapped at {address} as listed in
+// /proc/self/maps, or 0 if the page is anonymous memory.
+uint64_t MappedInode(const void* address) {
+  FILE* maps = fopen("/proc/self/maps", "r");
+  CHECK_NOT_NULL(maps);
+  unsigned long addr = reinterpret_cast<unsigned long>(address);
+  uint64_t inode = 0;
+  char line[512];
+  while (fgets(line, sizeof(line), maps) != nullptr) {
+    unsigned long start;
+    unsigned long end;
+    unsigned long long line_inode;
+    if (sscanf(line, "%lx-%lx %*s %*s %*s %llu", &start, &end,
+               &line_inode) == 3 &&
+        start <= addr && addr < end) {
+      inode = static_cast<uint64_t>(line_inode);
+      break;
+    }
+  }
+  fclose(maps);
+  return inode;
+}
+}  // namespace
+#endif
+
+
+TEST(Run_WasmModule_InstancePoolPageAlignedSegment) {
+  static const uint32_t kSegmentOffset = 4096;
+  static const uint32_t kSegmentSize = 3 * 4096 + 100;
+  static const byte header[] = {
+      kDeclMemory, 3,                // section size
+      16, 16, 1,                     // 64kb memory, exported
+      kDeclDataSegments, 14,         // section size
+      1,
+      0, 0x10, 0, 0,                 // dest addr
+      0, 0x10, 0, 0,                 // source offset
+      0x64, 0x30, 0, 0,              // source size
+      1,                             // init
+      kDeclEnd
+  };
+  // The segment starts on a page boundary of the module bytes, so its
+  // whole pages can be mapped from the pool's copy of the module.
+  std::vector<byte> data(kSegmentOffset + kSegmentSize);
+  memcpy(&data[0], header, sizeof(header));
+  for (uint32_t i = 0; i < kSegmentSize; i++) {
+    data[kSegmentOffset + i] = static_cast<byte>(i * 7 + 1);
+  }
+
+  Isolate* isolate = CcTest::InitIsolateOnce();
+  HandleScope scope(isolate);
+  ErrorThrower thrower(isolate, "Run_WasmModule_InstancePoolPageAligned");
+  base::SmartPointer<WasmInstancePool> pool(WasmInstancePool::New(
+      isolate, thrower, &data[0], &data[0] + data.size(),
+      Handle<JSObject>::null()));
+  CHECK(!pool.is_empty());
+
+  Handle<JSObject> instance = pool->Acquire().ToHandleChecked();
+  Handle<JSObject> other = pool->Acquire().ToHandleChecked();
+  byte* mem =
+      reinterpret_cast<byte*>(GetInstanceMemory(instance)->backing_store());
+  byte* other_mem =
+      reinterpret_cast<byte*>(GetInstanceMemory(other)->backing_store());
+  for (uint32_t i = 0; i < kSegmentSize; i++) {
+    CHECK_EQ(static_cast<byte>(i * 7 + 1), mem[kSegmentOffset + i]);
+  }
+  CHECK_EQ(0, mem[kSegmentOffset - 1]);
+  CHECK_EQ(0, mem[kSegmentOffset + kSegmentSize]);
+#if V8_OS_LINUX && defined(__NR_memfd_create)
+  // The whole pages of the segment are mapped from the module file, while
+  // its partial last page is copied into anonymous memory.
+  CHECK_NE(0u, MappedInode(mem + kSegmentOffset));
+  CHECK_NE(0u, MappedInode(mem + kSegmentOffset + 2 * 4096));
+  CHECK_EQ(0u, MappedInode(mem + kSegmentOffset + 3 * 4096));
+  CHECK_EQ(0u, MappedInode(mem));
+#endif
+
+  // Writes to one instance's segment pages stay private.
+  mem[kSegmentOffset] = 0;
+  mem[kSegmentOffset + 5000] = 0;
+  CHECK_EQ(1, other_mem[kSegmentOffset]);
+  CHECK_EQ(static_cast<byte>(5000 * 7 + 1), other_mem[kSegmentOffset + 5000]);
+
+  // Resetting brings the segment back.
+  CHECK(pool->Release(thrower, instance));
+  instance = pool->Acquire().ToHandleChecked();
+  CHECK_EQ(1, mem[kSegmentOffset]);
+  CHECK_EQ(static_cast<byte>(5000 * 7 + 1), mem[kSegmentOffset + 5000]);
+#if V8_OS_LINUX && defined(__NR_memfd_create)
+  CHECK_NE(0u, MappedInode(mem + kSegmentOffset));
+#endif
+}
+
+
+#if V8_OS_POSIX
+TEST(Run_WasmModule_DiscardExternalMemory) {
+  static const size_t kMemSize = 4 * 65536;
+  static const size_t kDiscardOffset = 65536;
+  static const size_t kDiscardSize = 65536;
+  static const byte data[] = {
+      kDeclMemory, 3,                // section size
+      12, 12, 0,                     // 4kb memory
+      kDeclEnd
+  };
+  // The external memory is one of two shared mappings of a file. Replacing
+  // its pages instead of clearing them would detach it from the other one.
+  FILE* temp = base::OS::OpenTemporaryFile();
+  CHECK_NOT_NULL(temp);
+  int fd = fileno(temp);
+  CHECK_EQ(0, ftruncate(fd, kMemSize));
+  void* mem_mapping =
+      mmap(nullptr, kMemSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  void* view_mapping =
+      mmap(nullptr, kMemSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  CHECK(mem_mapping != MAP_FAILED);
+  CHECK(view_mapping != MAP_FAILED);
+  byte* mem = reinterpret_cast<byte*>(mem_mapping);
+  byte* view = reinterpret_cast<byte*>(view_mapping);
+  memset(mem, 0x55, kMemSize);
+
+  Isolate* isolate = CcTest::InitIsolateOnce();
+  HandleScope scope(isolate);
+  ModuleResult result =
+      DecodeWasmModule(isolate, data, data + arraysize(data), false, false);
+  CHECK(result.ok());
+  base::SmartPointer<WasmModule> module(result.val);
+  Handle<JSArrayBuffer> memory = isolate->factory()->NewJSArrayBuffer();
+  JSArrayBuffer::Setup(memory, isolate, true, mem, kMemSize);
+  Handle<JSObject> instance =
+      module->Instantiate(isolate, Handle<JSObject>::null(), memory)
+          .ToHandleChecked();
+
+  ErrorThrower thrower(isolate, "Run_WasmModule_DiscardExternalMemory");
+  CHECK(DiscardInstanceMemory(thrower, instance, kDiscardOffset,
+                              kDiscardSize));
+  CHECK(!thrower.error());
+  CHECK_EQ(0x55, mem[kDiscardOffset - 1]);
+  CHECK_EQ(0, mem[kDiscardOffset]);
+  CHECK_EQ(0, mem[kDiscardOffset + kDiscardSize - 1]);
+  CHECK_EQ(0x55, mem[kDiscardOffset + kDiscardSize]);
+
+  // Both mappings still share the cleared pages.
+  CHECK_EQ(0, view[kDiscardOffset]);
+  mem[kDiscardOffset] = 1;
+  CHECK_EQ(1, view[kDiscardOffset]);
+
+  munmap(view_mapping, kMemSize);
+  munmap(mem_mapping, kMemSize);
+  fclose(temp);
+}
+#endif  // V8_OS_POSIX
+
+
+TEST(Run_WasmModule_MaskedExternalMemory) {
+  static const size_t kMemSize = 4096;
+  static const byte data[] = {
+      kDeclMemory, 3,                // section size
+      12, 12, 0,                     // 4kb memory
+      kDeclEnd
+  };
+  static byte mem[kMemSize];
+  Isolate* isolate = CcTest::InitIsolateOnce();
+  HandleScope scope(isolate);
+  ModuleResult result =
+      DecodeWasmModule(isolate, data, data + arraysize(data), false, false);
+  CHECK(result.ok());
+  base::SmartPointer<WasmModule> module(result.val);
+  Handle<JSArrayBuffer> memory = isolate->factory()->NewJSArrayBuffer();
+  JSArrayBuffer::Setup(memory, isolate, true, mem, kMemSize);
+
+  // External memory has no guard to absorb masked accesses, so the
+  // combination is rejected rather than silently left unmasked.
+  WasmInstanceOptions options;
+  options.mem_masked = true;
+  CHECK(module->Instantiate(isolate, Handle<JSObject>::null(), memory, options)
+            .is_null());
+  CHECK(isolate->has_scheduled_exception());
+  isolate->clear_scheduled_exception();
+
+  // Memory allocated by the instance can be masked.
+  CHECK(!module->Instantiate(isolate, Handle<JSObject>::null(),
+                             Handle<JSArrayBuffer>::null(), options)
+             .is_null());
+  CHECK(!isolate->has_scheduled_exception());
+}
+
+
+TEST(Run_WasmModule_Memory4GB) {
+  if (kPointerSize < 8)
+    return;
+  static const byte data[] = {
+      kDeclMemory, 3,                // section size
+      32, 32, 1,                     // 4gb memory, exported
+      kDeclDataSegments, 14,         // section size
+      1,
+      0xf0, 0xff, 0xff, 0xff,        // dest addr
+      22, 0, 0, 0,                   // source offset
+      4, 0, 0, 0,                    // source size
+      1,                             // init
+      kDeclEnd,
+      0x11, 0x22, 0x33, 0x44         // data segment bytes
+  };
+  Isolate* isolate = CcTest::InitIsolateOnce();
+  HandleScope scope(isolate);
+  ModuleResult result =
+      DecodeWasmModule(isolate, data, data + arraysize(data), false, false);
+  CHECK(result.ok());
+  base::SmartPointer<WasmModule> module(result.val);
+
+  Handle<JSObject> instance =
+      module->Instantiate(isolate, Handle<JSObject>::null(),
+                          Handle<JSArrayBuffer>::null())
+          .ToHandleChecked();
+  Handle<JSArrayBuffer> memory = GetInstanceMemory(instance);
+  CHECK_EQ(4294967296.0, memory->byte_length()->Number());
+  byte* mem = reinterpret_cast<byte*>(memory->backing_store());
+  CHECK_EQ(0x11, mem[0xfffffff0u]);
+  CHECK_EQ(0x44, mem[0xfffffff3u]);
+  CHECK_EQ(0, mem[0xffffffffu]);
+
+  // The exported memory covers the whole 4gb.
+  Handle<String> name = isolate->factory()->InternalizeUtf8String("memory");
+  Handle<Object> exported =
+      Object::GetProperty(instance, name).ToHandleChecked();
+  CHECK(exported->IsJSArrayBuffer());
+  CHECK_EQ(4294967296.0,
+           JSArrayBuffer::cast(*exported)->byte_length()->Number());
+}
+
+
+namespace {
+int32_t HostStore(byte* mem_start, size_t mem_size, int32_t index,
+                  double value) {
+  CHECK_EQ(65536u, mem_size);
+  mem_start[index] = 33;
+  return index + static_cast<int32_t>(value * 2);
+}
+
+void HostNop(byte* mem_start, size_t mem_size) {}
+}  // namespace
+
+
+TEST(Run_WasmModule_HostFunction) {
+  static const byte data[] = {
+      kDeclMemory, 3,                // section size
+      16, 16, 0,                     // 64kb memory
+      kDeclSignatures, 7,            // section size
+      2,
+      0, kAstI32,                    // void -> int
+      2, kAstI32, kAstI32, kAstF64,  // int,double -> int
+      kDeclFunctions, 27,            // section size
+      2,
+      kDeclFunctionName | kDeclFunctionImport,
+      1,                             // sig index
+      44, 0, 0, 0,                   // name offset
+      kDeclFunctionName | kDeclFunctionExport,
+      0,                             // sig index
+      49, 0, 0, 0,                   // name offset
+      13,                            // body size
+      WASM_CALL_FUNCTION(0, WASM_I8(7), WASM_F64(2.5)),
+      kDeclEnd,
+      'h', 'o', 's', 't', 0,
+      'm', 'a', 'i', 'n', 0
+  };
+  Isolate* isolate = CcTest::InitIsolateOnce();
+  HandleScope scope(isolate);
+  Factory* factory = isolate->factory();
+  ModuleResult result =
+      DecodeWasmModule(isolate, data, data + arraysize(data), false, false);
+  CHECK(result.ok());
+  base::SmartPointer<WasmModule> module(result.val);
+  Handle<String> host = factory->InternalizeUtf8String("host");
+
+  Handle<JSObject> ffi = factory->NewJSObject(isolate->object_function());
+  JSObject::AddProperty(ffi, host, NewWasmHostFunction(isolate, HostStore),
+                        NONE);
+  Handle<JSObject> instance =
+      module->Instantiate(isolate, ffi, Handle<JSArrayBuffer>::null())
+          .ToHandleChecked();
+  Handle<Object> main =
+      Object::GetProperty(instance, factory->InternalizeUtf8String("main"))
+          .ToHandleChecked();
+  Handle<Object> value =
+      Execution::Call(isolate, main, factory->undefined_value(), 0, nullptr)
+          .ToHandleChecked();
+  CHECK_EQ(12, value->Number());
+  byte* mem =
+      reinterpret_cast<byte*>(GetInstanceMemory(instance)->backing_store());
+  CHECK_EQ(33, mem[7]);
+
+  // Host functions of a different signature are rejected.
+  Handle<JSObject> other_ffi =
+      factory->NewJSObject(isolate->object_function());
+  JSObject::AddProperty(other_ffi, host,
+                        NewWasmHostFunction(isolate, HostNop), NONE);
+  CHECK(module->Instantiate(isolate, other_ffi, Handle<JSArrayBuffer>::null())
+            .is_null());
+  isolate->clear_pending_exception();
+}
+
+
+namespace {
+// Exports add(a, b) = a + b.
+const byte kExporterData[] = {
+    kDeclMemory, 3,                        // section size
+    16, 16, 0,                             // 64kb memory
+    kDeclSignatures, 5,                    // section size
+    1,
+    2, kAstI32, kAstI32, kAstI32,          // int,int -> int
+    kDeclFunctions, 13,                    // section size
+    1,
+    kDeclFunctionName | kDeclFunctionExport,
+    0,                                     // sig index
+    28, 0, 0, 0,                           // name offset
+    5,                                     // body size
+    WASM_I32_ADD(WASM_GET_LOCAL(0), WASM_GET_LOCAL(1)),
+    kDeclEnd,
+    'a', 'd', 'd', 0
+};
+// Imports add twice, as (i32, i32)->i32 and as (f64)->f64, and exports
+// callAdd(a, b) = add(a, b).
+const byte kImporterData[] = {
+    kDeclMemory, 3,                        // section size
+    16, 16, 0,                             // 64kb memory
+    kDeclSignatures, 8,                    // section size
+    2,
+    2, kAstI32, kAstI32, kAstI32,          // int,int -> int
+    1, kAstF64, kAstF64,                   // double -> double
+    kDeclFunctions, 26,                    // section size
+    3,
+    kDeclFunctionName | kDeclFunctionImport,
+    0,                                     // sig index
+    44, 0, 0, 0,                           // name offset
+    kDeclFunctionName | kDeclFunctionImport,
+    1,                                     // sig index
+    48, 0, 0, 0,                           // name offset
+    kDeclFunctionName | kDeclFunctionExport,
+    0,                                     // sig index
+    54, 0, 0, 0,                           // name offset
+    6,                                     // body size
+    WASM_CALL_FUNCTION(0, WASM_GET_LOCAL(0), WASM_GET_LOCAL(1)),
+    kDeclEnd,
+    'a', 'd', 'd', 0,
+    'o', 't', 'h', 'e', 'r', 0,
+    'c', 'a', 'l', 'l', 'A', 'd', 'd', 0
+};
+}  // namespace
+
+
+TEST(Run_WasmModule_DirectImport) {
+  Isolate* isolate = CcTest::InitIsolateOnce();
+  HandleScope scope(isolate);
+  Factory* factory = isolate->factory();
+  ModuleResult exporter_result = DecodeWasmModule(
+      isolate, kExporterData, kExporterData + arraysize(kExporterData), false,
+      false);
+  CHECK(exporter_result.ok());
+  base::SmartPointer<WasmModule> exporter_module(exporter_result.val);
+  ModuleResult importer_result = DecodeWasmModule(
+      isolate, kImporterData, kImporterData + arraysize(kImporterData), false,
+      false);
+  CHECK(importer_result.ok());
+  base::SmartPointer<WasmModule> importer_module(importer_result.val);
+
+  Handle<JSObject> exporter =
+      exporter_module->Instantiate(isolate, Handle<JSObject>::null(),
+                                   Handle<JSArrayBuffer>::null())
+          .ToHandleChecked();
+  Handle<Object> add =
+      Object::GetProperty(exporter, factory->InternalizeUtf8String("add"))
+          .ToHandleChecked();
+  Handle<JSObject> ffi = factory->NewJSObject(isolate->object_function());
+  JSObject::AddProperty(ffi, factory->InternalizeUtf8String("add"), add, NONE);
+  JSObject::AddProperty(ffi, factory->InternalizeUtf8String("other"), add,
+                        NONE);
+  Handle<JSObject> importer =
+      importer_module->Instantiate(isolate, ffi, Handle<JSArrayBuffer>::null())
+          .ToHandleChecked();
+
+  // The import of the same signature is linked to the exporter's code, while
+  // the other one goes through JS.
+  Object* code = GetInstanceCodeTable(exporter)->get(0);
+  CHECK_EQ(code, GetInstanceCodeTable(importer)->get(0));
+  CHECK_NE(code, GetInstanceCodeTable(importer)->get(1));
+
+  Handle<Object> call_add =
+      Object::GetProperty(importer, factory->InternalizeUtf8String("callAdd"))
+          .ToHandleChecked();
+  Handle<Object> args[] = {factory->NewNumber(40), factory->NewNumber(2)};
+  Handle<Object> value =
+      Execution::Call(isolate, call_add, factory->undefined_value(), 2, args)
+          .ToHandleChecked();
+  CHECK_EQ(42, value->Number());
+}
+
+
+TEST(Run_WasmModule_CompiledModuleCall) {
+  static const byte data[] = {
+      kDeclMemory, 3,                        // section size
+      16, 16, 0,                             // 64kb memory
+      kDeclSignatures, 9,                    // section size
+      2,
+      2, kAstI32, kAstI32, kAstI32,          // int,int -> int
+      2, kAstI32, kAstI32, kAstF64,          // int,double -> int
+      kDeclFunctions, 50,                    // section size
+      4,
+      kDeclFunctionName | kDeclFunctionImport,
+      1,                                     // sig index
+      69, 0, 0, 0,                           // name offset
+      kDeclFunctionName | kDeclFunctionExport,
+      0,                                     // sig index
+      74, 0, 0, 0,                           // name offset
+      5,                                     // body size
+      WASM_I32_ADD(WASM_GET_LOCAL(0), WASM_GET_LOCAL(1)),
+      kDeclFunctionName | kDeclFunctionExport,
+      0,                                     // sig index
+      78, 0, 0, 0,                           // name offset
+      4,                                     // body size
+      WASM_LOAD_MEM(kMemI32, WASM_GET_LOCAL(0)),
+      kDeclFunctionName | kDeclFunctionExport,
+      0,                                     // sig index
+      83, 0, 0, 0,                           // name offset
+      13,                                    // body size
+      WASM_CALL_FUNCTION(0, WASM_GET_LOCAL(0), WASM_F64(2.5)),
+      kDeclEnd,
+      'h', 'o', 's', 't', 0,
+      'a', 'd', 'd', 0,
+      'l', 'o', 'a', 'd', 0,
+      'c', 'a', 'l', 'l', 'H', 'o', 's', 't', 0
+  };
+  Isolate* isolate = CcTest::InitIsolateOnce();
+  HandleScope scope(isolate);
+  Factory* factory = isolate->factory();
+  ErrorThrower thrower(isolate, "Run_WasmModule_CompiledModuleCall");
+  base::SmartPointer<WasmCompiledModule> compiled(WasmCompiledModule::Compile(
+      isolate, thrower, data, data + arraysize(data)));
+  CHECK(!compiled.is_empty());
+
+  Handle<JSObject> ffi = factory->NewJSObject(isolate->object_function());
+  JSObject::AddProperty(ffi, factory->InternalizeUtf8String("host"),
+                        NewWasmHostFunction(isolate, HostStore), NONE);
+  base::SmartPointer<WasmInstance> instance(
+      compiled->Instantiate(thrower, ffi, Handle<JSArrayBuffer>::null()));
+  CHECK(!instance.is_empty());
+
+  WasmCallResult<int32_t> sum =
+      instance->Call<int32_t(int32_t, int32_t)>("add", 40, 2);
+  CHECK_EQ(kWasmCallOk, sum.status);
+  CHECK_EQ(42, sum.value);
+  CHECK_EQ(-1, sum.trap);
+
+  // Exports may call host functions, which see the memory of the instance.
+  WasmCallResult<int32_t> stored =
+      instance->Call<int32_t(int32_t, int32_t)>("callHost", 7, 0);
+  CHECK_EQ(kWasmCallOk, stored.status);
+  CHECK_EQ(12, stored.value);
+  CHECK_EQ(33,
+           (instance->Call<int32_t(int32_t, int32_t)>("load", 7, 0).value));
+
+  // Traps are reported as status codes and leave the instance usable.
+  WasmCallResult<int32_t> trapped =
+      instance->Call<int32_t(int32_t, int32_t)>("load", 65536, 0);
+  CHECK_EQ(kWasmCallTrap, trapped.status);
+  CHECK_EQ(0, strcmp("memory access out of bounds", trapped.trap_message()));
+  CHECK_EQ(7, (instance->Call<int32_t(int32_t, int32_t)>("add", 3, 4).value));
+
+  // The signature must match the export exactly.
+  CHECK_EQ(kWasmCallNoSuchExport,
+           (instance->Call<int32_t(int32_t)>("add", 1).status));
+  CHECK_EQ(kWasmCallNoSuchExport,
+           (instance->Call<double(int32_t, int32_t)>("add", 1, 2).status));
+  CHECK_EQ(kWasmCallNoSuchExport,
+           (instance->Call<int32_t(int32_t, int32_t)>("missing", 1, 2).status));
+
+  // Exports looked up once are called without a name lookup, and calls
+  // create no handles.
+  WasmExport<int32_t(int32_t, int32_t)> add =
+      instance->GetExport<int32_t(int32_t, int32_t)>("add");
+  CHECK(add.is_valid());
+  int handles = HandleScope::NumberOfHandles(isolate);
+  for (int32_t i = 0; i < 10; i++) {
+    CHECK_EQ(i + 5, add(i, 5).value);
+  }
+  CHECK_EQ(handles, HandleScope::NumberOfHandles(isolate));
+  WasmExport<int32_t(int32_t)> wrong_add =
+      instance->GetExport<int32_t(int32_t)>("add");
+  CHECK(!wrong_add.is_valid());
+  CHECK_EQ(kWasmCallNoSuchExport, wrong_add(1).status);
+
+  // The untyped interface leaves the signature check to the caller.
+  Address entry = instance->LookupExport("load");
+  CHECK_NOT_NULL(entry);
+  const std::vector<LocalType>* sig = instance->ExportSignature("load");
+  CHECK_EQ(3u, sig->size());
+  CHECK_EQ(kAstI32, sig->at(0));
+  uint64_t slots[2];
+  byte* bytes = reinterpret_cast<byte*>(slots);
+  WriteCallSlots(bytes, 7, 0);
+  int trap;
+  CHECK_EQ(kWasmCallOk, instance->CallEntry(entry, bytes, &trap));
+  CHECK_EQ(-1, trap);
+  int32_t loaded;
+  memcpy(&loaded, bytes, sizeof(loaded));
+  CHECK_EQ(33, loaded);
+  CHECK_NULL(instance->LookupExport("missing"));
+  CHECK_NULL(instance->ExportSignature("missing"));
+
+  // Instances of the same module have their own memory.
+  base::SmartPointer<WasmInstance> other(
+      compiled->Instantiate(thrower, ffi, Handle<JSArrayBuffer>::null()));
+  CHECK(!other.is_empty());
+  CHECK_EQ(0, (other->Call<int32_t(int32_t, int32_t)>("load", 7, 0).value));
+
+  // Exports are only compiled for C++ callers.
+  CHECK(Object::GetProperty(instance->object(),
+                            factory->InternalizeUtf8String("add"))
+            .ToHandleChecked()
+            ->IsUndefined());
+
+  // Exports must not reach JS imports.
+  Handle<JSObject> js_ffi = factory->NewJSObject(isolate->object_function());
+  JSObject::AddProperty(js_ffi, factory->InternalizeUtf8String("host"),
+                        isolate->object_function(), NONE);
+  CHECK_NULL(
+      compiled->Instantiate(thrower, js_ffi, Handle<JSArrayBuffer>::null()));
+  CHECK(isolate->has_scheduled_exception());
+  isolate->clear_scheduled_exception();
+}
+
+
+TEST(Run_WasmModule_CompiledModuleRejectsIndirectCalls) {
+  static const byte data[] = {
+      kDeclMemory, 3,                        // section size
+      16, 16, 0,                             // 64kb memory
+      kDeclSignatures, 5,                    // section size
+      1,
+      2, kAstI32, kAstI32, kAstI32,          // int,int -> int
+      kDeclFunctions, 16,                    // section size
+      1,
+      kDeclFunctionName | kDeclFunctionExport,
+      0,                                     // sig index
+      35, 0, 0, 0,                           // name offset
+      8,                                     // body size
+      WASM_CALL_INDIRECT(0, WASM_GET_LOCAL(0), WASM_GET_LOCAL(0),
+                         WASM_GET_LOCAL(1)),
+      kDeclFunctionTable, 2,                 // section size
+      1,
+      0,
+      kDeclEnd,
+      'f', 0
+  };
+  Isolate* isolate = CcTest::InitIsolateOnce();
+  HandleScope scope(isolate);
+  ErrorThrower thrower(isolate,
+                       "Run_WasmModule_CompiledModuleRejectsIndirectCalls");
+  CHECK_NULL(WasmCompiledModule::Compile(isolate, thrower, data,
+                                         data + arraysize(data)));
+  CHECK(thrower.error());
+  CHECK(isolate->has_scheduled_exception());
+  isolate->clear_scheduled_exception();
+}
+
+
+TEST(Run_WasmModule_CompiledModuleCalleeTrap) {
+  static const byte data[] = {
+      kDeclMemory, 3,                        // section size
+      16, 16, 0,                             // 64kb memory
+      kDeclSignatures, 5,                    // section size
+      1,
+      2, kAstI32, kAstI32, kAstI32,          // int,int -> int
+      kDeclFunctions, 34,                    // section size
+      2,
+      kDeclFunctionName | kDeclFunctionExport,
+      0,                                     // sig index
+      49, 0, 0, 0,                           // name offset
+      5,                                     // body size
+      WASM_I32_DIVS(WASM_GET_LOCAL(0), WASM_GET_LOCAL(1)),
+      kDeclFunctionName | kDeclFunctionExport,
+      0,                                     // sig index
+      53, 0, 0, 0,                           // name offset
+      14,                                    // body size
+      WASM_BLOCK(2, WASM_CALL_FUNCTION(0, WASM_GET_LOCAL(0), WASM_GET_LOCAL(1)),
+                 WASM_STORE_MEM(kMemI32, WASM_ZERO, WASM_I8(99))),
+      kDeclEnd,
+      'd', 'i', 'v', 0,
+      'c', 'a', 'l', 'l', 'D', 'i', 'v', 0
+  };
+  Isolate* isolate = CcTest::InitIsolateOnce();
+  HandleScope scope(isolate);
+  ErrorThrower thrower(isolate, "Run_WasmModule_CompiledModuleCalleeTrap");
+  base::SmartPointer<WasmCompiledModule> compiled(WasmCompiledModule::Compile(
+      isolate, thrower, data, data + arraysize(data)));
+  CHECK(!compiled.is_empty());
+  base::SmartPointer<WasmInstance> instance(compiled->Instantiate(
+      thrower, Handle<JSObject>::null(), Handle<JSArrayBuffer>::null()));
+  CHECK(!instance.is_empty());
+  int32_t* mem = reinterpret_cast<int32_t*>(
+      GetInstanceMemory(instance->object())->backing_store());
+
+  // The caller returns as soon as the callee traps, before its store.
+  WasmCallResult<int32_t> trapped =
+      instance->Call<int32_t(int32_t, int32_t)>("callDiv", 1, 0);
+  CHECK_EQ(kWasmCallTrap, trapped.status);
+  CHECK_EQ(0, strcmp("divide by zero", trapped.trap_message()));
+  CHECK_EQ(0, mem[0]);
+
+  WasmCallResult<int32_t> stored =
+      instance->Call<int32_t(int32_t, int32_t)>("callDiv", 1, 1);
+  CHECK_EQ(kWasmCallOk, stored.status);
+  CHECK_EQ(99, mem[0]);
+}
+
+
+#if V8_OS_POSIX && !USE_SIMULATOR
+namespace {
+// Runs the foreground tasks of the platform until the promise of the call
+// started on {instance} by {CallAsync} settled, which makes it idle again.
+void WaitUntilIdle(Isolate* isolate, Handle<JSObject> instance) {
+  while (IsInstanceBusy(instance)) {
+    v8::platform::PumpMessageLoop(V8::GetCurrentPlatform(),
+                                  reinterpret_cast<v8::Isolate*>(isolate));
+    base::OS::Sleep(base::TimeDelta::FromMilliseconds(1));
+  }
+}
+
+// Starts {add}(1, 2) of {instance} on a background thread.
+void StartAsyncAdd(Isolate* isolate, Handle<JSObject> instance) {
+  ErrorThrower thrower(isolate, "StartAsyncAdd");
+  std::vector<double> args = {1, 2};
+  CHECK(!CallAsync(thrower, isolate, instance,
+                   isolate->factory()->InternalizeUtf8String("add"), args)
+             .is_null());
+  CHECK(IsInstanceBusy(instance));
+}
+
+// Runs the foreground tasks of the platform and microtasks until the
+// global {result} of the current context is set, or fails after ten
+// seconds.
+v8::Local<v8::Value> WaitForResult(Isolate* isolate) {
+  v8::Isolate* v8_isolate = reinterpret_cast<v8::Isolate*>(isolate);
+  for (int i = 0; i < 10000; i++) {
+    v8::platform::PumpMessageLoop(V8::GetCurrentPlatform(), v8_isolate);
+    v8_isolate->RunMicrotasks();
+    v8::Local<v8::Value> result = CompileRun("result");
+    if (!result->IsUndefined())
+      return result;
+    base::OS::Sleep(base::TimeDelta::FromMilliseconds(1));
+  }
+  CHECK(false);
+  return v8::Local<v8::Value>();
+}
+
+// Checks that {thrower} reported an error and clears it.
+void CheckBusyError(Isolate* isolate, ErrorThrower& thrower) {
+  CHECK(thrower.error());
+  CHECK(isolate->has_scheduled_exception());
+  isolate->clear_scheduled_exception();
+}
+}  // namespace
+
+
+TEST(Run_WasmModule_BusyInstance) {
+  static const byte data[] = {
+      kDeclMemory, 3,                        // section size
+      12, 12, 1,                             // 4kb memory, exported
+      kDeclSignatures, 5,                    // section size
+      1,
+      2, kAstI32, kAstI32, kAstI32,          // int,int -> int
+      kDeclFunctions, 13,                    // section size
+      1,
+      kDeclFunctionName | kDeclFunctionExport,
+      0,                                     // sig index
+      28, 0, 0, 0,                           // name offset
+      5,                                     // body size
+      WASM_I32_ADD(WASM_GET_LOCAL(0), WASM_GET_LOCAL(1)),
+      kDeclEnd,
+      'a', 'd', 'd', 0
+  };
+  Isolate* isolate = CcTest::InitIsolateOnce();
+  HandleScope scope(isolate);
+  LocalContext context;
+  ModuleResult result =
+      DecodeWasmModule(isolate, data, data + arraysize(data), false, false);
+  CHECK(result.ok());
+  base::SmartPointer<WasmModule> module(result.val);
+  WasmInstanceOptions options;
+  options.parallel_exports = true;
+  Handle<JSObject> instance =
+      module->Instantiate(isolate, Handle<JSObject>::null(),
+                          Handle<JSArrayBuffer>::null(), options)
+          .ToHandleChecked();
+  char path[256];
+  CreateTemporaryFile(path, sizeof(path));
+
+  // Native threads may still use the memory, so nothing may reset or
+  // capture it.
+  StartAsyncAdd(isolate, instance);
+  {
+    ErrorThrower thrower(isolate, "Run_WasmModule_BusyInstance");
+    CHECK(!module->ResetInstance(thrower, instance, options));
+    CheckBusyError(isolate, thrower);
+  }
+  {
+    ErrorThrower thrower(isolate, "Run_WasmModule_BusyInstance");
+    CHECK(!SaveInstanceState(thrower, instance, path));
+    CheckBusyError(isolate, thrower);
+  }
+  {
+    ErrorThrower thrower(isolate, "Run_WasmModule_BusyInstance");
+    CHECK_NULL(WasmSnapshot::New(isolate, thrower, instance));
+    CheckBusyError(isolate, thrower);
+  }
+
+  // All of them work again once the promise settled.
+  WaitUntilIdle(isolate, instance);
+  {
+    ErrorThrower thrower(isolate, "Run_WasmModule_BusyInstance");
+    CHECK(module->ResetInstance(thrower, instance, options));
+    CHECK(SaveInstanceState(thrower, instance, path));
+    base::SmartPointer<WasmSnapshot> snapshot(
+        WasmSnapshot::New(isolate, thrower, instance));
+    CHECK(!snapshot.is_empty());
+    CHECK(!thrower.error());
+  }
+  unlink(path);
+
+  // A pool does not take back a busy instance.
+  ErrorThrower thrower(isolate, "Run_WasmModule_BusyInstance");
+  base::SmartPointer<WasmInstancePool> pool(WasmInstancePool::New(
+      isolate, thrower, data, data + arraysize(data),
+      Handle<JSObject>::null(), options));
+  CHECK(!pool.is_empty());
+  Handle<JSObject> pooled = pool->Acquire().ToHandleChecked();
+  StartAsyncAdd(isolate, pooled);
+  CHECK(!pool->Release(thrower, pooled));
+  CHECK_EQ(0u, pool->idle_count());
+  CheckBusyError(isolate, thrower);
+  WaitUntilIdle(isolate, pooled);
+  ErrorThrower other_thrower(isolate, "Run_WasmModule_BusyInstance");
+  CHECK(pool->Release(other_thrower, pooled));
+  CHECK_EQ(1u, pool->idle_count());
+}
+
+
+TEST(Run_WasmModule_DirectImportOfBusyInstance) {
+  Isolate* isolate = CcTest::InitIsolateOnce();
+  HandleScope scope(isolate);
+  LocalContext context;
+  Factory* factory = isolate->factory();
+  ModuleResult exporter_result = DecodeWasmModule(
+      isolate, kExporterData, kExporterData + arraysize(kExporterData), false,
+      false);
+  CHECK(exporter_result.ok());
+  base::SmartPointer<WasmModule> exporter_module(exporter_result.val);
+  ModuleResult importer_result = DecodeWasmModule(
+      isolate, kImporterData, kImporterData + arraysize(kImporterData), false,
+      false);
+  CHECK(importer_result.ok());
+  base::SmartPointer<WasmModule> importer_module(importer_result.val);
+
+  WasmInstanceOptions options;
+  options.parallel_exports = true;
+  Handle<JSObject> exporter =
+      exporter_module->Instantiate(isolate, Handle<JSObject>::null(),
+                                   Handle<JSArrayBuffer>::null(), options)
+          .ToHandleChecked();
+  Handle<Object> add =
+      Object::GetProperty(exporter, factory->InternalizeUtf8String("add"))
+          .ToHandleChecked();
+  Handle<JSObject> ffi = factory->NewJSObject(isolate->object_function());
+  JSObject::AddProperty(ffi, factory->InternalizeUtf8String("add"), add, NONE);
+  JSObject::AddProperty(ffi, factory->InternalizeUtf8String("other"), add,
+                        NONE);
+  Handle<JSObject> importer =
+      importer_module->Instantiate(isolate, ffi, Handle<JSArrayBuffer>::null())
+          .ToHandleChecked();
+
+  // Native threads may use the exporter, so the importer calls it through
+  // its JS wrapper, which checks that it is idle.
+  CHECK_NE(GetInstanceCodeTable(exporter)->get(0),
+           GetInstanceCodeTable(importer)->get(0));
+
+  Handle<Object> call_add =
+      Object::GetProperty(importer, factory->InternalizeUtf8String("callAdd"))
+          .ToHandleChecked();
+  Handle<Object> args[] = {factory->NewNumber(40), factory->NewNumber(2)};
+  StartAsyncAdd(isolate, exporter);
+  CHECK(Execution::Call(isolate, call_add, factory->undefined_value(), 2, args)
+            .is_null());
+  CHECK(isolate->has_pending_exception());
+  isolate->clear_pending_exception();
+
+  WaitUntilIdle(isolate, exporter);
+  Handle<Object> value =
+      Execution::Call(isolate, call_add, factory->undefined_value(), 2, args)
+          .ToHandleChecked();
+  CHECK_EQ(42, value->Number());
+}
+#endif  // V8_OS_POSIX && !USE_SIMULATOR
+
+
+#if V8_OS_POSIX && !USE_SIMULATOR
+TEST(Run_WasmModule_CallAsyncSettles) {
+  static const byte data[] = {
+      kDeclMemory, 3,                        // section size
+      12, 12, 0,                             // 4kb memory
+      kDeclSignatures, 5,                    // section size
+      1,
+      2, kAstI32, kAstI32, kAstI32,          // int,int -> int
+      kDeclFunctions, 13,                    // section size
+      1,
+      kDeclFunctionName | kDeclFunctionExport,
+      0,                                     // sig index
+      28, 0, 0, 0,                           // name offset
+      5,                                     // body size
+      WASM_I32_DIVS(WASM_GET_LOCAL(0), WASM_GET_LOCAL(1)),
+      kDeclEnd,
+      'd', 'i', 'v', 0
+  };
+  Isolate* isolate = CcTest::InitIsolateOnce();
+  HandleScope scope(isolate);
+  LocalContext context;
+  ModuleResult result =
+      DecodeWasmModule(isolate, data, data + arraysize(data), false, false);
+  CHECK(result.ok());
+  base::SmartPointer<WasmModule> module(result.val);
+  WasmInstanceOptions options;
+  options.parallel_exports = true;
+  Handle<JSObject> instance =
+      module->Instantiate(isolate, Handle<JSObject>::null(),
+                          Handle<JSArrayBuffer>::null(), options)
+          .ToHandleChecked();
+  Handle<String> name = isolate->factory()->InternalizeUtf8String("div");
+
+  // The promise is resolved with the result.
+  ErrorThrower thrower(isolate, "Run_WasmModule_CallAsyncSettles");
+  std::vector<double> args = {42, 6};
+  Handle<JSObject> promise =
+      CallAsync(thrower, isolate, instance, name, args).ToHandleChecked();
+  context->Global()->Set(v8_str("promise"), v8::Utils::ToLocal(promise));
+  CompileRun(
+      "var result;"
+      "promise.then(function(v) { result = v; },"
+      "             function(e) { result = 'rejected: ' + e; });");
+  CHECK_EQ(7, WaitForResult(isolate)->Int32Value());
+  CHECK(!IsInstanceBusy(instance));
+
+  // Traps reject it with the trap message.
+  args[1] = 0;
+  promise = CallAsync(thrower, isolate, instance, name, args)
+                .ToHandleChecked();
+  context->Global()->Set(v8_str("promise"), v8::Utils::ToLocal(promise));
+  CompileRun(
+      "result = undefined;"
+      "promise.then(function(v) { result = v; },"
+      "             function(e) { result = 'rejected: ' + e; });");
+  v8::String::Utf8Value message(WaitForResult(isolate));
+  CHECK_EQ(0, strcmp("rejected: divide by zero", *message));
+  CHECK(!IsInstanceBusy(instance));
+  CHECK(!thrower.error());
+}
+#endif  // V8_OS_POSIX && !USE_SIMULATOR
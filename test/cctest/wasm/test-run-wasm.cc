@@ -8,8 +8,11 @@
 #include "src/compiler/graph-visualizer.h"
 #include "src/compiler/js-graph.h"
 
+#include "src/base/smart-pointers.h"
+
 #include "src/wasm/ast-decoder.h"
 #include "src/wasm/wasm-macro-gen.h"
+#include "src/wasm/wasm-memory.h"
 #include "src/wasm/wasm-module.h"
 #include "src/wasm/wasm-opcodes.h"
 
@@ -69,12 +72,10 @@ class TestingModule : public ModuleEnv {
       free(raw_mem_start<byte>());
     }
     if (module) {
-      if (module->globals) delete module->globals;
-      if (module->signatures) delete module->signatures;
-      if (module->functions) delete module->functions;
       if (globals_area) free(reinterpret_cast<byte*>(globals_area));
       delete module;
     }
+    if (function_code) delete function_code;
   }
 
   byte* AddMemory(size_t size) {
@@ -102,9 +103,6 @@ class TestingModule : public ModuleEnv {
 
   byte AddSignature(FunctionSig* sig) {
     AllocModule();
-    if (!module->signatures) {
-      module->signatures = new std::vector<FunctionSig*>();
-    }
     module->signatures->push_back(sig);
     size_t size = module->signatures->size();
     CHECK(size < 127);
@@ -144,11 +142,10 @@ class TestingModule : public ModuleEnv {
 
   WasmFunction* AddFunction(FunctionSig* sig, Handle<Code> code) {
     AllocModule();
-    if (module->functions == nullptr) {
-      module->functions = new std::vector<WasmFunction>();
+    if (function_code == nullptr) {
       function_code = new std::vector<Handle<Code>>();
     }
-    module->functions->push_back({sig, 0, 0, 0, 0, 0, 0, 0, false, false});
+    module->functions->push_back({sig, 0, 0, 0, 0, 0, 0, 0, 0, false, false});
     function_code->push_back(code);
     return &module->functions->back();
   }
@@ -161,7 +158,6 @@ class TestingModule : public ModuleEnv {
     AllocModule();
     if (globals_area == 0) {
       globals_area = reinterpret_cast<uintptr_t>(malloc(kMaxGlobalsSize));
-      module->globals = new std::vector<WasmGlobal>();
     }
     byte size = WasmOpcodes::MemSize(mem_type);
     global_offset = (global_offset + size - 1) & ~(size - 1);  // align
@@ -173,9 +169,6 @@ class TestingModule : public ModuleEnv {
   void AllocModule() {
     if (module == nullptr) {
       module = new WasmModule();
-      module->globals = nullptr;
-      module->functions = nullptr;
-      module->data_segments = nullptr;
     }
   }
 };
@@ -1846,6 +1839,228 @@ TEST(Run_Wasm_LoadMemI32_oob_asm) {
 }
 
 
+TEST(Run_Wasm_LoadMemI32_masked) {
+  WasmRunner<int32_t> r(kMachUint32);
+  TestingModule module;
+  module.mem_masked = true;
+  int32_t* memory = module.AddMemoryElems<int32_t>(8);
+  r.env()->module = &module;
+
+  BUILD(r, WASM_LOAD_MEM(kMemI32, WASM_GET_LOCAL(0)));
+
+  for (int i = 0; i < 8; i++) {
+    memory[i] = 11111111 * (i + 1);
+  }
+  for (uint32_t i = 0; i < 8; i++) {
+    CHECK_EQ(memory[i], r.Call(i * 4));
+  }
+  // Out-of-bounds addresses wrap around instead of trapping.
+  CHECK_EQ(memory[1], r.Call(36u));
+  CHECK_EQ(memory[2], r.Call(0x80000008u));
+  CHECK_EQ(memory[7], r.Call(0xFFFFFFFCu));
+}
+
+
+TEST(Run_Wasm_LoadMemI32_offset_masked) {
+  WasmRunner<int32_t> r(kMachUint32);
+  TestingModule module;
+  module.mem_masked = true;
+  int32_t* memory = module.AddMemoryElems<int32_t>(8);
+  r.env()->module = &module;
+
+  BUILD(r, WASM_LOAD_MEM_OFFSET(kMemI32, 8, WASM_GET_LOCAL(0)));
+
+  for (int i = 0; i < 8; i++) {
+    memory[i] = 11111111 * (i + 1);
+  }
+  CHECK_EQ(memory[2], r.Call(0u));
+  CHECK_EQ(memory[7], r.Call(20u));
+  // The offset is added before masking.
+  CHECK_EQ(memory[0], r.Call(24u));
+  CHECK_EQ(memory[0], r.Call(0xFFFFFFF8u));
+}
+
+
+TEST(Run_Wasm_StoreMemI32_masked) {
+  WasmRunner<int32_t> r(kMachUint32);
+  const int32_t kWritten = 0xaabbccdd;
+  TestingModule module;
+  module.mem_masked = true;
+  int32_t* memory = module.AddMemoryElems<int32_t>(8);
+  r.env()->module = &module;
+
+  BUILD(r, WASM_STORE_MEM(kMemI32, WASM_GET_LOCAL(0), WASM_I32(kWritten)));
+
+  static const uint32_t kAddresses[] = {4, 36, 0x80000004u, 0xFFFFFFE4u};
+  for (size_t i = 0; i < arraysize(kAddresses); i++) {
+    module.ZeroMemory();
+    CHECK_EQ(kWritten, r.Call(kAddresses[i]));
+    for (int j = 0; j < 8; j++) {
+      CHECK_EQ(j == 1 ? kWritten : 0, memory[j]);
+    }
+  }
+}
+
+
+TEST(Run_Wasm_LoadMemI32_4GB) {
+  if (kPointerSize < 8)
+    return;
+  static const size_t kSize = static_cast<size_t>(1) << 32;
+  base::SmartPointer<WasmMemory> memory(WasmMemory::Allocate(kSize));
+  CHECK(memory.get() != nullptr);
+  ModuleEnv module;
+  module.mem_start = reinterpret_cast<uintptr_t>(memory->start());
+  module.mem_end = reinterpret_cast<uintptr_t>(memory->end());
+  module.asm_js = false;
+
+  static const uint32_t kAddresses[] = {0x7ffffffcu, 0x80000000u,
+                                        0xfffffff0u, 0xfffffffcu};
+  for (size_t i = 0; i < arraysize(kAddresses); i++) {
+    *reinterpret_cast<int32_t*>(memory->start() + kAddresses[i]) =
+        static_cast<int32_t>(1000 + i);
+  }
+
+  {
+    WasmRunner<int32_t> r(kMachUint32);
+    r.env()->module = &module;
+    BUILD(r, WASM_LOAD_MEM(kMemI32, WASM_GET_LOCAL(0)));
+    for (size_t i = 0; i < arraysize(kAddresses); i++) {
+      CHECK_EQ(static_cast<int32_t>(1000 + i), r.Call(kAddresses[i]));
+    }
+    for (uint32_t index = 0xfffffffdu; index != 0; index++) {
+      CHECK_TRAP(r.Call(index));
+    }
+  }
+
+  {
+    // The offset is added to the index without wrapping around.
+    WasmRunner<int32_t> r(kMachUint32);
+    r.env()->module = &module;
+    BUILD(r, WASM_LOAD_MEM_OFFSET(kMemI32, 12, WASM_GET_LOCAL(0)));
+    CHECK_EQ(1003, r.Call(0xfffffff0u));
+    CHECK_EQ(1002, r.Call(0xffffffe4u));
+    CHECK_TRAP(r.Call(0xfffffff1u));
+    CHECK_TRAP(r.Call(0xfffffffcu));
+  }
+}
+
+
+TEST(Run_Wasm_AtomicLoadStoreMemI32) {
+  WasmRunner<int32_t> r(kMachUint32, kMachInt32);
+  TestingModule module;
+  int32_t* memory = module.AddMemoryElems<int32_t>(8);
+  r.env()->module = &module;
+
+  // Stores {p1} at {p0} and loads it back.
+  BUILD(r, WASM_BLOCK(2, WASM_ATOMIC_STORE_MEM(kMemI32, kRelease,
+                                               WASM_GET_LOCAL(0),
+                                               WASM_GET_LOCAL(1)),
+                      WASM_ATOMIC_LOAD_MEM(kMemI32, kAcquire,
+                                           WASM_GET_LOCAL(0))));
+
+  for (uint32_t i = 0; i < 8; i++) {
+    CHECK_EQ(static_cast<int32_t>(i * 1111), r.Call(i * 4, i * 1111));
+    CHECK_EQ(static_cast<int32_t>(i * 1111), memory[i]);
+  }
+  CHECK_TRAP(r.Call(2u, 0));
+  CHECK_TRAP(r.Call(32u, 0));
+  CHECK_TRAP(r.Call(0xFFFFFFFCu, 0));
+}
+
+
+TEST(Run_Wasm_AtomicSequentialLoadStoreMemI32) {
+  WasmRunner<int32_t> r(kMachUint32, kMachInt32);
+  TestingModule module;
+  int32_t* memory = module.AddMemoryElems<int32_t>(8);
+  r.env()->module = &module;
+
+  // Sequentially consistent stores and loads take different paths than
+  // release stores and acquire loads on some targets.
+  BUILD(r, WASM_BLOCK(2, WASM_ATOMIC_STORE_MEM(kMemI32, kSequential,
+                                               WASM_GET_LOCAL(0),
+                                               WASM_GET_LOCAL(1)),
+                      WASM_ATOMIC_LOAD_MEM(kMemI32, kSequential,
+                                           WASM_GET_LOCAL(0))));
+
+  for (uint32_t i = 0; i < 8; i++) {
+    int32_t value = static_cast<int32_t>(i) * -777;
+    CHECK_EQ(value, r.Call(i * 4, value));
+    CHECK_EQ(value, memory[i]);
+  }
+  CHECK_TRAP(r.Call(6u, 0));
+  CHECK_TRAP(r.Call(32u, 0));
+}
+
+
+TEST(Run_Wasm_AtomicMemI32) {
+  struct {
+    WasmOpcode opcode;
+    int32_t expected;  // the memory word after applying {operand}.
+  } kOps[] = {{kExprI32AtomicAdd, 0x12345678 + 0x0F0F},
+              {kExprI32AtomicSub, 0x12345678 - 0x0F0F},
+              {kExprI32AtomicAnd, 0x12345678 & 0x0F0F},
+              {kExprI32AtomicIor, 0x12345678 | 0x0F0F},
+              {kExprI32AtomicXor, 0x12345678 ^ 0x0F0F},
+              {kExprI32AtomicExchange, 0x0F0F}};
+
+  for (size_t i = 0; i < arraysize(kOps); i++) {
+    WasmRunner<int32_t> r(kMachUint32, kMachInt32);
+    TestingModule module;
+    int32_t* memory = module.AddMemoryElems<int32_t>(8);
+    r.env()->module = &module;
+    BUILD(r, static_cast<byte>(kOps[i].opcode), 0, WASM_GET_LOCAL(0),
+          WASM_GET_LOCAL(1));
+
+    memory[3] = 0x12345678;
+    // The old value is returned.
+    CHECK_EQ(0x12345678, r.Call(12u, 0x0F0F));
+    CHECK_EQ(kOps[i].expected, memory[3]);
+    CHECK_EQ(0, memory[2]);
+    CHECK_EQ(0, memory[4]);
+    CHECK_TRAP(r.Call(13u, 0));
+    CHECK_TRAP(r.Call(32u, 0));
+  }
+}
+
+
+TEST(Run_Wasm_AtomicCompareExchangeI32) {
+  WasmRunner<int32_t> r(kMachInt32, kMachInt32);
+  TestingModule module;
+  int32_t* memory = module.AddMemoryElems<int32_t>(8);
+  r.env()->module = &module;
+
+  // Replaces the word at 4 by {p1} if it equals {p0}.
+  BUILD(r, WASM_ATOMIC_CMPXCHG(WASM_I8(4), WASM_GET_LOCAL(0),
+                               WASM_GET_LOCAL(1)));
+
+  memory[1] = 77;
+  CHECK_EQ(77, r.Call(76, 100));
+  CHECK_EQ(77, memory[1]);
+  CHECK_EQ(77, r.Call(77, 100));
+  CHECK_EQ(100, memory[1]);
+  CHECK_EQ(100, r.Call(100, -5));
+  CHECK_EQ(-5, memory[1]);
+}
+
+
+TEST(Run_Wasm_AtomicMemI32_masked) {
+  WasmRunner<int32_t> r(kMachUint32);
+  TestingModule module;
+  module.mem_masked = true;
+  int32_t* memory = module.AddMemoryElems<int32_t>(8);
+  r.env()->module = &module;
+
+  BUILD(r, WASM_ATOMIC_MEM(Add, WASM_GET_LOCAL(0), WASM_ONE));
+
+  // Out-of-bounds addresses wrap around, but misaligned ones still trap.
+  CHECK_EQ(0, r.Call(36u));
+  CHECK_EQ(1, r.Call(0x80000004u));
+  CHECK_EQ(2, memory[1]);
+  CHECK_TRAP(r.Call(38u));
+  CHECK_EQ(2, memory[1]);
+}
+
+
 TEST(Run_Wasm_LoadMem_offset_oob) {
   TestingModule module;
   module.AddMemoryElems<int32_t>(8);
@@ -3111,8 +3326,6 @@ TEST(Run_Wasm_SimpleCallIndirect) {
 
   // Function table.
   int table_size = 2;
-  std::vector<uint16_t> function_table;
-  module.module->function_table = &function_table;
   module.module->function_table->push_back(0);
   module.module->function_table->push_back(1);
 
@@ -3155,8 +3368,6 @@ TEST(Run_Wasm_MultipleCallIndirect) {
 
   // Function table.
   int table_size = 2;
-  std::vector<uint16_t> function_table;
-  module.module->function_table = &function_table;
   module.module->function_table->push_back(0);
   module.module->function_table->push_back(1);
 
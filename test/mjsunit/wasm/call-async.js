@@ -0,0 +1,106 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+load("test/mjsunit/wasm/wasm-constants.js");
+
+var kMemSize = 65536;
+var kNameLogOffset = 71;
+var kNameAddOffset = 75;
+var kNameTwiceOffset = 79;
+var kNameLoadOffset = 85;
+var kNameNotifyOffset = 90;
+
+var data = bytes(
+  kDeclMemory, 3,                   // section size
+  16, 16, 0,                        // memory
+  // -- signatures
+  kDeclSignatures, 10,              // section size
+  3,
+  2, kAstI32, kAstI32, kAstI32,     // (int, int)->int
+  1, kAstF64, kAstF64,              // (double)->double
+  0, kAstStmt,                      // ()->void
+  // -- functions
+  kDeclFunctions, 51,               // section size
+  5,
+  // log: imported
+  kDeclFunctionName | kDeclFunctionImport,
+  2,                                // signature index
+  kNameLogOffset, 0, 0, 0,          // name offset
+  // add: a + b
+  kDeclFunctionName | kDeclFunctionExport,
+  0,                                // signature index
+  kNameAddOffset, 0, 0, 0,          // name offset
+  5,                                // code size
+  kExprI32Add, kExprGetLocal, 0, kExprGetLocal, 1,
+  // twice: x + x
+  kDeclFunctionName | kDeclFunctionExport,
+  1,                                // signature index
+  kNameTwiceOffset, 0, 0, 0,        // name offset
+  5,                                // code size
+  kExprF64Add, kExprGetLocal, 0, kExprGetLocal, 0,
+  // load: mem[a]
+  kDeclFunctionName | kDeclFunctionExport,
+  0,                                // signature index
+  kNameLoadOffset, 0, 0, 0,         // name offset
+  4,                                // code size
+  kExprI32LoadMem, 0, kExprGetLocal, 0,
+  // notify: calls the import
+  kDeclFunctionName | kDeclFunctionExport,
+  2,                                // signature index
+  kNameNotifyOffset, 0, 0, 0,       // name offset
+  2,                                // code size
+  kExprCallFunction, 0,
+  kDeclEnd,
+  'l', 'o', 'g', 0,
+  'a', 'd', 'd', 0,
+  't', 'w', 'i', 'c', 'e', 0,
+  'l', 'o', 'a', 'd', 0,
+  'n', 'o', 't', 'i', 'f', 'y', 0
+);
+
+var ffi = {log: function() {}};
+var module = WASM.instantiateModule(data, ffi, null, {parallel: true});
+
+// The instance stays busy until the promise settles.
+var promise = WASM.callAsync(module, "add", [40, 2]);
+assertInstanceof(promise, Promise);
+assertThrows(function() { WASM.callAsync(module, "add", [1, 2]); });
+assertThrows(function() { WASM.parallelFor(module, "add", 0, 1, 1); });
+assertTraps(kTrapInstanceBusy, function() { module.add(1, 2); });
+assertTraps(kTrapInstanceBusy, function() { module.twice(1); });
+promise.then(function(result) {
+  assertEquals(42, result);
+  assertEquals(3, module.add(1, 2));
+
+  // Arguments are converted like those of the exported function.
+  return WASM.callAsync(module, "twice", ["1.25"]);
+}).then(function(result) {
+  assertEquals(2.5, result);
+  return WASM.callAsync(module, "add", [0x7fffffff, 1]);
+}).then(function(result) {
+  assertEquals(-0x80000000, result);
+  return WASM.callAsync(module, "add", [3]);
+}).then(function(result) {
+  assertEquals(3, result);
+
+  // Traps reject the promise with the trap message.
+  return WASM.callAsync(module, "load", [kMemSize]);
+}).then(assertUnreachable, function(error) {
+  assertEquals(kTrapMsgs[kTrapMemOutOfBounds], error);
+  return WASM.callAsync(module, "load", [0]);
+}).then(function(result) {
+  assertEquals(0, result);
+});
+
+// Exports that reach imports cannot run on native threads.
+var idle = WASM.instantiateModule(data, ffi, null, {parallel: true});
+assertThrows(function() { WASM.callAsync(idle, "notify"); });
+assertThrows(function() { WASM.callAsync(idle, "log"); });
+assertThrows(function() { WASM.callAsync(idle, "missing"); });
+assertThrows(function() { WASM.callAsync(idle, "add", 1); });
+assertEquals(3, idle.add(1, 2));
+
+// Native exports must be requested at instantiation.
+var plain = WASM.instantiateModule(data, ffi);
+assertThrows(function() { WASM.callAsync(plain, "add", [1, 2]); });
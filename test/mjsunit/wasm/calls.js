@@ -6,21 +6,23 @@ load("test/mjsunit/wasm/wasm-constants.js");
 
 var module = (function () {
   var kBodySize = 5;
-  var kNameOffset = 21 + kBodySize + 1;
+  var kNameOffset = 22 + kBodySize + 1;
 
   return WASM.instantiateModule(bytes(
     // -- memory
-    kDeclMemory,
+    kDeclMemory, 3,               // section size
     12, 12, 1,
     // -- signatures
-    kDeclSignatures, 1,
+    kDeclSignatures, 5,           // section size
+    1,
     2, kAstI32, kAstI32, kAstI32, // int, int -> int
     // -- functions
-    kDeclFunctions, 1,
+    kDeclFunctions, 8 + kBodySize,
+    1,
     kDeclFunctionName | kDeclFunctionExport,
-    0, 0,
+    0,
     kNameOffset, 0, 0, 0,         // name offset
-    kBodySize, 0,
+    kBodySize,
     // -- body
     kExprI32Sub,                  // --
     kExprGetLocal, 0,             // --
@@ -60,21 +62,23 @@ assertEquals(-5555555, module.sub(3333333, 8888888));
 
 var module = (function() {
   var kBodySize = 1;
-  var kNameOffset2 = 19 + kBodySize + 1;
+  var kNameOffset2 = 20 + kBodySize + 1;
 
   return WASM.instantiateModule(bytes(
     // -- memory
-    kDeclMemory,
+    kDeclMemory, 3,             // section size
     12, 12, 1,
     // -- signatures
-    kDeclSignatures, 1,
+    kDeclSignatures, 3,         // section size
+    1,
     0, kAstStmt,                // signature: void -> void
     // -- functions
-    kDeclFunctions, 1,
+    kDeclFunctions, 8 + kBodySize,
+    1,
     kDeclFunctionName | kDeclFunctionExport,
-    0, 0,                       // signature index
+    0,                          // signature index
     kNameOffset2, 0, 0, 0,      // name offset
-    kBodySize, 0,
+    kBodySize,
     kExprNop,                   // body
     kDeclEnd,
     'n', 'o', 'p', 0            // name
@@ -111,21 +115,23 @@ assertEquals(undefined, module.nop());
 
 (function testLt() {
   var kBodySize = 5;
-  var kNameOffset = 21 + kBodySize + 1;
+  var kNameOffset = 22 + kBodySize + 1;
 
   var data = bytes(
     // -- memory
-    kDeclMemory,
+    kDeclMemory, 3,               // section size
     12, 12, 1,
     // -- signatures
-    kDeclSignatures, 1,
+    kDeclSignatures, 5,           // section size
+    1,
     2, kAstI32, kAstF64, kAstF64, // (f64,f64)->int
     // -- functions
-    kDeclFunctions, 1,
+    kDeclFunctions, 8 + kBodySize,
+    1,
     kDeclFunctionName | kDeclFunctionExport,
-    0, 0,                         // signature index
+    0,                            // signature index
     kNameOffset, 0, 0, 0,         // name offset
-    kBodySize, 0,
+    kBodySize,
     // -- body
     kExprF64Lt,                   // --
     kExprGetLocal, 0,             // --
@@ -11,14 +11,16 @@ var kNameOffset = 15 + kBodySize + 1;
 
 var data = bytes(
   // -- signatures
-  kDeclSignatures, 1,
+  kDeclSignatures, 3,         // section size
+  1,
   0, kAstI32,                 // signature: void -> int
   // -- main function
-  kDeclFunctions, 1,
+  kDeclFunctions, 8 + kBodySize,
+  1,
   kDeclFunctionName | kDeclFunctionExport,
-  0, 0,                       // signature index
+  0,                          // signature index
   kNameOffset, 0, 0, 0,       // name offset
-  kBodySize, 0,               // body size
+  kBodySize,                  // body size
   // -- body
   kExprI8Const,               // --
   kReturnValue,               // --
@@ -0,0 +1,119 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Flags: --expose-gc
+
+load("test/mjsunit/wasm/wasm-constants.js");
+
+var kMemSize = 65536;
+
+// Exports add(a, b) = a + b and load(a, b) = mem[a].
+var kNameAddOffset = 39;
+var kNameLoadOffset = 43;
+
+var exporter = bytes(
+  kDeclMemory, 3,                   // section size
+  16, 16, kDeclMemoryExport,        // memory
+  // -- signatures
+  kDeclSignatures, 5,               // section size
+  1,
+  2, kAstI32, kAstI32, kAstI32,     // (int, int)->int
+  // -- functions
+  kDeclFunctions, 24,               // section size
+  2,
+  kDeclFunctionName | kDeclFunctionExport,
+  0,                                // signature index
+  kNameAddOffset, 0, 0, 0,          // name offset
+  5,                                // code size
+  kExprI32Add, kExprGetLocal, 0, kExprGetLocal, 1,
+  kDeclFunctionName | kDeclFunctionExport,
+  0,                                // signature index
+  kNameLoadOffset, 0, 0, 0,         // name offset
+  4,                                // code size
+  kExprI32LoadMem, 0, kExprGetLocal, 0,
+  kDeclEnd,
+  'a', 'd', 'd', 0,
+  'l', 'o', 'a', 'd', 0
+);
+
+// Imports add, load and twice, and exports functions calling each of them.
+var kImportAddOffset = 74;
+var kImportLoadOffset = 78;
+var kImportTwiceOffset = 83;
+var kNameCallAddOffset = 89;
+var kNameCallLoadOffset = 97;
+var kNameCallTwiceOffset = 106;
+
+var importer = bytes(
+  kDeclMemory, 3,                   // section size
+  16, 16, 0,                        // memory
+  // -- signatures
+  kDeclSignatures, 8,               // section size
+  2,
+  2, kAstI32, kAstI32, kAstI32,     // (int, int)->int
+  1, kAstF64, kAstF64,              // (double)->double
+  // -- functions
+  kDeclFunctions, 56,               // section size
+  6,
+  kDeclFunctionName | kDeclFunctionImport,
+  0,                                // signature index
+  kImportAddOffset, 0, 0, 0,        // name offset
+  kDeclFunctionName | kDeclFunctionImport,
+  0,                                // signature index
+  kImportLoadOffset, 0, 0, 0,       // name offset
+  kDeclFunctionName | kDeclFunctionImport,
+  1,                                // signature index
+  kImportTwiceOffset, 0, 0, 0,      // name offset
+  kDeclFunctionName | kDeclFunctionExport,
+  0,                                // signature index
+  kNameCallAddOffset, 0, 0, 0,      // name offset
+  6,                                // code size
+  kExprCallFunction, 0, kExprGetLocal, 0, kExprGetLocal, 1,
+  kDeclFunctionName | kDeclFunctionExport,
+  0,                                // signature index
+  kNameCallLoadOffset, 0, 0, 0,     // name offset
+  6,                                // code size
+  kExprCallFunction, 1, kExprGetLocal, 0, kExprGetLocal, 1,
+  kDeclFunctionName | kDeclFunctionExport,
+  1,                                // signature index
+  kNameCallTwiceOffset, 0, 0, 0,    // name offset
+  4,                                // code size
+  kExprCallFunction, 2, kExprGetLocal, 0,
+  kDeclEnd,
+  'a', 'd', 'd', 0,
+  'l', 'o', 'a', 'd', 0,
+  't', 'w', 'i', 'c', 'e', 0,
+  'c', 'a', 'l', 'l', 'A', 'd', 'd', 0,
+  'c', 'a', 'l', 'l', 'L', 'o', 'a', 'd', 0,
+  'c', 'a', 'l', 'l', 'T', 'w', 'i', 'c', 'e', 0
+);
+
+var first = WASM.instantiateModule(exporter);
+var second = WASM.instantiateModule(importer,
+    {add: first.add, load: first.load, twice: first.add});
+
+// Calls reach the exporting instance and use its memory.
+assertEquals(42, second.callAdd(40, 2));
+assertEquals(-0x80000000, second.callAdd(0x7fffffff, 1));
+new Int32Array(first.memory)[1] = 77;
+assertEquals(77, second.callLoad(4, 0));
+assertEquals(0, second.callLoad(8, 0));
+
+// Traps in the exporting instance propagate through the call.
+assertTraps(kTrapMemOutOfBounds, function() { second.callLoad(kMemSize, 0); });
+
+// Exports of a different signature are called through JavaScript.
+assertEquals(1, second.callTwice(1.5));
+
+// The importing instance keeps the exporting instance alive.
+function instantiateWithTemporaryExporter() {
+  var temporary = WASM.instantiateModule(exporter);
+  new Int32Array(temporary.memory)[2] = 99;
+  return WASM.instantiateModule(importer,
+      {add: temporary.add, load: temporary.load, twice: temporary.add});
+}
+var third = instantiateWithTemporaryExporter();
+gc();
+assertEquals(99, third.callLoad(8, 0));
+assertEquals(7, third.callAdd(3, 4));
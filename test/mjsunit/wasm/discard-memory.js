@@ -0,0 +1,48 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+load("test/mjsunit/wasm/wasm-constants.js");
+
+// Offsets are multiples of 64kb so that they are page-aligned everywhere.
+var kMemSize = 4 * 65536;
+var kDiscardOffset = 65536;
+var kDiscardSize = 65536;
+
+var data = bytes(
+  kDeclMemory, 3,                   // section size
+  18, 18, 1,                        // memory
+  kDeclEnd
+);
+
+var module = WASM.instantiateModule(data);
+var array = new Uint8Array(module.memory);
+assertEquals(kMemSize, array.length);
+
+for (var i = 0; i < kMemSize; i += 256) {
+  array[i] = 0x55;
+}
+array[kDiscardOffset - 1] = 0x66;
+array[kDiscardOffset + kDiscardSize] = 0x77;
+
+WASM.discardMemory(module, kDiscardOffset, kDiscardSize);
+
+for (var i = kDiscardOffset; i < kDiscardOffset + kDiscardSize; i += 256) {
+  assertEquals(0, array[i]);
+}
+assertEquals(0x66, array[kDiscardOffset - 1]);
+assertEquals(0x77, array[kDiscardOffset + kDiscardSize]);
+assertEquals(0x55, array[0]);
+
+// The discarded range is usable again.
+array[kDiscardOffset] = 0x11;
+assertEquals(0x11, array[kDiscardOffset]);
+
+// Unaligned and out-of-bounds ranges are rejected.
+assertThrows(function() { WASM.discardMemory(module, 1, kDiscardSize); });
+assertThrows(function() { WASM.discardMemory(module, 0, 1); });
+assertThrows(function() {
+  WASM.discardMemory(module, kMemSize - kDiscardSize, 2 * kDiscardSize);
+});
+assertThrows(function() { WASM.discardMemory({}, 0, kDiscardSize); });
+assertEquals(0x11, array[kDiscardOffset]);
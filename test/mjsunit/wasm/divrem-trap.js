@@ -31,18 +31,20 @@ function assertTraps(code, msg) {
 
 function makeDivRem(opcode) {
   var kBodySize = 5;
-  var kNameMainOffset = 6 + 11 + kBodySize + 1;
+  var kNameMainOffset = 7 + 10 + kBodySize + 1;
 
   var data = bytes(
     // signatures
-    kDeclSignatures, 1,
+    kDeclSignatures, 5,           // section size
+    1,
     2, kAstI32, kAstI32, kAstI32, // (int,int) -> int
     // -- main function
-    kDeclFunctions, 1,
+    kDeclFunctions, 8 + kBodySize,
+    1,
     kDeclFunctionName | kDeclFunctionExport,
-    0, 0,
+    0,
     kNameMainOffset, 0, 0, 0,   // name offset
-    kBodySize, 0,
+    kBodySize,
     // main body
     opcode,                     // --
     kExprGetLocal, 0,           // --
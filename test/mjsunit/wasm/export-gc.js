@@ -0,0 +1,69 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Flags: --expose-gc --stress-compaction
+
+load("test/mjsunit/wasm/wasm-constants.js");
+
+var kSegmentDest = 8;
+var kSegmentOffset = 55;
+var kNameBumpOffset = kSegmentOffset + 4;
+var kSegmentValue = 0x44332211;
+
+var data = bytes(
+  kDeclMemory, 3,                   // section size
+  12, 12, 0,                        // memory, not exported
+  // -- signatures
+  kDeclSignatures, 3,               // section size
+  1,
+  0, kAstI32,                       // void->int
+  // -- globals
+  kDeclGlobals, 7,                  // section size
+  1,
+  0, 0, 0, 0, kMemI32, 0,           // global#0
+  // -- functions
+  kDeclFunctions, 17,               // section size
+  1,
+  kDeclFunctionName | kDeclFunctionExport,
+  0,                                // signature index
+  kNameBumpOffset, 0, 0, 0,         // name offset
+  9,                                // body size
+  // bump: return global0 = global0 + mem[8]
+  kExprStoreGlobal, 0,
+    kExprI32Add,
+      kExprLoadGlobal, 0,
+      kExprI32LoadMem, 0, kExprI8Const, kSegmentDest,
+  // -- data segments
+  kDeclDataSegments, 14,            // section size
+  1,
+  kSegmentDest, 0, 0, 0,            // dest addr
+  kSegmentOffset, 0, 0, 0,          // source offset
+  4, 0, 0, 0,                       // source size
+  1,                                // init
+  kDeclEnd,
+  0x11, 0x22, 0x33, 0x44,           // data segment bytes
+  'b', 'u', 'm', 'p', 0             // --
+);
+
+// Only the export survives; the instance object, its memory and its globals
+// must stay alive as long as the export does.
+function instantiateExportOnly() {
+  return WASM.instantiateModule(data).bump;
+}
+
+function testExportKeepsInstanceAlive() {
+  var bump = instantiateExportOnly();
+  gc();
+  gc();
+  for (var i = 1; i <= 5; i++) {
+    // Allocate array buffers that would reuse freed memory or globals.
+    var garbage = [new ArrayBuffer(4096), new ArrayBuffer(4096)];
+    assertEquals(Math.imul(kSegmentValue, i), bump());
+    garbage = null;
+    gc();
+  }
+}
+
+testExportKeepsInstanceAlive();
+testExportKeepsInstanceAlive();
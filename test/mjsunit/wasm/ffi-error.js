@@ -10,21 +10,23 @@ function testCallFFI(ffi) {
   var kNameMainOffset = kNameAddOffset + 4;
 
   var data = bytes(
-    kDeclMemory,
+    kDeclMemory, 3,             // section size
     12, 12, 1,                  // memory
     // -- signatures
-    kDeclSignatures, 1,
+    kDeclSignatures, 5,         // section size
+    1,
     2, kAstI32, kAstF64, kAstF64, // (f64,f64)->int
     // -- foreign function
-    kDeclFunctions, 2,
+    kDeclFunctions, 14 + kBodySize,
+    2,
     kDeclFunctionName | kDeclFunctionImport,
-    0, 0,                       // signature index
+    0,                          // signature index
     kNameAddOffset, 0, 0, 0,    // name offset
     // -- main function
     kDeclFunctionName | kDeclFunctionExport,
-    0, 0,                       // signature index
+    0,                          // signature index
     kNameMainOffset, 0, 0, 0,   // name offset
-    kBodySize, 0,
+    kBodySize,
     // main body
     kExprCallFunction, 0,       // --
     kExprGetLocal, 0,           // --
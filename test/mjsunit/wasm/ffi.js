@@ -6,7 +6,7 @@ load("test/mjsunit/wasm/wasm-constants.js");
 
 function testCallFFI(func, check) {
   var kBodySize = 6;
-  var kNameFunOffset = 24 + kBodySize + 1;
+  var kNameFunOffset = 23 + kBodySize + 1;
   var kNameMainOffset = kNameFunOffset + 4;
 
   var ffi = new Object();
@@ -14,18 +14,20 @@ function testCallFFI(func, check) {
 
   var data = bytes(
     // signatures
-    kDeclSignatures, 1,
+    kDeclSignatures, 5,           // section size
+    1,
     2, kAstI32, kAstF64, kAstF64, // (f64,f64) -> int
     // -- foreign function
-    kDeclFunctions, 2,
+    kDeclFunctions, 14 + kBodySize,
+    2,
     kDeclFunctionName | kDeclFunctionImport,
-    0, 0,
+    0,
     kNameFunOffset, 0, 0, 0,    // name offset
     // -- main function
     kDeclFunctionName | kDeclFunctionExport,
-    0, 0,
+    0,
     kNameMainOffset, 0, 0, 0,   // name offset
-    kBodySize, 0,
+    kBodySize,
     // main body
     kExprCallFunction, 0,       // --
     kExprGetLocal, 0,           // --
@@ -188,7 +190,7 @@ testCallFFI(returnValue(objWithValueOf), checkReturn(198));
 
 function testCallBinopVoid(type, func, check) {
   var kBodySize = 10;
-  var kNameFunOffset = 28 + kBodySize + 1;
+  var kNameFunOffset = 27 + kBodySize + 1;
   var kNameMainOffset = kNameFunOffset + 4;
 
   var ffi = new Object();
@@ -209,19 +211,21 @@ function testCallBinopVoid(type, func, check) {
 
   var data = bytes(
     // -- signatures
-    kDeclSignatures, 2,
+    kDeclSignatures, 9,         // section size
+    2,
     2, kAstStmt, type, type,    // (type,type)->void
     2, kAstI32, type, type,     // (type,type)->int
     // -- foreign function
-    kDeclFunctions, 2,
+    kDeclFunctions, 14 + kBodySize,
+    2,
     kDeclFunctionName | kDeclFunctionImport,
-    0, 0,                       // signature index
+    0,                          // signature index
     kNameFunOffset, 0, 0, 0,    // name offset
     // -- main function
     kDeclFunctionName | kDeclFunctionExport,
-    1, 0,                       // signature index
+    1,                          // signature index
     kNameMainOffset, 0, 0, 0,   // name offset
-    kBodySize, 0,               // body size
+    kBodySize,                  // body size
     // main body
     kExprBlock, 2,              // --
     kExprCallFunction, 0,       // --
@@ -281,7 +285,7 @@ testCallBinopVoid(kAstF64);
 
 function testCallPrint() {
   var kBodySize = 10;
-  var kNamePrintOffset = 10 + 7 + 7 + 9 + kBodySize + 1;
+  var kNamePrintOffset = 12 + 6 + 6 + 7 + kBodySize + 1;
   var kNameMainOffset = kNamePrintOffset + 6;
 
   var ffi = new Object();
@@ -289,23 +293,25 @@ function testCallPrint() {
 
   var data = bytes(
     // -- signatures
-    kDeclSignatures, 2,
+    kDeclSignatures, 7,         // section size
+    2,
     1, kAstStmt, kAstI32,       // i32->void
     1, kAstStmt, kAstF64,       // f64->int
-    kDeclFunctions, 3,
+    kDeclFunctions, 20 + kBodySize,
+    3,
     // -- import print i32
     kDeclFunctionName | kDeclFunctionImport,
-    0, 0,                       // signature index
+    0,                          // signature index
     kNamePrintOffset, 0, 0, 0,  // name offset
     // -- import print f64
     kDeclFunctionName | kDeclFunctionImport,
-    1, 0,                       // signature index
+    1,                          // signature index
     kNamePrintOffset, 0, 0, 0,  // name offset
     // -- decl main
     kDeclFunctionName | kDeclFunctionExport,
-    1, 0,                       // signature index
+    1,                          // signature index
     kNameMainOffset, 0, 0, 0,   // name offset
-    kBodySize, 0,               // body size
+    kBodySize,                  // body size
     // main body
     kExprBlock, 2,              // --
     kExprCallFunction, 0,       // --
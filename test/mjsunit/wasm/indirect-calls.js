@@ -5,12 +5,13 @@
 load("test/mjsunit/wasm/wasm-constants.js");
 
 var module = (function () {
-  var kFuncWithBody = 9;
-  var kFuncImported = 7;
+  var kFuncWithBody = 7;
+  var kFuncImported = 6;
   var kBodySize1 = 5;
   var kBodySize2 = 8;
-  var kFuncTableSize = 8;
-  var kSubOffset = 13 + kFuncWithBody + kBodySize1 + kFuncImported + kFuncWithBody + kBodySize2 + kFuncTableSize + 1;
+  var kFuncTableSize = 6;
+  var kFuncsSize = kFuncWithBody + kBodySize1 + kFuncImported + kFuncWithBody + kBodySize2;
+  var kSubOffset = 15 + kFuncsSize + kFuncTableSize + 1;
   var kAddOffset = kSubOffset + 4;
   var kMainOffset = kAddOffset + 4;
 
@@ -19,37 +20,39 @@ var module = (function () {
 
   return WASM.instantiateModule(bytes(
     // -- signatures
-    kDeclSignatures, 2,
+    kDeclSignatures, 10,          // section size
+    2,
     2, kAstI32, kAstI32, kAstI32, // int, int -> int
     3, kAstI32, kAstI32, kAstI32, kAstI32, // int, int, int -> int
     // -- function #0 (sub)
-    kDeclFunctions, 3,
+    kDeclFunctions, 1 + kFuncsSize,
+    3,
     kDeclFunctionName,
-    0, 0,                         // signature offset
+    0,                            // signature offset
     kSubOffset, 0, 0, 0,          // name offset
-    kBodySize1, 0,                // body size
+    kBodySize1,                   // body size
     kExprI32Sub,                  // --
     kExprGetLocal, 0,             // --
     kExprGetLocal, 1,             // --
     // -- function #1 (add)
     kDeclFunctionName | kDeclFunctionImport,
-    0, 0,                         // signature offset
+    0,                            // signature offset
     kAddOffset, 0, 0, 0,          // name offset
     // -- function #2 (main)
     kDeclFunctionName | kDeclFunctionExport,
-    1, 0,                         // signature offset
+    1,                            // signature offset
     kMainOffset, 0, 0, 0,         // name offset
-    kBodySize2, 0,                // body size
+    kBodySize2,                   // body size
     kExprCallIndirect, 0,
     kExprGetLocal, 0,
     kExprGetLocal, 1,
     kExprGetLocal, 2,
     // -- function table
-    kDeclFunctionTable,
+    kDeclFunctionTable, kFuncTableSize - 2,
     3,
-    0, 0,
-    1, 0,
-    2, 0,
+    0,
+    1,
+    2,
     kDeclEnd,
     's', 'u', 'b', 0,              // name
     'a', 'd', 'd', 0,              // name
@@ -0,0 +1,56 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+load("test/mjsunit/wasm/wasm-constants.js");
+
+// instantiate-file.wasm holds exactly these bytes: main() = mem[12], with a
+// data segment storing 0x44332211 there.
+var kModuleFile = "test/mjsunit/wasm/instantiate-file.wasm";
+var kNameMainOffset = 41;
+var kDataSegmentOffset = 46;
+
+var data = bytes(
+  kDeclMemory, 3,                   // section size
+  16, 16, 0,                        // memory
+  // -- signatures
+  kDeclSignatures, 3,               // section size
+  1,
+  0, kAstI32,                       // ()->int
+  // -- functions
+  kDeclFunctions, 12,               // section size
+  1,
+  kDeclFunctionName | kDeclFunctionExport,
+  0,                                // signature index
+  kNameMainOffset, 0, 0, 0,         // name offset
+  4,                                // code size
+  kExprI32LoadMem, 0, kExprI8Const, 12,
+  // -- data segments
+  kDeclDataSegments, 14,            // section size
+  1,
+  12, 0, 0, 0,                      // dest addr
+  kDataSegmentOffset, 0, 0, 0,      // source offset
+  4, 0, 0, 0,                       // source size
+  1,                                // init
+  kDeclEnd,
+  'm', 'a', 'i', 'n', 0,
+  0x11, 0x22, 0x33, 0x44
+);
+
+assertEquals(Array.from(new Uint8Array(data)),
+             Array.from(new Uint8Array(readbuffer(kModuleFile))));
+
+var module = WASM.instantiateFile(kModuleFile);
+assertEquals(0x44332211, module.main());
+assertEquals(WASM.instantiateModule(data).main(), module.main());
+
+// Instances of the same file are independent.
+var other = WASM.instantiateFile(kModuleFile, {}, null);
+assertFalse(module === other);
+assertEquals(0x44332211, other.main());
+
+assertThrows(function() {
+  WASM.instantiateFile("test/mjsunit/wasm/no-such-file.wasm");
+});
+assertThrows(function() { WASM.instantiateFile(); });
+assertThrows(function() { WASM.instantiateFile(data); });
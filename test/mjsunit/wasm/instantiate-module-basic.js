@@ -7,21 +7,23 @@ load("test/mjsunit/wasm/wasm-constants.js");
 var kReturnValue = 117;
 
 var kBodySize = 2;
-var kNameOffset = 19 + kBodySize + 1;
+var kNameOffset = 20 + kBodySize + 1;
 
 var data = bytes(
   // -- memory
-  kDeclMemory,
+  kDeclMemory, 3,             // section size
   10, 10, 1,
   // -- signatures
-  kDeclSignatures, 1,
+  kDeclSignatures, 3,         // section size
+  1,
   0, kAstI32,                 // signature: void -> int
   // -- main function
-  kDeclFunctions, 1,
+  kDeclFunctions, 8 + kBodySize,
+  1,
   kDeclFunctionName | kDeclFunctionExport,
-  0, 0,                       // signature index
+  0,                          // signature index
   kNameOffset, 0, 0, 0,       // name offset
-  kBodySize, 0,               // body size
+  kBodySize,                  // body size
   // -- body
   kExprI8Const,               // --
   kReturnValue,               // --
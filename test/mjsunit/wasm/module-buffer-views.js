@@ -0,0 +1,58 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+load("test/mjsunit/wasm/wasm-constants.js");
+
+var kReturnValue = 88;
+
+var kBodySize = 2;
+var kNameOffset = 15 + kBodySize + 1;
+
+var module = bytes(
+  // -- signatures
+  kDeclSignatures, 3,         // section size
+  1,
+  0, kAstI32,                 // signature: void -> int
+  // -- main function
+  kDeclFunctions, 8 + kBodySize,
+  1,
+  kDeclFunctionName | kDeclFunctionExport,
+  0,                          // signature index
+  kNameOffset, 0, 0, 0,       // name offset
+  kBodySize,                  // body size
+  // -- body
+  kExprI8Const,               // --
+  kReturnValue,               // --
+  kDeclEnd,
+  'm', 'a', 'i', 'n', 0       // name
+);
+
+// Embed the module in the middle of a larger buffer.
+var kPrefix = 13;
+var kSuffix = 7;
+var bundle = new ArrayBuffer(kPrefix + module.byteLength + kSuffix);
+new Uint8Array(bundle).fill(0xff);
+new Uint8Array(bundle, kPrefix).set(new Uint8Array(module));
+
+function view(type) {
+  return new type(bundle, kPrefix, module.byteLength / type.BYTES_PER_ELEMENT);
+}
+
+assertEquals(kReturnValue, WASM.compileRun(view(Uint8Array)));
+assertEquals(kReturnValue, WASM.compileRun(view(Int8Array)));
+assertEquals(kReturnValue,
+             WASM.compileRun(new DataView(bundle, kPrefix, module.byteLength)));
+assertEquals(kReturnValue, WASM.instantiateModule(view(Uint8Array)).main());
+WASM.verifyModule(view(Uint8Array));
+
+// The bundle is neither copied out nor externalized.
+assertEquals(kPrefix + module.byteLength + kSuffix, bundle.byteLength);
+
+// Views that cut the module short fail to decode.
+assertThrows(function() {
+  WASM.verifyModule(new Uint8Array(bundle, kPrefix, module.byteLength - 6));
+});
+assertThrows(function() {
+  WASM.verifyModule(new Uint8Array(bundle, kPrefix, 0));
+});
@@ -10,24 +10,26 @@ var kMemSize = 4096;
 
 function genModule(memory) {
   var kBodySize = 27;
-  var kNameMainOffset = 28 + kBodySize + 1;
+  var kNameMainOffset = 29 + kBodySize + 1;
 
   var data = bytes(
-    kDeclMemory,
+    kDeclMemory, 3,             // section size
     12, 12, 1,                  // memory
     // -- signatures
-    kDeclSignatures, 1,
+    kDeclSignatures, 4,         // section size
+    1,
     1, kAstI32, kAstI32,        // int->int
     // -- main function
-    kDeclFunctions, 1,
+    kDeclFunctions, 16 + kBodySize,
+    1,
     kDeclFunctionLocals | kDeclFunctionName | kDeclFunctionExport,
-    0, 0,
+    0,
     kNameMainOffset, 0, 0, 0,   // name offset
     1, 0,                       // local int32 count
     0, 0,                       // local int64 count
     0, 0,                       // local float32 count
     0, 0,                       // local float64 count
-    kBodySize, 0,               // code size
+    kBodySize,                  // code size
     // main body: while(i) { if(mem[i]) return -1; i -= 4; } return 0;
     kExprBlock,2,
       kExprLoop,1,
@@ -133,24 +135,26 @@ testOuterMemorySurvivalAcrossGc();
 
 function testOOBThrows() {
   var kBodySize = 8;
-  var kNameMainOffset = 29 + kBodySize + 1;
+  var kNameMainOffset = 30 + kBodySize + 1;
 
   var data = bytes(
-    kDeclMemory,
+    kDeclMemory, 3,                // section size
     12, 12, 1,                     // memory = 4KB
     // -- signatures
-    kDeclSignatures, 1,
+    kDeclSignatures, 5,            // section size
+    1,
     2, kAstI32, kAstI32, kAstI32,  // int->int
     // -- main function
-    kDeclFunctions, 1,
+    kDeclFunctions, 16 + kBodySize,
+    1,
     kDeclFunctionLocals | kDeclFunctionName | kDeclFunctionExport,
-    0, 0,
+    0,
     kNameMainOffset, 0, 0, 0,      // name offset
     1, 0,                          // local int32 count
     0, 0,                          // local int64 count
     0, 0,                          // local float32 count
     0, 0,                          // local float64 count
-    kBodySize, 0,                  // code size
+    kBodySize,                     // code size
     // geti: return mem[a] = mem[b]
     kExprI32StoreMem, 0, kExprGetLocal, 0, kExprI32LoadMem, 0, kExprGetLocal, 1,
     // names
@@ -0,0 +1,91 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+load("test/mjsunit/wasm/wasm-constants.js");
+
+var kMemSize = 65536;
+var kWords = kMemSize / 4;
+var kBodySize = 31;
+var kNameLogOffset = 71;
+var kNameFillOffset = 75;
+var kNameNotifyOffset = 80;
+
+var data = bytes(
+  kDeclMemory, 3,                   // section size
+  16, 16, kDeclMemoryExport,        // memory
+  // -- signatures
+  kDeclSignatures, 7,               // section size
+  2,
+  2, kAstStmt, kAstI32, kAstI32,    // (int, int)->void
+  0, kAstStmt,                      // ()->void
+  // -- functions
+  kDeclFunctions, 54,               // section size
+  3,
+  // log: imported
+  kDeclFunctionName | kDeclFunctionImport,
+  1,                                // signature index
+  kNameLogOffset, 0, 0, 0,          // name offset
+  // fill: while (i < end) { mem[i] = i * 3; i++; }
+  kDeclFunctionName | kDeclFunctionExport,
+  0,                                // signature index
+  kNameFillOffset, 0, 0, 0,         // name offset
+  kBodySize,                        // code size
+  kExprLoop, 1,
+    kExprIf,
+      kExprI32LtS, kExprGetLocal, 0, kExprGetLocal, 1,
+      kExprBr, 0,
+        kExprBlock, 2,
+          kExprI32StoreMem, 0,
+            kExprI32Shl, kExprGetLocal, 0, kExprI8Const, 2,
+            kExprI32Mul, kExprGetLocal, 0, kExprI8Const, 3,
+          kExprSetLocal, 0, kExprI32Add, kExprGetLocal, 0, kExprI8Const, 1,
+  // notify: calls the import
+  kDeclFunctionName | kDeclFunctionExport,
+  0,                                // signature index
+  kNameNotifyOffset, 0, 0, 0,       // name offset
+  2,                                // code size
+  kExprCallFunction, 0,
+  kDeclEnd,
+  'l', 'o', 'g', 0,
+  'f', 'i', 'l', 'l', 0,
+  'n', 'o', 't', 'i', 'f', 'y', 0
+);
+
+var ffi = {log: function() {}};
+var module = WASM.instantiateModule(data, ffi, null, {parallel: true});
+var words = new Int32Array(module.memory);
+
+// The kernel covers the whole range, whatever the grain.
+[1, 7, 100, kWords].forEach(function(grain) {
+  for (var i = 0; i < kWords; i++) words[i] = -1;
+  WASM.parallelFor(module, "fill", 0, kWords, grain);
+  for (var i = 0; i < kWords; i++) assertEquals(i * 3, words[i]);
+});
+
+// An empty range runs nothing.
+words[5] = -1;
+WASM.parallelFor(module, "fill", 5, 5, 1);
+assertEquals(-1, words[5]);
+
+// The export stays callable from JavaScript.
+module.fill(5, 6);
+assertEquals(15, words[5]);
+
+// Traps are rethrown on the calling thread.
+assertTraps(kTrapMemOutOfBounds, function() {
+  WASM.parallelFor(module, "fill", kWords - 64, kWords + 64, 16);
+});
+WASM.parallelFor(module, "fill", 0, 16, 4);
+
+// Exports that reach imports cannot run on native threads.
+assertThrows(function() { WASM.parallelFor(module, "notify", 0, 16, 1); });
+assertThrows(function() { WASM.parallelFor(module, "log", 0, 16, 1); });
+assertThrows(function() { WASM.parallelFor(module, "missing", 0, 16, 1); });
+assertThrows(function() { WASM.parallelFor(module, "fill", 16, 0, 1); });
+assertThrows(function() { WASM.parallelFor(module, "fill", 0, 16, 0); });
+
+// Parallel exports must be requested at instantiation.
+var plain = WASM.instantiateModule(data, ffi);
+assertThrows(function() { WASM.parallelFor(plain, "fill", 0, 16, 1); });
+plain.fill(0, 16);
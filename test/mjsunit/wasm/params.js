@@ -10,24 +10,26 @@ function runSelect2(module, which, a, b) {
 
 function testSelect2(type) {
   var kBodySize = 2;
-  var kNameOffset = 21 + kBodySize + 1;
+  var kNameOffset = 22 + kBodySize + 1;
 
   for (var which = 0; which < 2; which++) {
     print("type = " + type + ", which = " + which);
 
     var data = bytes(
       // -- memory
-      kDeclMemory,
+      kDeclMemory, 3,             // section size
       12, 12, 1,                  // memory
       // -- signatures
-      kDeclSignatures, 1,
+      kDeclSignatures, 5,         // section size
+      1,
       2, type, type, type,        // signature: (t,t)->t
       // -- select
-      kDeclFunctions, 1,
+      kDeclFunctions, 8 + kBodySize,
+      1,
       kDeclFunctionName | kDeclFunctionExport,
-      0, 0,
+      0,
       kNameOffset, 0, 0, 0,       // name offset
-      kBodySize, 0,               // body size
+      kBodySize,                  // body size
       kExprGetLocal, which,       // --
       kDeclEnd,
       's','e','l','e','c','t',0   // name
@@ -86,24 +88,26 @@ function runSelect10(module, which, a, b) {
 
 function testSelect10(type) {
   var kBodySize = 2;
-  var kNameOffset = 29 + kBodySize + 1;
+  var kNameOffset = 30 + kBodySize + 1;
 
   for (var which = 0; which < 10; which++) {
     print("type = " + type + ", which = " + which);
 
     var t = type;
     var data = bytes(
-      kDeclMemory,
+      kDeclMemory, 3,             // section size
       12, 12, 1,                  // memory
       // signatures
-      kDeclSignatures, 1,
+      kDeclSignatures, 13,        // section size
+      1,
       10, t,t,t,t,t,t,t,t,t,t,t,  // (tx10)->t
       // main function
-      kDeclFunctions, 1,
+      kDeclFunctions, 8 + kBodySize,
+      1,
       kDeclFunctionName | kDeclFunctionExport,
-      0, 0,
+      0,
       kNameOffset, 0, 0, 0,       // name offset
-      kBodySize, 0,               // body size
+      kBodySize,                  // body size
       kExprGetLocal, which,       // --
       kDeclEnd,
       's','e','l','e','c','t',0   // name
@@ -0,0 +1,65 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Flags: --harmony-sharedarraybuffer --expose-gc
+
+load("test/mjsunit/wasm/wasm-constants.js");
+
+var kNameAddOffset = 29;
+var kIterations = 10000;
+
+var data = bytes(
+  kDeclMemory, 3,                   // section size
+  12, 12, kDeclMemoryExport | kDeclMemoryShared,
+  // -- signatures
+  kDeclSignatures, 5,               // section size
+  1,
+  2, kAstI32, kAstI32, kAstI32,     // (int, int)->int
+  // -- add function
+  kDeclFunctions, 14,               // section size
+  1,
+  kDeclFunctionName | kDeclFunctionExport,
+  0,                                // signature index
+  kNameAddOffset, 0, 0, 0,          // name offset
+  6,                                // code size
+  kExprI32AtomicAdd, 0, kExprGetLocal, 0, kExprGetLocal, 1,
+  kDeclEnd,
+  'a', 'd', 'd', 0                  // name
+);
+
+if (this.Worker) {
+  // The worker instantiates the module on the memory of the main thread and
+  // adds to the same word once told to go.
+  var workerScript =
+      "var instance;\n" +
+      "onmessage = function(m) {\n" +
+      "  if (m === 'go') {\n" +
+      "    for (var i = 0; i < " + kIterations + "; i++) {\n" +
+      "      instance.add(0, 1);\n" +
+      "    }\n" +
+      "    postMessage(Atomics.load(new Int32Array(instance.memory), 0));\n" +
+      "    return;\n" +
+      "  }\n" +
+      "  instance = WASM.instantiateModule(m.module, null, m.memory);\n" +
+      "  postMessage('ready');\n" +
+      "};\n";
+
+  var w = new Worker(workerScript);
+  var instance = WASM.instantiateModule(data);
+  w.postMessage({module: data, memory: instance.memory}, [instance.memory]);
+  assertEquals('ready', w.getMessage());
+
+  for (var i = 0; i < kIterations; i++) instance.add(0, 1);
+  assertEquals(kIterations,
+               Atomics.load(new Int32Array(instance.memory), 0));
+
+  // The worker's instance alone keeps the memory alive now.
+  instance = null;
+  gc();
+  gc();
+
+  w.postMessage('go');
+  assertEquals(2 * kIterations, w.getMessage());
+  w.terminate();
+}
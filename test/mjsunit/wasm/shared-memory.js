@@ -0,0 +1,53 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Flags: --harmony-sharedarraybuffer
+
+load("test/mjsunit/wasm/wasm-constants.js");
+
+var kMemSize = 4096;
+var kNameAddOffset = 29;
+
+var data = bytes(
+  kDeclMemory, 3,                   // section size
+  12, 12, kDeclMemoryExport | kDeclMemoryShared,
+  // -- signatures
+  kDeclSignatures, 5,               // section size
+  1,
+  2, kAstI32, kAstI32, kAstI32,     // (int, int)->int
+  // -- add function
+  kDeclFunctions, 14,               // section size
+  1,
+  kDeclFunctionName | kDeclFunctionExport,
+  0,                                // signature index
+  kNameAddOffset, 0, 0, 0,          // name offset
+  6,                                // code size
+  kExprI32AtomicAdd, 0, kExprGetLocal, 0, kExprGetLocal, 1,
+  kDeclEnd,
+  'a', 'd', 'd', 0                  // name
+);
+
+var first = WASM.instantiateModule(data);
+assertTrue(first.memory instanceof SharedArrayBuffer);
+assertEquals(kMemSize, first.memory.byteLength);
+
+// A second instance works on the same memory.
+var second = WASM.instantiateModule(data, null, first.memory);
+assertSame(first.memory, second.memory);
+
+var words = new Int32Array(first.memory);
+words[1] = 40;
+assertEquals(40, first.add(4, 1));
+assertEquals(41, second.add(4, 1));
+assertEquals(42, Atomics.load(words, 1));
+
+// The old value wraps around like i32.add.
+words[2] = -1;
+assertEquals(-1, second.add(8, 1));
+assertEquals(0, words[2]);
+
+// Atomic accesses must be aligned and in bounds.
+assertTraps(kTrapMemUnaligned, function() { first.add(2, 1); });
+assertTraps(kTrapMemOutOfBounds, function() { first.add(kMemSize, 1); });
+assertEquals(42, words[1]);
@@ -0,0 +1,132 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Flags: --expose-gc
+
+load("test/mjsunit/wasm/wasm-constants.js");
+
+var kMemSize = 4096;
+var kSegmentDest = 8;
+var kSegmentOffset = 73;
+var kNameLoadOffset = kSegmentOffset + 4;
+var kNameGetOffset = kNameLoadOffset + 5;
+var kNameSetOffset = kNameGetOffset + 4;
+
+var data = bytes(
+  kDeclMemory, 3,                   // section size
+  12, 12, 1,                        // memory
+  // -- signatures
+  kDeclSignatures, 6,               // section size
+  2,
+  0, kAstI32,                       // void->int
+  1, kAstI32, kAstI32,              // int->int
+  // -- globals
+  kDeclGlobals, 7,                  // section size
+  1,
+  0, 0, 0, 0, kMemI32, 0,           // global#0
+  // -- functions
+  kDeclFunctions, 32,               // section size
+  3,
+  kDeclFunctionName | kDeclFunctionExport,
+  1,                                // signature index
+  kNameLoadOffset, 0, 0, 0,         // name offset
+  4,                                // body size
+  kExprI32LoadMem, 0, kExprGetLocal, 0,
+  kDeclFunctionName | kDeclFunctionExport,
+  0,                                // signature index
+  kNameGetOffset, 0, 0, 0,          // name offset
+  2,                                // body size
+  kExprLoadGlobal, 0,
+  kDeclFunctionName | kDeclFunctionExport,
+  1,                                // signature index
+  kNameSetOffset, 0, 0, 0,          // name offset
+  4,                                // body size
+  kExprStoreGlobal, 0, kExprGetLocal, 0,
+  // -- data segments
+  kDeclDataSegments, 14,            // section size
+  1,
+  kSegmentDest, 0, 0, 0,            // dest addr
+  kSegmentOffset, 0, 0, 0,          // source offset
+  4, 0, 0, 0,                       // source size
+  1,                                // init
+  kDeclEnd,
+  0x11, 0x22, 0x33, 0x44,           // data segment bytes
+  'l', 'o', 'a', 'd', 0,            // --
+  'g', 'e', 't', 0,                 // --
+  's', 'e', 't', 0                  // --
+);
+
+function testForkCopiesState() {
+  var instance = WASM.instantiateModule(data);
+  assertEquals(0x44332211, instance.load(kSegmentDest));
+
+  // "Initialize" the instance, overwriting part of the data segment.
+  var memory = new Int32Array(instance.memory);
+  memory[kSegmentDest / 4] = 1234;
+  memory[kMemSize / 4 - 1] = 5678;
+  instance.set(99);
+
+  var snapshot = WASM.snapshot(instance);
+  var forks = [WASM.fork(snapshot), WASM.fork(snapshot)];
+  for (var i = 0; i < forks.length; i++) {
+    var fork = forks[i];
+    assertEquals(kMemSize, fork.memory.byteLength);
+    // The data segment is not loaded again.
+    assertEquals(1234, fork.load(kSegmentDest));
+    assertEquals(5678, fork.load(kMemSize - 4));
+    assertEquals(0, fork.load(kMemSize / 2));
+    assertEquals(99, fork.get());
+  }
+
+  // Forks and the original instance do not share writes.
+  new Int32Array(forks[0].memory)[0] = 42;
+  forks[0].set(7);
+  assertEquals(42, forks[0].load(0));
+  assertEquals(0, forks[1].load(0));
+  assertEquals(0, instance.load(0));
+  assertEquals(99, forks[1].get());
+  assertEquals(99, instance.get());
+
+  // Later changes to the instance do not affect the snapshot.
+  memory[0] = 17;
+  assertEquals(0, WASM.fork(snapshot).load(0));
+}
+
+testForkCopiesState();
+
+function testForkSurvivesGc() {
+  var snapshot = WASM.snapshot(WASM.instantiateModule(data));
+  gc();
+  var fork = WASM.fork(snapshot);
+  snapshot = null;
+  gc();
+  assertEquals(0x44332211, fork.load(kSegmentDest));
+}
+
+testForkSurvivesGc();
+
+function testSnapshotKeepsModuleBytes() {
+  // The instance holds on to its module bytes, so the buffer it was
+  // instantiated from can be reused before the snapshot is taken.
+  var buffer = data.slice(0);
+  var instance = WASM.instantiateModule(buffer);
+  new Uint8Array(buffer).fill(0);
+  var fork = WASM.fork(WASM.snapshot(instance));
+  assertEquals(0x44332211, fork.load(kSegmentDest));
+  fork.set(3);
+  assertEquals(3, fork.get());
+}
+
+testSnapshotKeepsModuleBytes();
+
+function testInvalidArguments() {
+  var instance = WASM.instantiateModule(data);
+  assertThrows(function() { WASM.snapshot({}); });
+  assertThrows(function() { WASM.snapshot(); });
+  assertThrows(function() { WASM.fork({}); });
+  assertThrows(function() { WASM.fork(instance); });
+  assertThrows(function() { WASM.fork(); });
+}
+
+testInvalidArguments();
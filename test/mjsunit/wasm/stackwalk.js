@@ -8,7 +8,7 @@ load("test/mjsunit/wasm/wasm-constants.js");
 
 function makeFFI(func) {
   var kBodySize = 6;
-  var kNameFunOffset = 24 + kBodySize + 1;
+  var kNameFunOffset = 23 + kBodySize + 1;
   var kNameMainOffset = kNameFunOffset + 4;
 
   var ffi = new Object();
@@ -16,18 +16,20 @@ function makeFFI(func) {
 
   var data = bytes(
     // signatures
-    kDeclSignatures, 1,
+    kDeclSignatures, 5,           // section size
+    1,
     2, kAstI32, kAstF64, kAstF64, // (f64,f64) -> int
     // -- foreign function
-    kDeclFunctions, 2,
+    kDeclFunctions, 14 + kBodySize,
+    2,
     kDeclFunctionName | kDeclFunctionImport,
-    0, 0,
+    0,
     kNameFunOffset, 0, 0, 0,    // name offset
     // -- main function
     kDeclFunctionName | kDeclFunctionExport,
-    0, 0,
+    0,
     kNameMainOffset, 0, 0, 0,   // name offset
-    kBodySize, 0,
+    kBodySize,
     // main body
     kExprCallFunction, 0,       // --
     kExprGetLocal, 0,           // --
@@ -5,24 +5,26 @@
 load("test/mjsunit/wasm/wasm-constants.js");
 
 var module = (function () {
-  var kFuncWithBody = 9;
-  var kFuncImported = 7;
+  var kFuncWithBody = 7;
+  var kFuncImported = 6;
   var kBodySize1 = 1;
-  var kMainOffset = 6 + kFuncWithBody + kBodySize1 + 1;
+  var kMainOffset = 8 + kFuncWithBody + kBodySize1 + 1;
 
   var ffi = new Object();
   ffi.add = (function(a, b) { return a + b | 0; });
 
   return WASM.instantiateModule(bytes(
     // -- signatures
-    kDeclSignatures, 1,
+    kDeclSignatures, 3,          // section size
+    1,
     0, kAstStmt, // void -> void
     // -- function #0 (unreachable)
-    kDeclFunctions, 1,
+    kDeclFunctions, 1 + kFuncWithBody + kBodySize1,
+    1,
     kDeclFunctionName | kDeclFunctionExport,
-    0, 0,                      // signature offset
+    0,                         // signature offset
     kMainOffset, 0, 0, 0,      // name offset
-    kBodySize1, 0,             // body size
+    kBodySize1,                // body size
     kExprUnreachable,
     kDeclEnd,
     'm', 'a', 'i', 'n', 0      // name
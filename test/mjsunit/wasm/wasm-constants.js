@@ -26,12 +26,17 @@ var kDeclFunctionImport = 0x02;
 var kDeclFunctionLocals = 0x04;
 var kDeclFunctionExport = 0x08;
 
+var kDeclMemoryExport = 0x01;
+var kDeclMemoryShared = 0x02;
+
 var kAstStmt = 0;
 var kAstI32 = 1;
 var kAstI64 = 2;
 var kAstF32 = 3;
 var kAstF64 = 4;
 
+var kMemI32 = 4;
+
 var kExprNop = 0x00;
 var kExprBlock = 0x01;
 var kExprLoop = 0x02;
@@ -203,6 +208,13 @@ var kExprF64ConvertF32 = 0xb2;
 var kExprF64ReinterpretI64 = 0xb3;
 var kExprI32ReinterpretF32 = 0xb4;
 var kExprI64ReinterpretF64 = 0xb5;
+var kExprI32AtomicAdd = 0xb6;
+var kExprI32AtomicSub = 0xb7;
+var kExprI32AtomicAnd = 0xb8;
+var kExprI32AtomicIor = 0xb9;
+var kExprI32AtomicXor = 0xba;
+var kExprI32AtomicExchange = 0xbb;
+var kExprI32AtomicCompareExchange = 0xbc;
 
 var kTrapUnreachable          = 0;
 var kTrapMemOutOfBounds       = 1;
@@ -212,6 +224,8 @@ var kTrapRemByZero            = 4;
 var kTrapFloatUnrepresentable = 5;
 var kTrapFuncInvalid          = 6;
 var kTrapFuncSigMismatch      = 7;
+var kTrapMemUnaligned         = 8;
+var kTrapInstanceBusy         = 9;
 
 var kTrapMsgs = [
   "unreachable",
@@ -221,7 +235,9 @@ var kTrapMsgs = [
   "remainder by zero",
   "integer result unrepresentable",
   "invalid function",
-  "function signature mismatch"
+  "function signature mismatch",
+  "unaligned atomic memory access",
+  "instance is busy"
 ];
 
 function assertTraps(trap, code) {
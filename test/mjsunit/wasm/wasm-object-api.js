@@ -7,3 +7,5 @@ assertFalse(undefined == WASM);
 assertEquals("function", typeof WASM.verifyModule);
 assertEquals("function", typeof WASM.verifyFunction);
 assertEquals("function", typeof WASM.compileRun);
+assertEquals("function", typeof WASM.instantiateModule);
+assertEquals("function", typeof WASM.instantiateFile);
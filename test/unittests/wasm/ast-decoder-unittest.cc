@@ -8,6 +8,7 @@
 
 #include "test/cctest/wasm/test-signatures.h"
 
+#include "src/base/platform/elapsed-timer.h"
 #include "src/objects.h"
 
 #include "src/wasm/ast-decoder.h"
@@ -1129,6 +1130,68 @@ TEST_F(WasmDecoderTest, AllStoreMemCombinations) {
 }
 
 
+TEST_F(WasmDecoderTest, AtomicLoadStoreMem) {
+  EXPECT_VERIFIES_INLINE(&env_i_i,
+                         WASM_ATOMIC_LOAD_MEM(kMemI32, kSequential,
+                                              WASM_GET_LOCAL(0)));
+  EXPECT_VERIFIES_INLINE(&env_i_i,
+                         WASM_ATOMIC_LOAD_MEM(kMemI32, kAcquire,
+                                              WASM_GET_LOCAL(0)));
+  EXPECT_VERIFIES_INLINE(&env_i_i,
+                         WASM_ATOMIC_STORE_MEM(kMemI32, kSequential,
+                                               WASM_ZERO, WASM_GET_LOCAL(0)));
+  EXPECT_VERIFIES_INLINE(&env_i_i,
+                         WASM_ATOMIC_STORE_MEM(kMemI32, kRelease, WASM_ZERO,
+                                               WASM_GET_LOCAL(0)));
+
+  // Loads cannot release and stores cannot acquire.
+  EXPECT_FAILURE_INLINE(&env_i_i,
+                        WASM_ATOMIC_LOAD_MEM(kMemI32, kRelease,
+                                             WASM_GET_LOCAL(0)));
+  EXPECT_FAILURE_INLINE(&env_i_i,
+                        WASM_ATOMIC_STORE_MEM(kMemI32, kAcquire, WASM_ZERO,
+                                              WASM_GET_LOCAL(0)));
+}
+
+
+TEST_F(WasmDecoderTest, AtomicLoadMemOnlyI32) {
+  for (size_t i = 0; i < arraysize(kLocalTypes); i++) {
+    LocalType local_type = kLocalTypes[i];
+    for (size_t j = 0; j < arraysize(kMemTypes); j++) {
+      MemType mem_type = kMemTypes[j];
+      byte code[] = {WASM_ATOMIC_LOAD_MEM(mem_type, kSequential, WASM_ZERO)};
+      FunctionEnv env;
+      FunctionSig sig(1, 0, &local_type);
+      init_env(&env, &sig);
+      if (local_type == kAstI32 && mem_type == kMemI32) {
+        EXPECT_VERIFIES(&env, code);
+      } else {
+        EXPECT_FAILURE(&env, code);
+      }
+    }
+  }
+}
+
+
+TEST_F(WasmDecoderTest, AtomicMem) {
+  EXPECT_VERIFIES_INLINE(&env_i_i,
+                         WASM_ATOMIC_MEM(Add, WASM_ZERO, WASM_GET_LOCAL(0)));
+  EXPECT_VERIFIES_INLINE(&env_i_i,
+                         WASM_ATOMIC_MEM(Xor, WASM_ZERO, WASM_GET_LOCAL(0)));
+  EXPECT_VERIFIES_INLINE(&env_i_i, WASM_ATOMIC_MEM_OFFSET(Exchange, 8,
+                                                          WASM_ZERO,
+                                                          WASM_GET_LOCAL(0)));
+  EXPECT_VERIFIES_INLINE(&env_i_i, WASM_ATOMIC_CMPXCHG(WASM_ZERO, WASM_ONE,
+                                                       WASM_GET_LOCAL(0)));
+
+  EXPECT_FAILURE_INLINE(&env_l_l,
+                        WASM_ATOMIC_MEM(Add, WASM_ZERO, WASM_GET_LOCAL(0)));
+  EXPECT_FAILURE_INLINE(&env_i_i, WASM_ATOMIC_MEM(Sub, WASM_ZERO, WASM_I64(1)));
+  EXPECT_FAILURE_INLINE(&env_i_i, WASM_ATOMIC_CMPXCHG(WASM_ZERO, WASM_I64(0),
+                                                      WASM_GET_LOCAL(0)));
+}
+
+
 namespace {
 // A helper for tests that require a module environment for functions and
 // globals.
@@ -1140,31 +1203,25 @@ class TestModuleEnv : public ModuleEnv {
     module = &mod;
     linker = nullptr;
     function_code = nullptr;
-    mod.globals = &globals;
-    mod.signatures = &signatures;
-    mod.functions = &functions;
   }
   byte AddGlobal(MemType mem_type) {
-    globals.push_back({0, mem_type, 0, false});
-    CHECK(globals.size() <= 127);
-    return static_cast<byte>(globals.size() - 1);
+    mod.globals->push_back({0, mem_type, 0, false});
+    CHECK(mod.globals->size() <= 127);
+    return static_cast<byte>(mod.globals->size() - 1);
   }
   byte AddSignature(FunctionSig* sig) {
-    signatures.push_back(sig);
-    CHECK(signatures.size() <= 127);
-    return static_cast<byte>(signatures.size() - 1);
+    mod.signatures->push_back(sig);
+    CHECK(mod.signatures->size() <= 127);
+    return static_cast<byte>(mod.signatures->size() - 1);
   }
   byte AddFunction(FunctionSig* sig) {
-    functions.push_back({sig, 0, 0, 0, 0, 0, 0, 0, false, false});
-    CHECK(functions.size() <= 127);
-    return static_cast<byte>(functions.size() - 1);
+    mod.functions->push_back({sig, 0, 0, 0, 0, 0, 0, 0, 0, false, false});
+    CHECK(mod.functions->size() <= 127);
+    return static_cast<byte>(mod.functions->size() - 1);
   }
 
  private:
   WasmModule mod;
-  std::vector<WasmGlobal> globals;
-  std::vector<FunctionSig*> signatures;
-  std::vector<WasmFunction> functions;
 };
 }
 
@@ -1997,6 +2054,46 @@ TEST_F(WasmOpcodeLengthTest, MiscMemExpressions) {
 }
 
 
+TEST_F(WasmOpcodeLengthTest, AtomicMemExpressions) {
+  EXPECT_LENGTH(2, kExprI32AtomicAdd);
+  EXPECT_LENGTH(2, kExprI32AtomicExchange);
+  EXPECT_LENGTH(2, kExprI32AtomicCompareExchange);
+}
+
+
+TEST_F(WasmOpcodeLengthTest, MemExpressionsWithOffset) {
+  static const byte load[] = {WASM_LOAD_MEM_OFFSET(kMemI32, 5, WASM_ZERO)};
+  EXPECT_EQ(3, OpcodeLength(load));
+  static const byte store[] = {
+      kExprI64StoreMem, WasmOpcodes::LoadStoreAccessOf(kMemI64, true), 0x80,
+      0x80, 1, WASM_ZERO, WASM_I8(0)};
+  EXPECT_EQ(5, OpcodeLength(store));
+  static const byte atomic[] = {
+      WASM_ATOMIC_MEM_OFFSET(Add, 0x7f, WASM_ZERO, WASM_ONE)};
+  EXPECT_EQ(3, OpcodeLength(atomic));
+}
+
+
+TEST_F(WasmOpcodeLengthTest, CollectDirectCallees) {
+  static const byte code[] = {
+      WASM_BLOCK(3, WASM_CALL_FUNCTION0(2),
+                 WASM_LOAD_MEM_OFFSET(kMemI32, 0x40, WASM_ZERO),
+                 WASM_CALL_FUNCTION(0, WASM_CALL_FUNCTION0(1)))};
+  ZoneVector<uint32_t> callees(zone());
+  EXPECT_TRUE(CollectDirectCallees(code, code + arraysize(code), &callees));
+  ASSERT_EQ(3u, callees.size());
+  EXPECT_EQ(2u, callees[0]);
+  EXPECT_EQ(0u, callees[1]);
+  EXPECT_EQ(1u, callees[2]);
+
+  static const byte indirect[] = {
+      WASM_BLOCK(2, WASM_CALL_FUNCTION0(2),
+                 WASM_CALL_INDIRECT0(0, WASM_ZERO))};
+  EXPECT_FALSE(
+      CollectDirectCallees(indirect, indirect + arraysize(indirect), &callees));
+}
+
+
 TEST_F(WasmOpcodeLengthTest, SimpleExpressions) {
   EXPECT_LENGTH(1, kExprI32Add);
   EXPECT_LENGTH(1, kExprI32Sub);
@@ -2375,6 +2472,123 @@ TEST_F(WasmOpcodeArityTest, SimpleExpressions) {
   EXPECT_ARITY(1, kExprI64ReinterpretF64);
 }
 
+
+class WasmOpcodeInfoTest : public TestWithZone {
+ public:
+  WasmOpcodeInfoTest() : TestWithZone() { }
+};
+
+
+TEST_F(WasmOpcodeInfoTest, Classes) {
+#define EXPECT_CLASS(name, opcode, sig) \
+  EXPECT_EQ(expected, WasmOpcodes::Class(kExpr##name));
+
+  WasmOpcodeClass expected = kControlOpcodeClass;
+  FOREACH_CONTROL_OPCODE(EXPECT_CLASS);
+  expected = kMiscOpcodeClass;
+  FOREACH_MISC_OPCODE(EXPECT_CLASS);
+  expected = kSimpleOpcodeClass;
+  FOREACH_SIMPLE_OPCODE(EXPECT_CLASS);
+  expected = kLoadMemOpcodeClass;
+  FOREACH_LOAD_MEM_OPCODE(EXPECT_CLASS);
+  expected = kStoreMemOpcodeClass;
+  FOREACH_STORE_MEM_OPCODE(EXPECT_CLASS);
+  expected = kMiscMemOpcodeClass;
+  FOREACH_MISC_MEM_OPCODE(EXPECT_CLASS);
+  expected = kAtomicMemOpcodeClass;
+  FOREACH_ATOMIC_MEM_OPCODE(EXPECT_CLASS);
+
+#undef EXPECT_CLASS
+
+#define COUNT_OPCODE(name, opcode, sig) count++;
+  int count = 0;
+  FOREACH_OPCODE(COUNT_OPCODE);
+#undef COUNT_OPCODE
+
+  for (int i = 0; i < 256; i++) {
+    if (WasmOpcodes::Class(i) != kInvalidOpcodeClass) count--;
+  }
+  EXPECT_EQ(0, count);
+}
+
+
+TEST_F(WasmOpcodeInfoTest, Signatures) {
+#define EXPECT_SIMPLE_SIG(name, opcode, sig)                           \
+  {                                                                    \
+    const WasmOpcodeInfo& info = WasmOpcodes::Info(kExpr##name);      \
+    FunctionSig* opcode_sig = WasmOpcodes::Signature(kExpr##name);     \
+    EXPECT_TRUE(opcode_sig != nullptr);                                \
+    EXPECT_EQ(opcode_sig, WasmOpcodes::FixedSignature(info));          \
+    EXPECT_EQ(static_cast<int>(opcode_sig->parameter_count()),         \
+              info.arity);                                             \
+  }
+
+  FOREACH_SIMPLE_OPCODE(EXPECT_SIMPLE_SIG);
+
+#undef EXPECT_SIMPLE_SIG
+
+#define EXPECT_MEM_SIG(name, opcode, sig)                              \
+  {                                                                    \
+    const WasmOpcodeInfo& info = WasmOpcodes::Info(kExpr##name);      \
+    FunctionSig* opcode_sig = WasmOpcodes::FixedSignature(info);      \
+    EXPECT_TRUE(WasmOpcodes::Signature(kExpr##name) == nullptr);       \
+    EXPECT_TRUE(opcode_sig != nullptr);                                \
+    EXPECT_EQ(static_cast<int>(opcode_sig->parameter_count()),         \
+              info.arity);                                             \
+  }
+
+  FOREACH_LOAD_MEM_OPCODE(EXPECT_MEM_SIG);
+  FOREACH_STORE_MEM_OPCODE(EXPECT_MEM_SIG);
+  FOREACH_MISC_MEM_OPCODE(EXPECT_MEM_SIG);
+  FOREACH_ATOMIC_MEM_OPCODE(EXPECT_MEM_SIG);
+
+#undef EXPECT_MEM_SIG
+
+  EXPECT_TRUE(WasmOpcodes::Signature(kExprNop) == nullptr);
+  EXPECT_TRUE(WasmOpcodes::Signature(kExprGetLocal) == nullptr);
+}
+
+
+TEST_F(WasmOpcodeInfoTest, MemTypes) {
+  EXPECT_EQ(kMemI8, WasmOpcodes::Info(kExprI32LoadMem8S).mem_type);
+  EXPECT_EQ(kMemU8, WasmOpcodes::Info(kExprI64LoadMem8U).mem_type);
+  EXPECT_EQ(kMemI16, WasmOpcodes::Info(kExprI64StoreMem16).mem_type);
+  EXPECT_EQ(kMemU16, WasmOpcodes::Info(kExprI32LoadMem16U).mem_type);
+  EXPECT_EQ(kMemI32, WasmOpcodes::Info(kExprI64LoadMem32S).mem_type);
+  EXPECT_EQ(kMemU32, WasmOpcodes::Info(kExprI64LoadMem32U).mem_type);
+  EXPECT_EQ(kMemI32, WasmOpcodes::Info(kExprI32StoreMem).mem_type);
+  EXPECT_EQ(kMemI64, WasmOpcodes::Info(kExprI64LoadMem).mem_type);
+  EXPECT_EQ(kMemF32, WasmOpcodes::Info(kExprF32StoreMem).mem_type);
+  EXPECT_EQ(kMemF64, WasmOpcodes::Info(kExprF64LoadMem).mem_type);
+}
+
+
+// Measures verification throughput on a large function body. Timings
+// depend on the machine and the build, so this only runs with
+// --gtest_also_run_disabled_tests. The throughput in MB/s is recorded as a
+// test property, e.g. for --gtest_output=xml.
+TEST_F(WasmDecoderTest, DISABLED_DecodeThroughput) {
+  static const byte kStatement[] = {WASM_SET_LOCAL(
+      0, WASM_I32_ADD(WASM_GET_LOCAL(0),
+                      WASM_I32_MUL(WASM_GET_LOCAL(0), WASM_I8(3))))};
+  static const int kStatementCount = 1 << 16;
+  static const int kIterations = 20;
+
+  std::vector<byte> code;
+  for (int i = 0; i < kStatementCount; i++) {
+    code.insert(code.end(), kStatement, kStatement + sizeof(kStatement));
+  }
+
+  base::ElapsedTimer timer;
+  timer.Start();
+  for (int i = 0; i < kIterations; i++) {
+    Verify(kSuccess, &env_v_i, &code[0], &code[0] + code.size());
+  }
+  double ms = timer.Elapsed().InMillisecondsF();
+  double mb = static_cast<double>(code.size()) * kIterations / MB;
+  RecordProperty("decode_mb_per_s", static_cast<int>(mb * 1000 / ms));
+}
+
 }
 }
 }
@@ -8,6 +8,7 @@
 
 #include "src/wasm/encoder.h"
 #include "src/wasm/ast-decoder.h"
+#include "src/wasm/module-decoder.h"
 
 namespace v8 {
 namespace internal {
@@ -146,6 +147,47 @@ TEST_F(EncoderTest, LEB_Functions) {
   CheckReadValue(leb_value, -1, -1, kInvalidLEB128);
 }
 
+TEST_F(EncoderTest, DataSegments_SplitAtZeroRuns) {
+  Zone zone;
+  WasmModuleBuilder* builder = new(&zone) WasmModuleBuilder(&zone);
+  // Two parts separated by a long zero run, with a short zero run kept.
+  byte data[64] = {0};
+  data[2] = 1;
+  data[8] = 2;
+  data[60] = 3;
+  builder->AddDataSegment(
+      new(&zone) WasmDataSegmentEncoder(&zone, data, sizeof(data), 100));
+  // An all-zero segment is dropped.
+  byte zeros[32] = {0};
+  builder->AddDataSegment(
+      new(&zone) WasmDataSegmentEncoder(&zone, zeros, sizeof(zeros), 1000));
+  // A segment over an earlier one is kept whole.
+  builder->AddDataSegment(
+      new(&zone) WasmDataSegmentEncoder(&zone, zeros, 4, 102));
+  WasmModuleWriter* writer = builder->Build(&zone);
+  WasmModuleIndex* module = writer->WriteTo(&zone);
+
+  ModuleResult result = DecodeWasmModule(nullptr, module->Begin(),
+                                         module->End(), false, false);
+  EXPECT_TRUE(result.ok());
+  if (result.ok()) {
+    ZoneVector<WasmDataSegment>* segments = result.val->data_segments;
+    EXPECT_EQ(3, segments->size());
+    if (segments->size() == 3) {
+      EXPECT_EQ(102, segments->at(0).dest_addr);
+      EXPECT_EQ(7, segments->at(0).source_size);
+      EXPECT_EQ(1, module->Begin()[segments->at(0).source_offset]);
+      EXPECT_EQ(2, module->Begin()[segments->at(0).source_offset + 6]);
+      EXPECT_EQ(160, segments->at(1).dest_addr);
+      EXPECT_EQ(1, segments->at(1).source_size);
+      EXPECT_EQ(3, module->Begin()[segments->at(1).source_offset]);
+      EXPECT_EQ(102, segments->at(2).dest_addr);
+      EXPECT_EQ(4, segments->at(2).source_size);
+    }
+  }
+  delete result.val;
+}
+
 }
 }
 }
@@ -0,0 +1,181 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "test/unittests/test-utils.h"
+
+#include "src/v8.h"
+
+#include "src/base/platform/elapsed-timer.h"
+
+#include "src/wasm/ast-decoder.h"
+#include "src/wasm/encoder.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+class LEB128Test : public TestWithZone {
+ protected:
+  void CheckRead(uint32_t expected, int expected_length,
+                 const std::vector<byte>& bytes) {
+    int length = 0;
+    uint32_t result = 0;
+    ReadUnsignedLEB128ErrorCode error_code = ReadUnsignedLEB128Operand(
+        &bytes[0], &bytes[0] + bytes.size(), &length, &result);
+    EXPECT_EQ(kNoError, error_code);
+    EXPECT_EQ(expected, result);
+    EXPECT_EQ(expected_length, length);
+
+    Decoder decoder(&bytes[0], &bytes[0] + bytes.size());
+    EXPECT_EQ(expected, decoder.u32v(&length));
+    EXPECT_EQ(expected_length, length);
+    EXPECT_TRUE(decoder.ok());
+  }
+};
+
+
+// A byte-at-a-time decoder used as the baseline in the benchmark below.
+static uint32_t ReadLEB128Simple(const byte* pc, const byte* limit,
+                                 int* length) {
+  uint32_t result = 0;
+  const byte* ptr = pc;
+  const byte* end = pc + 5;
+  if (end > limit) end = limit;
+  int shift = 0;
+  while (ptr < end) {
+    byte b = *ptr++;
+    result |= (b & 0x7F) << shift;
+    if ((b & 0x80) == 0) break;
+    shift += 7;
+  }
+  *length = static_cast<int>(ptr - pc);
+  return result;
+}
+
+
+TEST_F(LEB128Test, AllLengths) {
+  static const uint32_t kValues[] = {0,          1,          0x7F,
+                                     0x80,       0x3FFF,     0x4000,
+                                     0x1FFFFF,   0x200000,   0xFFFFFFF,
+                                     0x10000000, 0xFFFFFFFF};
+  for (size_t i = 0; i < arraysize(kValues); i++) {
+    std::vector<byte> bytes = UnsignedLEB128From(kValues[i]);
+    int length = static_cast<int>(bytes.size());
+    CheckRead(kValues[i], length, bytes);
+
+    // Trailing bytes must not change the result.
+    bytes.push_back(0xFF);
+    bytes.push_back(0xFF);
+    CheckRead(kValues[i], length, bytes);
+  }
+}
+
+
+TEST_F(LEB128Test, Truncated) {
+  static const byte data[] = {0x80, 0x80, 0x80, 0x80, 0x80};
+  for (size_t size = 1; size <= arraysize(data); size++) {
+    int length;
+    uint32_t result;
+    EXPECT_EQ(kInvalidLEB128,
+              ReadUnsignedLEB128Operand(data, data + size, &length, &result));
+
+    Decoder decoder(data, data + size);
+    decoder.u32v(&length);
+    EXPECT_TRUE(decoder.failed());
+  }
+}
+
+
+TEST_F(LEB128Test, Missing) {
+  static const byte data[] = {0};
+  int length;
+  uint32_t result;
+  EXPECT_EQ(kMissingLEB128,
+            ReadUnsignedLEB128Operand(data, data, &length, &result));
+  EXPECT_EQ(0, length);
+
+  Decoder decoder(data, data);
+  decoder.u32v(&length);
+  EXPECT_TRUE(decoder.failed());
+}
+
+
+TEST_F(LEB128Test, Run) {
+  static const byte data[] = {1, 0x80, 1, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 5};
+  uint32_t results[4];
+  const byte* end = data + arraysize(data);
+
+  EXPECT_EQ(end, ReadUnsignedLEB128Run(data, end, 4, results));
+  EXPECT_EQ(1, results[0]);
+  EXPECT_EQ(128, results[1]);
+  EXPECT_EQ(0xFFFFFFFF, results[2]);
+  EXPECT_EQ(5, results[3]);
+
+  EXPECT_EQ(data + 3, ReadUnsignedLEB128Run(data, end, 2, nullptr));
+  EXPECT_EQ(data, ReadUnsignedLEB128Run(data, end, 0, nullptr));
+  EXPECT_TRUE(ReadUnsignedLEB128Run(data, end, 5, nullptr) == nullptr);
+  EXPECT_TRUE(ReadUnsignedLEB128Run(data, end - 2, 3, nullptr) == nullptr);
+}
+
+
+// Compares the shared decoder against the byte-at-a-time baseline on a mix
+// of mostly one-byte varints. Timings depend on the machine and the build,
+// so this only runs with --gtest_also_run_disabled_tests. The throughput in
+// MB/s is recorded as test properties, e.g. for --gtest_output=xml.
+TEST_F(LEB128Test, DISABLED_Throughput) {
+  static const int kCount = 1 << 20;
+  static const int kIterations = 20;
+
+  std::vector<byte> data;
+  for (int i = 0; i < kCount; i++) {
+    uint32_t value = (i % 16 == 0) ? i * 4099u : i % 128;
+    std::vector<byte> bytes = UnsignedLEB128From(value);
+    data.insert(data.end(), bytes.begin(), bytes.end());
+  }
+  const byte* start = &data[0];
+  const byte* limit = start + data.size();
+  double mb = static_cast<double>(data.size()) * kIterations / MB;
+
+  uint32_t sum_simple = 0;
+  base::ElapsedTimer timer;
+  timer.Start();
+  for (int i = 0; i < kIterations; i++) {
+    for (const byte* pc = start; pc < limit;) {
+      int length;
+      sum_simple += ReadLEB128Simple(pc, limit, &length);
+      pc += length;
+    }
+  }
+  double ms_simple = timer.Elapsed().InMillisecondsF();
+
+  uint32_t sum_fast = 0;
+  timer.Restart();
+  for (int i = 0; i < kIterations; i++) {
+    for (const byte* pc = start; pc < limit;) {
+      int length;
+      uint32_t result;
+      ReadUnsignedLEB128Operand(pc, limit, &length, &result);
+      sum_fast += result;
+      pc += length;
+    }
+  }
+  double ms_fast = timer.Elapsed().InMillisecondsF();
+
+  timer.Restart();
+  for (int i = 0; i < kIterations; i++) {
+    EXPECT_EQ(limit, ReadUnsignedLEB128Run(start, limit, kCount, nullptr));
+  }
+  double ms_run = timer.Elapsed().InMillisecondsF();
+
+  EXPECT_EQ(sum_simple, sum_fast);
+  EXPECT_LT(ms_fast, ms_simple);
+  EXPECT_LT(ms_run, ms_simple);
+  RecordProperty("simple_mb_per_s", static_cast<int>(mb * 1000 / ms_simple));
+  RecordProperty("fast_mb_per_s", static_cast<int>(mb * 1000 / ms_fast));
+  RecordProperty("run_mb_per_s", static_cast<int>(mb * 1000 / ms_run));
+}
+
+}
+}
+}
@@ -4,6 +4,7 @@
 
 #include "test/unittests/test-utils.h"
 
+#include "src/base/smart-pointers.h"
 #include "src/wasm/module-decoder.h"
 #include "src/wasm/wasm-opcodes.h"
 
@@ -14,8 +15,7 @@ namespace wasm {
 class WasmModuleVerifyTest : public TestWithZone {
  public:
   ModuleResult DecodeModule(const byte* module_start, const byte* module_end) {
-    return DecodeWasmModule(nullptr, zone(), module_start, module_end,
-                            false, false);
+    return DecodeWasmModule(nullptr, module_start, module_end, false, false);
   }
 };
 
@@ -51,9 +51,28 @@ TEST_F(WasmModuleVerifyTest, DecodeEmpty) {
 }
 
 
+TEST_F(WasmModuleVerifyTest, MemoryFlags) {
+  static const byte kFlags[] = {0, kDeclMemoryExport, kDeclMemoryShared,
+                                kDeclMemoryExport | kDeclMemoryShared};
+  for (size_t i = 0; i < arraysize(kFlags); i++) {
+    const byte data[] = {
+        kDeclMemory, 3,  // section size
+        12, 16, kFlags[i],
+    };
+    ModuleResult result = DecodeModule(data, data + arraysize(data));
+    EXPECT_TRUE(result.ok());
+    EXPECT_EQ(12, result.val->min_mem_size_log2);
+    EXPECT_EQ(16, result.val->max_mem_size_log2);
+    EXPECT_EQ((kFlags[i] & kDeclMemoryExport) != 0, result.val->mem_export);
+    EXPECT_EQ((kFlags[i] & kDeclMemoryShared) != 0, result.val->mem_shared);
+  }
+}
+
+
 TEST_F(WasmModuleVerifyTest, OneGlobal) {
   const byte data[] = {
-      kDeclGlobals, 1,
+      kDeclGlobals, 7,               // section size
+      1,
       0, 0, 0, 0,                    // name offset
       kMemI32,                       // memory type
       0,                             // exported
@@ -85,7 +104,8 @@ TEST_F(WasmModuleVerifyTest, OneGlobal) {
 
 TEST_F(WasmModuleVerifyTest, ZeroGlobals) {
   const byte data[] = {
-    kDeclGlobals, 0,   // declare 0 globals
+    kDeclGlobals, 1,   // section size
+    0,                 // declare 0 globals
   };
   ModuleResult result = DecodeModule(data, data + arraysize(data));
   EXPECT_TRUE(result.ok());
@@ -114,13 +134,17 @@ TEST_F(WasmModuleVerifyTest, NGlobals) {
     0,                 // exported
   };
   for (uint32_t i = 0; i < 1000000; i = i * 7 + 1) {
-    std::vector<byte> buffer;
-    buffer.push_back(kDeclGlobals);
-    AppendUint32v(buffer, i);
+    std::vector<byte> section;
+    AppendUint32v(section, i);
     for (int j = 0; j < i; j++) {
-      buffer.insert(buffer.end(), data, data + arraysize(data));
+      section.insert(section.end(), data, data + arraysize(data));
     }
-    
+
+    std::vector<byte> buffer;
+    buffer.push_back(kDeclGlobals);
+    AppendUint32v(buffer, static_cast<uint32_t>(section.size()));
+    buffer.insert(buffer.end(), section.begin(), section.end());
+
     ModuleResult result = DecodeModule(&buffer[0], &buffer[0] + buffer.size());
     EXPECT_TRUE(result.ok());
   }
@@ -129,7 +153,8 @@ TEST_F(WasmModuleVerifyTest, NGlobals) {
 
 TEST_F(WasmModuleVerifyTest, GlobalWithInvalidNameOffset) {
   const byte data[] = {
-    kDeclGlobals, 1,   // declare one global
+    kDeclGlobals, 7,   // section size
+    1,                 // declare one global
     0, 3, 0, 0,        // name offset
     kMemI32,           // memory type
     0,                 // exported
@@ -141,7 +166,8 @@ TEST_F(WasmModuleVerifyTest, GlobalWithInvalidNameOffset) {
 
 TEST_F(WasmModuleVerifyTest, GlobalWithInvalidMemoryType) {
   const byte data[] = {
-    kDeclGlobals, 1,         // declare one global
+    kDeclGlobals, 7,         // section size
+    1,                       // declare one global
     0, 0, 0, 0,              // name offset
     33,                      // memory type
     0,                       // exported
@@ -153,7 +179,8 @@ TEST_F(WasmModuleVerifyTest, GlobalWithInvalidMemoryType) {
 
 TEST_F(WasmModuleVerifyTest, TwoGlobals) {
   const byte data[] = {
-    kDeclGlobals, 2,
+    kDeclGlobals, 13,              // section size
+    2,
     0, 0, 0, 0,                    // #0: name offset
     kMemF32,                       // memory type
     0,                             // exported
@@ -194,7 +221,8 @@ TEST_F(WasmModuleVerifyTest, TwoGlobals) {
 
 TEST_F(WasmModuleVerifyTest, OneSignature) {
   static const byte data[] = {
-    kDeclSignatures, 1,
+    kDeclSignatures, 3,  // section size
+    1,
     0, kAstStmt  // void -> void
   };
   EXPECT_VERIFIES(data);
@@ -203,7 +231,8 @@ TEST_F(WasmModuleVerifyTest, OneSignature) {
 
 TEST_F(WasmModuleVerifyTest, MultipleSignatures) {
   static const byte data[] = {
-    kDeclSignatures, 3,
+    kDeclSignatures, 10,          // section size
+    3,
     0, kAstStmt,                  // void -> void
     1, kAstI32, kAstF32,          // f32 -> i32
     2, kAstI32, kAstF64, kAstF64, // (f64,f64) -> i32
@@ -231,9 +260,10 @@ TEST_F(WasmModuleVerifyTest, MultipleSignatures) {
 
 TEST_F(WasmModuleVerifyTest, FunctionWithoutSig) {
   static const byte data[] = {
-    kDeclFunctions, 1,
+    kDeclFunctions, 24,            // section size
+    1,
     // func#0 ------------------------------------------------------
-    0, 0,                          // signature index
+    0,                             // signature index
     0, 0, 0, 0,                    // name offset
     0, 0, 0, 0,                    // code start offset
     0, 0, 0, 0,                    // code end offset
@@ -255,19 +285,21 @@ TEST_F(WasmModuleVerifyTest, OneEmptyVoidVoidFunction) {
   const int kCodeEndOffset = kCodeStartOffset + 1;
 
   static const byte data[] = {
-    kDeclSignatures, 1,
+    kDeclSignatures, 3,            // section size
+    1,
     // sig#0 -------------------------------------------------------
     0, 0,                          // void -> void
     // func#0 ------------------------------------------------------
-    kDeclFunctions, 1,
+    kDeclFunctions, 17,            // section size
+    1,
     kDeclFunctionLocals | kDeclFunctionExport | kDeclFunctionName,
-    0, 0,                          // signature index
+    0,                             // signature index
     9, 0, 0, 0,                    // name offset
     11, 2,                         // local int32 count
     13, 4,                         // local int64 count
     15, 6,                         // local float32 count
     17, 8,                         // local float64 count
-    1, 0,                          // size
+    1,                             // size
     kExprNop,
   };
 
@@ -296,7 +328,7 @@ TEST_F(WasmModuleVerifyTest, OneEmptyVoidVoidFunction) {
     EXPECT_EQ(false, function->external);
   }
 
-  for (size_t size = 5; size < arraysize(data); size++) {
+  for (size_t size = 6; size < arraysize(data); size++) {
     // Should fall off end of module bytes.
     ModuleResult result = DecodeModule(data, data + size);
     EXPECT_FALSE(result.ok());
@@ -306,13 +338,15 @@ TEST_F(WasmModuleVerifyTest, OneEmptyVoidVoidFunction) {
 
 TEST_F(WasmModuleVerifyTest, OneFunctionImported) {
   static const byte data[] = {
-      kDeclSignatures, 1,
+      kDeclSignatures, 3,            // section size
+      1,
       // sig#0 -------------------------------------------------------
       0, 0,                          // void -> void
-      kDeclFunctions, 1,
+      kDeclFunctions, 3,             // section size
+      1,
       // func#0 ------------------------------------------------------
       kDeclFunctionImport,           // no name, no locals, imported
-      0, 0,                          // signature index
+      0,                             // signature index
   };
 
   ModuleResult result = DecodeModule(data, data + arraysize(data));
@@ -339,14 +373,16 @@ TEST_F(WasmModuleVerifyTest, OneFunctionWithNopBody) {
   static const byte kCodeEndOffset = kCodeStartOffset + 1;
 
   static const byte data[] = {
-      kDeclSignatures, 1,
+      kDeclSignatures, 3,            // section size
+      1,
       // sig#0 -------------------------------------------------------
       0, 0,                          // void -> void
-      kDeclFunctions, 1,
+      kDeclFunctions, 5,             // section size
+      1,
       // func#0 ------------------------------------------------------
       0,                             // no name, no locals
-      0, 0,                          // signature index
-      1, 0,                          // body size
+      0,                             // signature index
+      1,                             // body size
       kExprNop                       // body
   };
 
@@ -369,23 +405,113 @@ TEST_F(WasmModuleVerifyTest, OneFunctionWithNopBody) {
 }
 
 
+TEST_F(WasmModuleVerifyTest, OneFunctionWithNopBody_LongLEB) {
+  static const byte kCodeStartOffset = 14;
+  static const byte kCodeEndOffset = kCodeStartOffset + 1;
+
+  static const byte data[] = {
+      kDeclSignatures, 3,            // section size
+      1,
+      // sig#0 -------------------------------------------------------
+      0, 0,                          // void -> void
+      kDeclFunctions, 8,             // section size
+      1,
+      // func#0 ------------------------------------------------------
+      0,                             // no name, no locals
+      0x80, 0x80, 0,                 // signature index
+      0x81, 0,                       // body size
+      kExprNop                       // body
+  };
+
+  ModuleResult result = DecodeModule(data, data + arraysize(data));
+  EXPECT_TRUE(result.ok());
+  if (result.ok()) {
+    WasmFunction* function = &result.val->functions->back();
+    EXPECT_EQ(0, function->sig_index);
+    EXPECT_EQ(kCodeStartOffset, function->code_start_offset);
+    EXPECT_EQ(kCodeEndOffset, function->code_end_offset);
+  }
+}
+
+
+TEST_F(WasmModuleVerifyTest, FunctionBodyOverrun) {
+  static const byte data[] = {
+      kDeclSignatures, 3,            // section size
+      1,
+      // sig#0 -------------------------------------------------------
+      0, 0,                          // void -> void
+      kDeclFunctions, 5,             // section size
+      1,
+      // func#0 ------------------------------------------------------
+      0,                             // no name, no locals
+      0,                             // signature index
+      0x80, 0x01,                    // body size
+  };
+
+  EXPECT_FAILURE(data);
+}
+
+
+TEST_F(WasmModuleVerifyTest, FunctionBodyVerification) {
+  byte data[] = {
+      kDeclSignatures, 3,            // section size
+      1,
+      // sig#0 -------------------------------------------------------
+      0, 0,                          // void -> void
+      kDeclFunctions, 5,             // section size
+      1,
+      // func#0 ------------------------------------------------------
+      0,                             // no name, no locals
+      0,                             // signature index
+      1,                             // body size
+      kExprNop                       // body
+  };
+
+  {
+    ModuleResult result =
+        DecodeWasmModule(nullptr, data, data + arraysize(data), true, false);
+    base::SmartPointer<WasmModule> module(result.val);
+    EXPECT_TRUE(result.ok());
+    if (result.ok()) EXPECT_TRUE(result.val->function_bodies_verified);
+  }
+
+  // An invalid body is only detected when bodies are verified.
+  data[arraysize(data) - 1] = 0xff;
+  {
+    ModuleResult result = DecodeModule(data, data + arraysize(data));
+    base::SmartPointer<WasmModule> module(result.val);
+    EXPECT_TRUE(result.ok());
+    if (result.ok()) EXPECT_FALSE(result.val->function_bodies_verified);
+  }
+
+  {
+    ModuleResult result =
+        DecodeWasmModule(nullptr, data, data + arraysize(data), true, false);
+    base::SmartPointer<WasmModule> module(result.val);
+    EXPECT_FALSE(result.ok());
+  }
+}
+
+
 TEST_F(WasmModuleVerifyTest, OneFunctionWithNopBody_WithLocals) {
   static const byte kCodeStartOffset = 19;
   static const byte kCodeEndOffset = kCodeStartOffset + 1;
 
   static const byte data[] = {
-      kDeclSignatures, 1,
+      kDeclSignatures, 3,            // section size
+      1,
       // sig#0 -------------------------------------------------------
       0, 0,                          // void -> void
-      kDeclFunctions, 1,
+      kDeclFunctions, 13,            // section size
+      1,
       // func#0 ------------------------------------------------------
       kDeclFunctionLocals,
-      0, 0,                          // signature index
+      0,                             // signature index
       1, 2,                          // local int32 count
       3, 4,                          // local int64 count
       5, 6,                          // local float32 count
       7, 8,                          // local float64 count
-      1, 0,                          // body size
+      1,                             // body size
       kExprNop                       // body
   };
 
@@ -409,33 +535,37 @@ TEST_F(WasmModuleVerifyTest, OneFunctionWithNopBody_WithLocals) {
 
 
 TEST_F(WasmModuleVerifyTest, OneGlobalOneFunctionWithNopBodyOneDataSegment) {
-  static const byte kCodeStartOffset = 2 + kDeclGlobalSize + 4 + 2 + 17;
+  static const byte kCodeStartOffset = 3 + kDeclGlobalSize + 5 + 3 + 15;
   static const byte kCodeEndOffset = kCodeStartOffset + 3;
 
   static const byte data[] = {
       // global#0 --------------------------------------------------
-      kDeclGlobals, 1,
+      kDeclGlobals, 7,            // section size
+      1,
       0, 0, 0, 0,                 // name offset
       kMemU8,                     // memory type
       0,                          // exported
       // sig#0 -----------------------------------------------------
-      kDeclSignatures, 1,
+      kDeclSignatures, 3,         // section size
+      1,
       0, 0,                       // void -> void
       // func#0 ----------------------------------------------------
-      kDeclFunctions, 1,
+      kDeclFunctions, 19,         // section size
+      1,
       kDeclFunctionLocals | kDeclFunctionName,
-      0, 0,                       // signature index
+      0,                          // signature index
       9, 0, 0, 0,                 // name offset
       1, 2,                       // local int32 count
       3, 4,                       // local int64 count
       5, 6,                       // local float32 count
       7, 8,                       // local float64 count
-      3, 0,                       // body size
+      3,                          // body size
       kExprNop,                   // func#0 body
       kExprNop,                   // func#0 body
       kExprNop,                   // func#0 body
       // segment#0 -------------------------------------------------
-      kDeclDataSegments, 1,
+      kDeclDataSegments, 14,      // section size
+      1,
       0xae, 0xb3, 0x08, 0,        // dest addr
       15, 0, 0, 0,                // source offset
       5, 0, 0, 0,                 // source size
@@ -479,7 +609,8 @@ TEST_F(WasmModuleVerifyTest, OneGlobalOneFunctionWithNopBodyOneDataSegment) {
 
 TEST_F(WasmModuleVerifyTest, OneDataSegment) {
   const byte data[] = {
-      kDeclDataSegments, 1,
+      kDeclDataSegments, 14,   // section size
+      1,
       0xaa, 0xbb, 0x09, 0,     // dest addr
       11, 0, 0, 0,             // source offset
       3, 0, 0, 0,              // source size
@@ -511,7 +642,8 @@ TEST_F(WasmModuleVerifyTest, OneDataSegment) {
 
 TEST_F(WasmModuleVerifyTest, TwoDataSegments) {
   const byte data[] = {
-      kDeclDataSegments, 2,
+      kDeclDataSegments, 27,   // section size
+      2,
       0xee, 0xff, 0x07, 0,     // dest addr
       9, 0, 0, 0,              // #0: source offset
       4, 0, 0, 0,              // source size
@@ -554,21 +686,23 @@ TEST_F(WasmModuleVerifyTest, TwoDataSegments) {
 // To make below tests for indirect calls much shorter.
 #define FUNCTION(sig_index, external)		\
   kDeclFunctionImport,				\
-  static_cast<byte>(sig_index),			\
-  static_cast<byte>(sig_index >> 8)  
+  static_cast<byte>(sig_index)
   
 
 TEST_F(WasmModuleVerifyTest, OneIndirectFunction) {
   static const byte data[] = {
       // sig#0 -------------------------------------------------------
-      kDeclSignatures, 1,
+      kDeclSignatures, 3,            // section size
+      1,
       0, 0,                          // void -> void
       // func#0 ------------------------------------------------------
-      kDeclFunctions, 1,
+      kDeclFunctions, 3,             // section size
+      1,
       FUNCTION(0, 0),
       // indirect table ----------------------------------------------
-      kDeclFunctionTable, 1,
-      0, 0
+      kDeclFunctionTable, 2,         // section size
+      1,
+      0
   };
 
   ModuleResult result = DecodeModule(data, data + arraysize(data));
@@ -585,25 +719,28 @@ TEST_F(WasmModuleVerifyTest, OneIndirectFunction) {
 TEST_F(WasmModuleVerifyTest, MultipleIndirectFunctions) {
   static const byte data[] = {
       // sig#0 -------------------------------------------------------
-      kDeclSignatures, 2,
+      kDeclSignatures, 5,            // section size
+      2,
       0, 0,                          // void -> void
       0, kAstI32,                    // void -> i32
       // func#0 ------------------------------------------------------
-      kDeclFunctions, 4,
+      kDeclFunctions, 9,             // section size
+      4,
       FUNCTION(0, 1),
       FUNCTION(1, 1),
       FUNCTION(0, 1),
       FUNCTION(1, 1),
       // indirect table ----------------------------------------------
-      kDeclFunctionTable, 8,
-      0, 0,
-      1, 0,
-      2, 0,
-      3, 0,
-      0, 0,
-      1, 0,
-      2, 0,
-      3, 0,
+      kDeclFunctionTable, 9,         // section size
+      8,
+      0,
+      1,
+      2,
+      3,
+      0,
+      1,
+      2,
+      3,
   };
 
   ModuleResult result = DecodeModule(data, data + arraysize(data));
@@ -622,11 +759,13 @@ TEST_F(WasmModuleVerifyTest, MultipleIndirectFunctions) {
 TEST_F(WasmModuleVerifyTest, IndirectFunctionNoFunctions) {
   static const byte data[] = {
       // sig#0 -------------------------------------------------------
-      kDeclSignatures, 1,
+      kDeclSignatures, 3,            // section size
+      1,
       0, 0,                          // void -> void
       // indirect table ----------------------------------------------
-      kDeclFunctionTable, 1,
-      0, 0,
+      kDeclFunctionTable, 2,         // section size
+      1,
+      0,
   };
 
   EXPECT_FAILURE(data);
@@ -636,14 +775,86 @@ TEST_F(WasmModuleVerifyTest, IndirectFunctionNoFunctions) {
 TEST_F(WasmModuleVerifyTest, IndirectFunctionInvalidIndex) {
   static const byte data[] = {
       // sig#0 -------------------------------------------------------
-      kDeclSignatures, 1,
+      kDeclSignatures, 3,            // section size
+      1,
       0, 0,                          // void -> void
       // functions ---------------------------------------------------
-      kDeclFunctions, 1,
+      kDeclFunctions, 3,             // section size
+      1,
       FUNCTION(0, 1),
       // indirect table ----------------------------------------------
-      kDeclFunctionTable, 1,
-      1, 0,
+      kDeclFunctionTable, 2,         // section size
+      1,
+      1,
+  };
+
+  EXPECT_FAILURE(data);
+}
+
+
+TEST_F(WasmModuleVerifyTest, IndirectFunctionLongLEB) {
+  static const byte data[] = {
+      // sig#0 -------------------------------------------------------
+      kDeclSignatures, 3,            // section size
+      1,
+      0, 0,                          // void -> void
+      // functions ---------------------------------------------------
+      kDeclFunctions, 3,             // section size
+      1,
+      FUNCTION(0, 1),
+      // indirect table ----------------------------------------------
+      kDeclFunctionTable, 4,         // section size
+      1,
+      0x80, 0x80, 0,
+  };
+
+  ModuleResult result = DecodeModule(data, data + arraysize(data));
+  EXPECT_TRUE(result.ok());
+  if (result.ok()) {
+    EXPECT_EQ(1, result.val->function_table->size());
+    EXPECT_EQ(0, result.val->function_table->at(0));
+  }
+}
+
+
+TEST_F(WasmModuleVerifyTest, UnknownSectionSkipped) {
+  static const byte data[] = {
+      // unknown section ---------------------------------------------
+      0x33, 4,                       // section code, section size
+      1, 2, 3, 4,                    // ignored payload
+      // sig#0 -------------------------------------------------------
+      kDeclSignatures, 3,            // section size
+      1,
+      0, 0,                          // void -> void
+  };
+
+  ModuleResult result = DecodeModule(data, data + arraysize(data));
+  EXPECT_TRUE(result.ok());
+  if (result.ok()) {
+    EXPECT_EQ(1, result.val->signatures->size());
+  }
+}
+
+
+TEST_F(WasmModuleVerifyTest, SectionSizeMismatch) {
+  for (byte size = 0; size < 6; size++) {
+    if (size == 3) continue;
+    const byte data[] = {
+        kDeclSignatures, size,       // section size
+        1,
+        0, 0,                        // void -> void
+        kDeclEnd, 0, 0,
+    };
+    EXPECT_FAILURE(data);
+  }
+}
+
+
+TEST_F(WasmModuleVerifyTest, SectionOverrun) {
+  static const byte data[] = {
+      kDeclSignatures, 9,            // section size
+      1,
+      0, 0,                          // void -> void
   };
 
   EXPECT_FAILURE(data);
@@ -0,0 +1,141 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "test/unittests/test-utils.h"
+
+#include "src/v8.h"
+
+#include "src/base/smart-pointers.h"
+
+#include "src/wasm/wasm-memory.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+static const size_t kPageSize = 4096;
+static const size_t kReservedSize = 64 * MB;
+
+
+TEST(WasmMemoryTest, ZeroInitialized) {
+  static const size_t kSizes[] = {1, 4096, 65536 + 7, 16 * MB};
+  for (size_t i = 0; i < arraysize(kSizes); i++) {
+    base::SmartPointer<WasmMemory> memory(WasmMemory::Allocate(kSizes[i]));
+    EXPECT_TRUE(memory.get() != nullptr);
+    if (memory.is_empty())
+      continue;
+    EXPECT_EQ(kSizes[i], memory->size());
+    EXPECT_EQ(memory->start() + kSizes[i], memory->end());
+    EXPECT_LE(kSizes[i], memory->reserved_size());
+    byte* p = memory->start();
+    while (p < memory->end() && *p == 0) p++;
+    EXPECT_EQ(memory->end(), p);
+    // The memory is writable up to its very end.
+    memory->start()[0] = 1;
+    memory->end()[-1] = 2;
+    EXPECT_EQ(1, memory->start()[0]);
+  }
+}
+
+
+TEST(WasmMemoryTest, Reserved) {
+  base::SmartPointer<WasmMemory> memory(
+      WasmMemory::Allocate(kPageSize, kReservedSize));
+  EXPECT_TRUE(memory.get() != nullptr);
+  if (memory.is_empty())
+    return;
+  EXPECT_EQ(kPageSize, memory->size());
+  EXPECT_EQ(kReservedSize, memory->reserved_size());
+  memory->end()[-1] = 0xff;
+  EXPECT_EQ(0xff, memory->end()[-1]);
+}
+
+
+TEST(WasmMemoryTest, ReservationSmallerThanSize) {
+  static const size_t kSize = 1 * MB;
+  base::SmartPointer<WasmMemory> memory(WasmMemory::Allocate(kSize, kPageSize));
+  EXPECT_TRUE(memory.get() != nullptr);
+  if (memory.is_empty())
+    return;
+  EXPECT_EQ(kSize, memory->size());
+  EXPECT_EQ(kSize, memory->reserved_size());
+}
+
+
+#if V8_OS_LINUX
+TEST(WasmMemoryTest, CommittedSize) {
+  static const size_t kSize = 16 * MB;
+  base::SmartPointer<WasmMemory> memory(WasmMemory::Allocate(kSize));
+  EXPECT_TRUE(memory.get() != nullptr);
+  if (memory.is_empty())
+    return;
+  // Untouched pages are not committed, however large the memory is.
+  EXPECT_EQ(0u, memory->CommittedSize());
+  memory->start()[0] = 1;
+  memory->start()[kSize / 2] = 1;
+  EXPECT_LE(2 * kPageSize, memory->CommittedSize());
+  EXPECT_GT(kSize, memory->CommittedSize());
+  WasmMemory::Discard(memory->start(), kSize);
+  EXPECT_EQ(0u, memory->CommittedSize());
+}
+#endif
+
+
+TEST(WasmMemoryTest, Decommit) {
+  base::SmartPointer<WasmMemory> memory(WasmMemory::Allocate(4 * kPageSize));
+  EXPECT_TRUE(memory.get() != nullptr);
+  if (memory.is_empty())
+    return;
+  memset(memory->start(), 0xab, memory->size());
+  WasmMemory::Decommit(memory->start() + kPageSize, 2 * kPageSize);
+  EXPECT_EQ(0xab, memory->start()[kPageSize - 1]);
+  EXPECT_EQ(0, memory->start()[kPageSize]);
+  EXPECT_EQ(0, memory->start()[3 * kPageSize - 1]);
+  EXPECT_EQ(0xab, memory->start()[3 * kPageSize]);
+  // The pages stay writable.
+  memory->start()[kPageSize] = 1;
+  EXPECT_EQ(1, memory->start()[kPageSize]);
+}
+
+TEST(WasmMemoryTest, CommitGuard) {
+  base::SmartPointer<WasmMemory> memory(
+      WasmMemory::Allocate(kPageSize, 2 * kPageSize));
+  EXPECT_TRUE(memory.get() != nullptr);
+  if (memory.is_empty())
+    return;
+  EXPECT_TRUE(memory->CommitGuard(8));
+  EXPECT_EQ(0, memory->end()[7]);
+  memory->end()[7] = 0xff;
+  EXPECT_EQ(0xff, memory->end()[7]);
+  // The guard must fit into the reservation.
+  EXPECT_FALSE(memory->CommitGuard(kPageSize + 1));
+
+  base::SmartPointer<WasmMemory> unreserved(WasmMemory::Allocate(kPageSize));
+  if (!unreserved.is_empty())
+    EXPECT_FALSE(unreserved->CommitGuard(8));
+}
+
+TEST(WasmMemoryTest, HugePages) {
+  static const size_t kSize = 3 * MB + 5;
+  base::SmartPointer<WasmMemory> memory(
+      WasmMemory::Allocate(kSize, 0, true));
+  EXPECT_TRUE(memory.get() != nullptr);
+  if (memory.is_empty())
+    return;
+  EXPECT_EQ(kSize, memory->size());
+  EXPECT_LE(kSize, memory->reserved_size());
+#if V8_OS_LINUX
+  // The memory starts on a huge page boundary wherever huge pages are used.
+  EXPECT_TRUE(IsAligned(reinterpret_cast<intptr_t>(memory->start()), 2 * MB));
+#endif
+  byte* p = memory->start();
+  while (p < memory->end() && *p == 0) p++;
+  EXPECT_EQ(memory->end(), p);
+  memory->end()[-1] = 0xff;
+  EXPECT_EQ(0xff, memory->end()[-1]);
+}
+
+}
+}
+}
@@ -16,6 +16,8 @@
           'wasm-macro-gen-unittest.cc',
           'module-decoder-unittest.cc',
 	  'encoder-unittest.cc',
+          'leb128-unittest.cc',
+          'wasm-memory-unittest.cc',
         ],
       },
     },
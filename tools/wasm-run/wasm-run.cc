@@ -0,0 +1,326 @@
+// Copyright 2015 the V8 project authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Runs an exported function of a WASM module file without JavaScript glue:
+//
+//   wasm-run [--repeat=<n>] [<v8 flags>] <module.wasm> [<export> [<args>]]
+//
+// The export defaults to "main" and the arguments are numbers. Imports are
+// linked against native stubs that ignore their arguments and return 0. The
+// export is called through its C entry point, see {WasmInstance}, so
+// modules whose exports make indirect calls are rejected. The time spent
+// decoding, compiling, instantiating and executing is reported separately,
+// one phase per line, for reproducible measurements.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "include/libplatform/libplatform.h"
+#include "include/v8.h"
+
+#include "src/api.h"
+#include "src/base/platform/elapsed-timer.h"
+#include "src/base/smart-pointers.h"
+#include "src/conversions.h"
+#include "src/isolate.h"
+#include "src/objects.h"
+#include "src/ostreams.h"
+
+#include "src/wasm/module-file.h"
+#include "src/wasm/tf-builder.h"
+#include "src/wasm/wasm-compiled-module.h"
+#include "src/wasm/wasm-host.h"
+#include "src/wasm/wasm-module.h"
+
+namespace v8 {
+namespace internal {
+namespace wasm {
+
+namespace {
+class ArrayBufferAllocator : public v8::ArrayBuffer::Allocator {
+ public:
+  void* Allocate(size_t length) override {
+    return calloc(length, 1);
+  }
+  void* AllocateUninitialized(size_t length) override {
+    return malloc(length);
+  }
+  void Free(void* data, size_t length) override { free(data); }
+};
+
+#if USE_SIMULATOR
+void StubImport(const v8::FunctionCallbackInfo<v8::Value>& args) {
+  args.GetReturnValue().Set(0);
+}
+#else
+// Native stubs for imports, by return type. The C calling convention
+// leaves the arguments to the caller, so a stub without WASM parameters
+// stands for any parameter list.
+void StubVoid(byte* mem_start, size_t mem_size) {}
+int32_t StubI32(byte* mem_start, size_t mem_size) { return 0; }
+int64_t StubI64(byte* mem_start, size_t mem_size) { return 0; }
+float StubF32(byte* mem_start, size_t mem_size) { return 0; }
+double StubF64(byte* mem_start, size_t mem_size) { return 0; }
+
+Address NativeStubFor(FunctionSig* sig) {
+  if (sig->return_count() == 0)
+    return FUNCTION_ADDR(StubVoid);
+  switch (sig->GetReturn()) {
+    case kAstI32:
+      return FUNCTION_ADDR(StubI32);
+    case kAstI64:
+      return FUNCTION_ADDR(StubI64);
+    case kAstF32:
+      return FUNCTION_ADDR(StubF32);
+    case kAstF64:
+      return FUNCTION_ADDR(StubF64);
+    default:
+      UNREACHABLE();
+      return nullptr;
+  }
+}
+#endif
+
+void PrintException(Object* exception) {
+  OFStream os(stderr);
+  if (exception->IsString()) {
+    os << String::cast(exception)->ToCString().get();
+  } else {
+    os << Brief(exception);
+  }
+  os << std::endl;
+}
+
+// Prints the error scheduled by an {ErrorThrower}.
+void PrintScheduledError(Isolate* isolate) {
+  PrintException(isolate->scheduled_exception());
+  isolate->clear_scheduled_exception();
+}
+
+void PrintTime(const char* phase, double ms) {
+  printf("%-12s %12.3f ms\n", phase, ms);
+}
+
+// Links every import of {module} against a stub returning 0.
+Handle<JSObject> NewStubImports(Isolate* isolate, WasmModule* module) {
+  Factory* factory = isolate->factory();
+  Handle<JSObject> ffi = factory->NewJSObject(isolate->object_function());
+  for (const WasmFunction& function : *module->functions) {
+    if (!function.external)
+      continue;
+    Handle<String> name =
+        factory->InternalizeUtf8String(module->GetName(function.name_offset));
+#if USE_SIMULATOR
+    // The simulator cannot call native host functions.
+    v8::Isolate* v8_isolate = reinterpret_cast<v8::Isolate*>(isolate);
+    Handle<Object> stub = v8::Utils::OpenHandle(
+        *v8::Function::New(v8_isolate->GetCurrentContext(), StubImport)
+             .ToLocalChecked());
+#else
+    Handle<Object> stub = NewWasmHostFunction(
+        isolate, NativeStubFor(function.sig), function.sig);
+#endif
+    JSObject::SetProperty(ffi, name, stub, STRICT).Assert();
+  }
+  return ffi;
+}
+
+// Calls the export at {entry} of the {types} through its C entry point
+// {repeat} times. Stores the time per call into {execute_ms}.
+bool CallNative(WasmInstance* instance, Address entry,
+                const std::vector<LocalType>& types, int argc, char** argv,
+                int repeat, double* execute_ms) {
+  size_t params = types.size() - 1;
+  std::vector<byte> args(std::max<size_t>(params, 1) * TFBuilder::kSlotSize);
+  for (size_t i = 0; i < params; i++) {
+    // Missing arguments are 0.
+    const char* arg = static_cast<int>(i) < argc ? argv[i] : "0";
+    byte* slot = &args[i * TFBuilder::kSlotSize];
+    switch (types[1 + i]) {
+      case kAstI32: {
+        int32_t value = DoubleToInt32(strtod(arg, nullptr));
+        memcpy(slot, &value, sizeof(value));
+        break;
+      }
+      case kAstI64: {
+        int64_t value = strtoll(arg, nullptr, 0);
+        memcpy(slot, &value, sizeof(value));
+        break;
+      }
+      case kAstF32: {
+        float value = DoubleToFloat32(strtod(arg, nullptr));
+        memcpy(slot, &value, sizeof(value));
+        break;
+      }
+      case kAstF64: {
+        double value = strtod(arg, nullptr);
+        memcpy(slot, &value, sizeof(value));
+        break;
+      }
+      default:
+        UNREACHABLE();
+    }
+  }
+
+  // The result overwrites the first slot, so every call gets a fresh copy
+  // of the arguments.
+  std::vector<byte> slots(args.size());
+  base::ElapsedTimer timer;
+  timer.Start();
+  for (int i = 0; i < repeat; i++) {
+    memcpy(&slots[0], &args[0], args.size());
+    int trap;
+    WasmCallStatus status = instance->CallEntry(entry, &slots[0], &trap);
+    if (status != kWasmCallOk) {
+      fprintf(stderr, "%s\n", status == kWasmCallTrap ? TrapMessage(trap)
+                                                      : "Instance is busy");
+      return false;
+    }
+  }
+  *execute_ms = timer.Elapsed().InMillisecondsF() / repeat;
+
+  printf("%-12s ", "result");
+  switch (types[0]) {
+    case kAstI32: {
+      int32_t value;
+      memcpy(&value, &slots[0], sizeof(value));
+      printf("%" PRId32 "\n", value);
+      break;
+    }
+    case kAstI64: {
+      int64_t value;
+      memcpy(&value, &slots[0], sizeof(value));
+      printf("%" PRId64 "\n", value);
+      break;
+    }
+    case kAstF32: {
+      float value;
+      memcpy(&value, &slots[0], sizeof(value));
+      printf("%.9g\n", value);
+      break;
+    }
+    case kAstF64: {
+      double value;
+      memcpy(&value, &slots[0], sizeof(value));
+      printf("%.17g\n", value);
+      break;
+    }
+    default:
+      printf("undefined\n");
+      break;
+  }
+  return true;
+}
+
+int RunModuleFile(Isolate* isolate, const char* path, const char* name,
+                  int argc, char** argv, int repeat) {
+  HandleScope scope(isolate);
+  ErrorThrower thrower(isolate, "wasm-run");
+
+  base::ElapsedTimer timer;
+  timer.Start();
+  base::SmartPointer<ModuleFile> file(ModuleFile::Open(path));
+  if (file.is_empty()) {
+    fprintf(stderr, "Could not map module file %s\n", path);
+    return 1;
+  }
+  // Decoding verifies the function bodies.
+  base::SmartPointer<WasmCompiledModule> compiled(WasmCompiledModule::Compile(
+      isolate, thrower, file->start(), file->end()));
+  double decode_ms = timer.Elapsed().InMillisecondsF();
+  if (compiled.is_empty()) {
+    PrintScheduledError(isolate);
+    return 1;
+  }
+
+  Handle<JSObject> ffi = NewStubImports(isolate, compiled->module());
+  WasmInstantiateStats stats;
+  timer.Restart();
+  base::SmartPointer<WasmInstance> instance(compiled->Instantiate(
+      thrower, ffi, Handle<JSArrayBuffer>::null(), &stats));
+  double instantiate_ms = timer.Elapsed().InMillisecondsF();
+  if (instance.is_empty()) {
+    PrintScheduledError(isolate);
+    return 1;
+  }
+
+  Address entry = instance->LookupExport(name);
+  if (entry == nullptr) {
+    fprintf(stderr, "Module has no exported function %s\n", name);
+    return 1;
+  }
+  double execute_ms;
+  if (!CallNative(instance.get(), entry, *instance->ExportSignature(name),
+                  argc, argv, repeat, &execute_ms)) {
+    return 1;
+  }
+
+  PrintTime("decode", decode_ms);
+  PrintTime("compile", stats.compile_time_ms);
+  PrintTime("instantiate", instantiate_ms - stats.compile_time_ms);
+  PrintTime("execute", execute_ms);
+  if (repeat > 1)
+    printf("%-12s %12d\n", "repeat", repeat);
+  return 0;
+}
+}  // namespace
+}
+}
+}
+
+int main(int argc, char* argv[]) {
+  // Options of the runner come first; the arguments from the module file on
+  // are kept away from V8, which would take negative numbers for flags.
+  int repeat = 1;
+  int flag_count = 1;
+  while (flag_count < argc && argv[flag_count][0] == '-') {
+    if (strncmp(argv[flag_count], "--repeat=", 9) == 0) {
+      repeat = atoi(argv[flag_count] + 9);
+      argv[flag_count] = nullptr;
+    }
+    flag_count++;
+  }
+  if (flag_count == argc || repeat < 1) {
+    fprintf(stderr,
+            "Usage: %s [--repeat=<n>] [<v8 flags>] <module.wasm> "
+            "[<export> [<args>]]\n",
+            argv[0]);
+    return 1;
+  }
+  const char* path = argv[flag_count];
+  const char* name = flag_count + 1 < argc ? argv[flag_count + 1] : "main";
+  int arg_count = flag_count + 2 < argc ? argc - flag_count - 2 : 0;
+  char** args = argv + flag_count + 2;
+
+  v8::V8::InitializeICU();
+  v8::V8::InitializeExternalStartupData(argv[0]);
+  v8::V8::SetFlagsFromCommandLine(&flag_count, argv, true);
+  v8::Platform* platform = v8::platform::CreateDefaultPlatform();
+  v8::V8::InitializePlatform(platform);
+  v8::V8::Initialize();
+  v8::internal::wasm::ArrayBufferAllocator allocator;
+  v8::Isolate::CreateParams create_params;
+  create_params.array_buffer_allocator = &allocator;
+  v8::Isolate* isolate = v8::Isolate::New(create_params);
+  int exit_code;
+  {
+    v8::Isolate::Scope isolate_scope(isolate);
+    v8::HandleScope handle_scope(isolate);
+    v8::Local<v8::Context> context = v8::Context::New(isolate);
+    v8::Context::Scope context_scope(context);
+    exit_code = v8::internal::wasm::RunModuleFile(
+        reinterpret_cast<v8::internal::Isolate*>(isolate), path, name,
+        arg_count, args, repeat);
+  }
+  isolate->Dispose();
+  v8::V8::Dispose();
+  v8::V8::ShutdownPlatform();
+  delete platform;
+  return exit_code;
+}
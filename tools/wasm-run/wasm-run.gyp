@@ -0,0 +1,38 @@
+# Copyright 2015 the V8 project authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+{
+  'variables': {
+    'v8_code': 1,
+  },
+  'includes': [
+    '../../../../build/toolchain.gypi',
+    '../../../../build/features.gypi',
+  ],
+  'targets': [
+    {
+      # Built alongside test/cctest/cctest.gyp:cctest and
+      # test/unittests/unittests.gyp:unittests.
+      'target_name': 'wasm-run',
+      'type': 'executable',
+      'dependencies': [
+        '../../../../tools/gyp/v8.gyp:v8_libplatform',
+      ],
+      'include_dirs': ['../../../..', '../..'],
+      'sources': [
+        'wasm-run.cc',
+      ],
+      'conditions': [
+        ['component=="shared_library"', {
+          # The runner uses internal APIs, so it links against the static
+          # library, like cctest.
+          'dependencies': ['../../../../tools/gyp/v8.gyp:v8_maybe_snapshot'],
+          'defines': ['BUILDING_V8_SHARED'],
+        }, {
+          'dependencies': ['../../../../tools/gyp/v8.gyp:v8'],
+        }],
+      ],
+    },
+  ],
+}
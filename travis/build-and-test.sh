@@ -22,3 +22,12 @@ echo "==== cctest/test-run-wasm* ===="
 echo "==== mjsunit/wasm/* ===="
 ./tools/run-tests.py \
   --no-presubmit --mode optdebug --arch x64 mjsunit/wasm/*
+
+echo "==== wasm-run ===="
+MODULE=out/add.wasm
+printf '\x01\x05\x01\x02\x01\x01\x01' > $MODULE              # (int, int)->int
+printf '\x02\x0d\x01\x09\x00\x17\x00\x00\x00\x05' >> $MODULE # main
+printf '\x40\x0e\x00\x0e\x01' >> $MODULE                     # a + b
+printf '\x06main\x00' >> $MODULE
+./out/x64.optdebug/wasm-run $MODULE main 40 2 | tee out/add.txt
+grep -q "^result *42$" out/add.txt
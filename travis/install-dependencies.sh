@@ -27,6 +27,16 @@ if [[ ! -d v8/v8/test/mjsunit/wasm ]]; then
   ln -fs $PWD/test/mjsunit/wasm v8/v8/test/mjsunit/wasm
 fi
 
+# Undo the patch below, so that the checkout updates cleanly.
+git -C v8/v8 checkout build/all.gyp
+
 cd v8
 gclient update
 cd ..
+
+# Build tools/wasm-run as part of V8's "All" target.
+ALL_GYP=v8/v8/build/all.gyp
+if ! grep -q "wasm-run.gyp:wasm-run" $ALL_GYP; then
+  sed -i "s|^\( *\)'../src/d8.gyp:d8',|&\n\1'../third_party/wasm/tools/wasm-run/wasm-run.gyp:wasm-run',|" $ALL_GYP
+  grep -q "wasm-run.gyp:wasm-run" $ALL_GYP
+fi